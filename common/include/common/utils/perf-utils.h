@@ -49,7 +49,7 @@ public:
 
     [[nodiscard]] unsigned get_avg_duration_us() const
     {
-        return total_duration_us_ / num_calls_;
+        return num_calls_ ? total_duration_us_ / num_calls_ : 0;
     }
 };
 
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for zero terminated strings with stable addresses
+class StringPool
+{
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    char* m_cur = nullptr;
+    std::size_t m_left = 0;
+    std::size_t m_chunk_size;
+
+    void add_chunk(std::size_t chunk_size)
+    {
+        m_chunks.push_back(std::make_unique<char[]>(chunk_size));
+        m_cur = m_chunks.back().get();
+        m_left = chunk_size;
+    }
+
+public:
+    StringPool(std::size_t chunk_size = 16384) : m_chunk_size(chunk_size) {}
+
+    const char* add(std::string_view str)
+    {
+        std::size_t len = str.size() + 1;
+        if (len > m_left) {
+            add_chunk(std::max(m_chunk_size, len));
+        }
+        char* result = m_cur;
+        std::memcpy(result, str.data(), str.size());
+        result[str.size()] = '\0';
+        m_cur += len;
+        m_left -= len;
+        return result;
+    }
+
+    // Makes sure strings of the given total size (terminators included) can be added without allocating another
+    // chunk. It allows to allocate exactly as much memory as needed if all strings are known upfront.
+    void reserve(std::size_t num_bytes)
+    {
+        if (num_bytes > m_left) {
+            add_chunk(num_bytes);
+        }
+    }
+
+    void clear()
+    {
+        m_chunks.clear();
+        m_cur = nullptr;
+        m_left = 0;
+    }
+};
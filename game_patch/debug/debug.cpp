@@ -8,12 +8,9 @@
 #ifdef NDEBUG
 #define MEMORY_TRACKING 0
 #define VARRAY_OOB_CHECK 0
-#define EMULATE_PACKET_LOSS 0
 #else // NDEBUG
 #define MEMORY_TRACKING 1
 #define VARRAY_OOB_CHECK 0
-#define EMULATE_PACKET_LOSS 0
-#define PACKET_LOSS_RATE 10 // every n packet is lost
 #endif // NDEBUG
 
 #if MEMORY_TRACKING
@@ -133,28 +130,6 @@ CodeInjection VArray_Ptr__get_out_of_bounds_check{
 };
 #endif // VARRAY_OOB_CHECK
 
-#if EMULATE_PACKET_LOSS
-
-FunHook<int(const void*, unsigned, int, const rf::NetAddr*, int)> net_send_hook{
-    0x00528820,
-    [](const void* packet, unsigned packet_len, int flags, const rf::NetAddr* addr, int packet_kind) {
-        if (rand() % PACKET_LOSS_RATE == 0)
-            return 0;
-        return net_send_hook.call_target(packet, packet_len, flags, addr, packet_kind);
-    },
-};
-
-FunHook<void(void*, const void*, unsigned, rf::NetAddr*)> net_buffer_packet_hook{
-    0x00528950,
-    [](void* buffer, const void* data, unsigned data_len, rf::NetAddr* addr) {
-        if (rand() % PACKET_LOSS_RATE == 0)
-            return;
-        return net_buffer_packet_hook.call_target(buffer, data, data_len, addr);
-    },
-};
-
-#endif // EMULATE_PACKET_LOSS
-
 void debug_multi_init()
 {
     debug_cmd_multi_init();
@@ -177,10 +152,7 @@ void debug_apply_patches()
     VArray_Ptr__get_out_of_bounds_check.install();
 #endif
 
-#if EMULATE_PACKET_LOSS
-    net_send_hook.install();
-    net_buffer_packet_hook.install();
-#endif
+    net_sim_apply_patches();
 
     debug_unresponsive_apply_patches();
 #if DEBUG_PERF
@@ -196,6 +168,7 @@ void debug_init()
 
     debug_cmd_init();
     debug_unresponsive_init();
+    net_sim_init();
 #ifndef NDEBUG
     register_obj_debug_commands();
 #endif
@@ -225,6 +198,7 @@ void debug_cleanup()
 void debug_do_frame_pre()
 {
     debug_unresponsive_do_update();
+    net_sim_do_frame();
 }
 
 void debug_do_frame_post()
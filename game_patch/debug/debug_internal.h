@@ -165,3 +165,6 @@ void debug_unresponsive_init();
 void debug_unresponsive_cleanup();
 void debug_unresponsive_do_update();
 void debug_cmd_multi_init();
+void net_sim_apply_patches();
+void net_sim_init();
+void net_sim_do_frame();
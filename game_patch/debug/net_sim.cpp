@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#include <patch_common/FunHook.h>
+#include "debug_internal.h"
+#include "../os/console.h"
+#include "../rf/multi.h"
+#include "../rf/os/timer.h"
+
+// Simulation of bad network conditions (latency, jitter, packet loss and reordering)
+// Conditions are applied to packets sent to and received from the socket so they affect both the stock protocol and
+// Dash Faction extensions. Settings are shared by both directions (round trip time is increased by 2 * latency).
+
+struct NetSimConfig
+{
+    int latency_ms = 0;
+    int jitter_ms = 0;
+    int loss_percent = 0;
+    int reorder_percent = 0;
+
+    [[nodiscard]] bool enabled() const
+    {
+        return latency_ms > 0 || jitter_ms > 0 || loss_percent > 0 || reorder_percent > 0;
+    }
+};
+
+struct NetSimPacket
+{
+    int release_time_ms;
+    std::vector<std::byte> data;
+    rf::NetAddr addr;
+    // send specific
+    int flags;
+    int packet_kind;
+    // receive specific
+    void* buffer;
+};
+
+struct NetSimStats
+{
+    int num_sent = 0;
+    int num_recvd = 0;
+    int num_dropped = 0;
+    int num_reordered = 0;
+};
+
+static NetSimConfig g_net_sim_config;
+static NetSimStats g_net_sim_stats;
+static std::minstd_rand g_net_sim_rng;
+static std::deque<NetSimPacket> g_net_sim_send_queue;
+static std::deque<NetSimPacket> g_net_sim_recv_queue;
+
+// Simulation on a client would work as a lag switch so in release builds it is only allowed when hosting a game
+static bool net_sim_is_allowed()
+{
+#ifdef NDEBUG
+    return !rf::is_multi || rf::is_server;
+#else
+    return true;
+#endif
+}
+
+static bool net_sim_roll(int percent)
+{
+    return percent > 0 && static_cast<int>(g_net_sim_rng() % 100) < percent;
+}
+
+static int net_sim_get_release_time()
+{
+    int delay_ms = g_net_sim_config.latency_ms;
+    if (g_net_sim_config.jitter_ms > 0) {
+        delay_ms += static_cast<int>(g_net_sim_rng() % (g_net_sim_config.jitter_ms + 1));
+    }
+    return rf::timer_get_milliseconds() + delay_ms;
+}
+
+// Returns false if packet should be dropped
+static bool net_sim_enqueue(std::deque<NetSimPacket>& queue, NetSimPacket&& packet)
+{
+    if (net_sim_roll(g_net_sim_config.loss_percent)) {
+        ++g_net_sim_stats.num_dropped;
+        return false;
+    }
+    // Packets are released in queue order so reordering is done by swapping the packet with the previous one
+    queue.push_back(std::move(packet));
+    if (queue.size() >= 2 && net_sim_roll(g_net_sim_config.reorder_percent)) {
+        auto& prev = queue[queue.size() - 2];
+        auto& last = queue.back();
+        std::swap(prev.release_time_ms, last.release_time_ms);
+        std::swap(prev, last);
+        ++g_net_sim_stats.num_reordered;
+    }
+    return true;
+}
+
+FunHook<int(const void*, unsigned, int, const rf::NetAddr*, int)> net_sim_send_hook{
+    0x00528820,
+    [](const void* packet, unsigned packet_len, int flags, const rf::NetAddr* addr, int packet_kind) {
+        if (!g_net_sim_config.enabled() || !net_sim_is_allowed()) {
+            return net_sim_send_hook.call_target(packet, packet_len, flags, addr, packet_kind);
+        }
+        ++g_net_sim_stats.num_sent;
+        const auto* bytes = static_cast<const std::byte*>(packet);
+        net_sim_enqueue(g_net_sim_send_queue, {
+            net_sim_get_release_time(),
+            {bytes, bytes + packet_len},
+            *addr,
+            flags,
+            packet_kind,
+            nullptr,
+        });
+        // Report success to the caller even if packet is dropped
+        return static_cast<int>(packet_len);
+    },
+};
+
+FunHook<void(void*, const void*, unsigned, rf::NetAddr*)> net_sim_buffer_packet_hook{
+    0x00528950,
+    [](void* buffer, const void* data, unsigned data_len, rf::NetAddr* addr) {
+        if (!g_net_sim_config.enabled() || !net_sim_is_allowed()) {
+            net_sim_buffer_packet_hook.call_target(buffer, data, data_len, addr);
+            return;
+        }
+        ++g_net_sim_stats.num_recvd;
+        const auto* bytes = static_cast<const std::byte*>(data);
+        net_sim_enqueue(g_net_sim_recv_queue, {
+            net_sim_get_release_time(),
+            {bytes, bytes + data_len},
+            *addr,
+            0,
+            0,
+            buffer,
+        });
+    },
+};
+
+static void net_sim_flush(bool force)
+{
+    int now_ms = rf::timer_get_milliseconds();
+    while (!g_net_sim_send_queue.empty()
+        && (force || g_net_sim_send_queue.front().release_time_ms - now_ms <= 0)) {
+        auto& packet = g_net_sim_send_queue.front();
+        net_sim_send_hook.call_target(packet.data.data(), packet.data.size(), packet.flags, &packet.addr,
+            packet.packet_kind);
+        g_net_sim_send_queue.pop_front();
+    }
+    while (!g_net_sim_recv_queue.empty()
+        && (force || g_net_sim_recv_queue.front().release_time_ms - now_ms <= 0)) {
+        auto& packet = g_net_sim_recv_queue.front();
+        net_sim_buffer_packet_hook.call_target(packet.buffer, packet.data.data(), packet.data.size(), &packet.addr);
+        g_net_sim_recv_queue.pop_front();
+    }
+}
+
+ConsoleCommand2 net_sim_cmd{
+    "d_net_sim",
+    [](std::optional<std::string> param, std::optional<int> value) {
+        if (param == "off") {
+            net_sim_flush(true);
+            g_net_sim_config = {};
+        }
+        else if (param == "reset") {
+            g_net_sim_stats = {};
+        }
+        else if (param && value) {
+            if (!net_sim_is_allowed()) {
+                rf::console::print("This command is disabled in multiplayer!");
+                return;
+            }
+            int clamped_value = std::max(value.value(), 0);
+            if (param == "latency") {
+                g_net_sim_config.latency_ms = clamped_value;
+            }
+            else if (param == "jitter") {
+                g_net_sim_config.jitter_ms = clamped_value;
+            }
+            else if (param == "loss") {
+                g_net_sim_config.loss_percent = std::min(clamped_value, 100);
+            }
+            else if (param == "reorder") {
+                g_net_sim_config.reorder_percent = std::min(clamped_value, 100);
+            }
+            else if (param == "seed") {
+                g_net_sim_rng.seed(static_cast<unsigned>(value.value()));
+            }
+            else {
+                rf::console::print("Unknown parameter: {}", param.value());
+                return;
+            }
+        }
+        else if (param) {
+            rf::console::print("Missing value for parameter: {}", param.value());
+            return;
+        }
+        rf::console::print("Latency {} ms, jitter {} ms, loss {}%, reorder {}%", g_net_sim_config.latency_ms,
+            g_net_sim_config.jitter_ms, g_net_sim_config.loss_percent, g_net_sim_config.reorder_percent);
+        rf::console::print("Sent {}, received {}, dropped {}, reordered {}, queued {}", g_net_sim_stats.num_sent,
+            g_net_sim_stats.num_recvd, g_net_sim_stats.num_dropped, g_net_sim_stats.num_reordered,
+            g_net_sim_send_queue.size() + g_net_sim_recv_queue.size());
+    },
+    "Simulates bad network conditions",
+    "d_net_sim [latency <ms> | jitter <ms> | loss <percent> | reorder <percent> | seed <value> | reset | off]",
+};
+
+void net_sim_apply_patches()
+{
+    net_sim_send_hook.install();
+    net_sim_buffer_packet_hook.install();
+}
+
+void net_sim_init()
+{
+    net_sim_cmd.register_cmd();
+}
+
+void net_sim_do_frame()
+{
+    if (!g_net_sim_send_queue.empty() || !g_net_sim_recv_queue.empty()) {
+        net_sim_flush(false);
+    }
+}
@@ -15,6 +15,7 @@
 #include "gr_d3d11_dynamic_geometry.h"
 #include "gr_d3d11_solid.h"
 #include "gr_d3d11_mesh.h"
+#include "gr_d3d11_stats.h"
 
 using namespace rf;
 
@@ -38,7 +39,7 @@ namespace df::gr::d3d11
         texture_manager_ = std::make_unique<TextureManager>(device_, context_);
         render_context_ = std::make_unique<RenderContext>(device_, context_, *state_manager_, *shader_manager_, *texture_manager_);
         dyn_geo_renderer_ = std::make_unique<DynamicGeometryRenderer>(device_, *shader_manager_, *render_context_);
-        solid_renderer_ = std::make_unique<SolidRenderer>(device_, *shader_manager_, *state_manager_, *dyn_geo_renderer_, *render_context_);
+        solid_renderer_ = std::make_unique<SolidRenderer>(device_, *shader_manager_, *state_manager_, *texture_manager_, *dyn_geo_renderer_, *render_context_);
         mesh_renderer_ = std::make_unique<MeshRenderer>(device_, *shader_manager_, *state_manager_, *render_context_);
 
         render_context_->set_render_target(default_render_target_view_, depth_stencil_view_);
@@ -317,6 +318,7 @@ namespace df::gr::d3d11
 
     void Renderer::flip()
     {
+        render_stats_render_ui();
         dyn_geo_renderer_->flush();
         if (msaa_render_target_) {
             context_->ResolveSubresource(back_buffer_, 0, msaa_render_target_, 0, swap_chain_format);
@@ -330,6 +332,7 @@ namespace df::gr::d3d11
         render_context_->set_render_target(default_render_target_view_, depth_stencil_view_);
         // Note: it would be better to call update_per_frame_constants after frametime_calculate
         render_context_->update_per_frame_constants();
+        render_stats_next_frame();
     }
 
     void Renderer::texture_save_cache()
@@ -544,9 +547,15 @@ namespace df::gr::d3d11
         solid_renderer_->page_in_movable_solid(solid);
     }
 
+    void Renderer::update_lightmap(const rf::GLightmap& lightmap, int x, int y, int w, int h)
+    {
+        solid_renderer_->update_lightmap(lightmap, x, y, w, h);
+    }
+
     void Renderer::flush_caches()
     {
         mesh_renderer_->flush_caches();
+        solid_renderer_->flush_caches();
     }
 
     float Renderer::z_far() const
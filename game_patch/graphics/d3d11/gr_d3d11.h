@@ -11,6 +11,7 @@ namespace rf
 {
     struct GSolid;
     struct GRoom;
+    struct GLightmap;
     struct VifMesh;
     struct VifLodMesh;
     struct MeshRenderParams;
@@ -78,6 +79,7 @@ namespace df::gr::d3d11
         void page_in_character_mesh(rf::VifLodMesh* lod_mesh);
         void page_in_solid(rf::GSolid* solid);
         void page_in_movable_solid(rf::GSolid* solid);
+        void update_lightmap(const rf::GLightmap& lightmap, int x, int y, int w, int h);
         void flush_caches();
         float z_far() const;
 
@@ -8,6 +8,7 @@
 #include "gr_d3d11_shader.h"
 #include "gr_d3d11_texture.h"
 #include "gr_d3d11_state.h"
+#include "gr_d3d11_stats.h"
 
 namespace df::gr::d3d11
 {
@@ -153,6 +154,7 @@ namespace df::gr::d3d11
         void set_textures(int tex_handle0, int tex_handle1 = -1)
         {
             if (current_tex_handles_[0] != tex_handle0 || current_tex_handles_[1] != tex_handle1) {
+                ++render_stats.num_texture_changes;
                 current_tex_handles_[0] = tex_handle0;
                 current_tex_handles_[1] = tex_handle1;
                 ID3D11ShaderResourceView* shader_resources[] = {
@@ -167,6 +169,7 @@ namespace df::gr::d3d11
         {
             render_mode_cbuffer_.update(mode, color, device_context_);
             if (!current_mode_ || current_mode_.value() != mode) {
+                ++render_stats.num_mode_changes;
                 if (!current_mode_ || current_mode_.value().get_texture_source() != mode.get_texture_source()) {
                     std::array<ID3D11SamplerState*, 2> sampler_states = {
                         state_manager_.lookup_sampler_state(mode.get_texture_source(), 0),
@@ -258,6 +261,7 @@ namespace df::gr::d3d11
         {
             assert(slot < vertex_buffer_slots);
             if (current_vertex_buffers_[slot] != vertex_buffer) {
+                ++render_stats.num_buffer_changes;
                 current_vertex_buffers_[slot] = vertex_buffer;
                 UINT offsets[] = { 0 };
                 ID3D11Buffer* vertex_buffers[] = { vertex_buffer };
@@ -349,6 +353,7 @@ namespace df::gr::d3d11
 
         void draw_indexed(int index_count, int index_start_location, int base_vertex_location)
         {
+            ++render_stats.num_draw_calls;
             device_context_->DrawIndexed(index_count, index_start_location, base_vertex_location);
         }
 
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <xmmintrin.h>
+#include "../../rf/os/frametime.h"
+#include "gr_d3d11_culling.h"
+
+using namespace rf;
+
+namespace df::gr::d3d11
+{
+    // Bigger polygons are skipped (room faces are much smaller in practice)
+    constexpr int max_occluder_vertices = 32;
+
+    static inline int depth_level_width(int level)
+    {
+        return std::max(OcclusionCuller::depth_buffer_width >> level, 1);
+    }
+
+    static inline int depth_level_height(int level)
+    {
+        return std::max(OcclusionCuller::depth_buffer_height >> level, 1);
+    }
+
+    static inline __m128 abs_ps(__m128 v)
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+    }
+
+    static inline float horizontal_min_ps(__m128 v)
+    {
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(v);
+    }
+
+    static inline float horizontal_max_ps(__m128 v)
+    {
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(v);
+    }
+
+    void OcclusionCuller::begin(const Vector3& eye_pos, const Matrix3& eye_matrix, const Projection& projection)
+    {
+        frame_ = rf::frame_count;
+        eye_pos_ = eye_pos;
+        eye_matrix_ = eye_matrix;
+        sx_ = projection.scale_x();
+        sy_ = projection.scale_y();
+        zn_ = projection.z_near();
+
+        // Points inside the frustum satisfy dot(n, p) + d >= 0. Far plane is not used because far clipping can be
+        // disabled.
+        const Vector3& rvec = eye_matrix.rvec;
+        const Vector3& uvec = eye_matrix.uvec;
+        const Vector3& fvec = eye_matrix.fvec;
+        std::array<Vector3, 5> normals{
+            fvec + rvec * sx_, // left
+            fvec - rvec * sx_, // right
+            fvec + uvec * sy_, // bottom
+            fvec - uvec * sy_, // top
+            fvec, // near
+        };
+        plane_nx_.fill(0.0f);
+        plane_ny_.fill(0.0f);
+        plane_nz_.fill(0.0f);
+        plane_d_.fill(1.0f);
+        for (std::size_t i = 0; i < normals.size(); ++i) {
+            plane_nx_[i] = normals[i].x;
+            plane_ny_[i] = normals[i].y;
+            plane_nz_[i] = normals[i].z;
+            plane_d_[i] = -normals[i].dot_prod(eye_pos);
+        }
+        plane_d_[4] -= zn_;
+
+        for (int level = 0; level < num_depth_levels; ++level) {
+            depth_levels_[level].assign(depth_level_width(level) * depth_level_height(level),
+                std::numeric_limits<float>::infinity());
+        }
+        num_occluder_polygons_ = 0;
+    }
+
+    bool OcclusionCuller::is_current(const Vector3& eye_pos, const Matrix3& eye_matrix, const Projection& projection) const
+    {
+        return frame_ == rf::frame_count && eye_pos_ == eye_pos && eye_matrix_ == eye_matrix
+            && sx_ == projection.scale_x() && sy_ == projection.scale_y() && zn_ == projection.z_near();
+    }
+
+    Vector3 OcclusionCuller::to_view_space(const Vector3& pos) const
+    {
+        Vector3 dir = pos - eye_pos_;
+        return {dir.dot_prod(eye_matrix_.rvec), dir.dot_prod(eye_matrix_.uvec), dir.dot_prod(eye_matrix_.fvec)};
+    }
+
+    OcclusionCuller::ScreenVertex OcclusionCuller::to_screen(const Vector3& view_pos) const
+    {
+        float ndc_x = view_pos.x * sx_ / view_pos.z;
+        float ndc_y = view_pos.y * sy_ / view_pos.z;
+        return {
+            (ndc_x * 0.5f + 0.5f) * depth_buffer_width,
+            (0.5f - ndc_y * 0.5f) * depth_buffer_height,
+        };
+    }
+
+    void OcclusionCuller::add_occluders(const OccluderList& occluders)
+    {
+        std::array<Vector3, max_occluder_vertices> view_verts;
+        // Clipping by the near plane adds at most one vertex
+        std::array<Vector3, max_occluder_vertices + 1> clipped_verts;
+        std::array<ScreenVertex, max_occluder_vertices + 1> screen_verts;
+
+        for (const OccluderList::Polygon& polygon : occluders.polygons) {
+            // Back faces do not hide anything that is in front of them
+            if (polygon.num_vertices > max_occluder_vertices || polygon.plane.distance_to_point(eye_pos_) <= 0.0f) {
+                continue;
+            }
+            for (int i = 0; i < polygon.num_vertices; ++i) {
+                view_verts[i] = to_view_space(occluders.vertices[polygon.start_vertex + i]);
+            }
+            int num_clipped = 0;
+            float max_z = 0.0f;
+            for (int i = 0; i < polygon.num_vertices; ++i) {
+                const Vector3& a = view_verts[i];
+                const Vector3& b = view_verts[(i + 1) % polygon.num_vertices];
+                bool a_inside = a.z >= zn_;
+                bool b_inside = b.z >= zn_;
+                if (a_inside) {
+                    clipped_verts[num_clipped++] = a;
+                    max_z = std::max(max_z, a.z);
+                }
+                if (a_inside != b_inside) {
+                    float t = (zn_ - a.z) / (b.z - a.z);
+                    Vector3 p = a + (b - a) * t;
+                    p.z = zn_;
+                    clipped_verts[num_clipped++] = p;
+                }
+            }
+            if (num_clipped < 3) {
+                continue;
+            }
+            for (int i = 0; i < num_clipped; ++i) {
+                screen_verts[i] = to_screen(clipped_verts[i]);
+            }
+            // Whole polygon uses its farthest depth so the buffer never gets closer than the real geometry
+            for (int i = 2; i < num_clipped; ++i) {
+                rasterize_triangle(screen_verts[0], screen_verts[i - 1], screen_verts[i], max_z);
+            }
+            ++num_occluder_polygons_;
+        }
+    }
+
+    void OcclusionCuller::rasterize_triangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2,
+        float depth)
+    {
+        // Doubled signed area - winding depends on the polygon orientation so make it positive
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::abs(area) < 1.0f) {
+            // Too small to cover a whole pixel
+            return;
+        }
+        std::array<ScreenVertex, 3> v{v0, v1, v2};
+        if (area < 0.0f) {
+            std::swap(v[1], v[2]);
+        }
+
+        float min_x = std::min({v[0].x, v[1].x, v[2].x});
+        float max_x = std::max({v[0].x, v[1].x, v[2].x});
+        float min_y = std::min({v[0].y, v[1].y, v[2].y});
+        float max_y = std::max({v[0].y, v[1].y, v[2].y});
+        // Only pixels fully inside of the bounding rectangle can be covered
+        int x0 = static_cast<int>(std::ceil(std::clamp(min_x, 0.0f, static_cast<float>(depth_buffer_width))));
+        int x1 = static_cast<int>(std::floor(std::clamp(max_x, 0.0f, static_cast<float>(depth_buffer_width)))) - 1;
+        int y0 = static_cast<int>(std::ceil(std::clamp(min_y, 0.0f, static_cast<float>(depth_buffer_height))));
+        int y1 = static_cast<int>(std::floor(std::clamp(max_y, 0.0f, static_cast<float>(depth_buffer_height)))) - 1;
+        if (x0 > x1 || y0 > y1) {
+            return;
+        }
+
+        // Edge functions E(x, y) = a * x + b * y + c are positive inside. They are evaluated in the pixel center and
+        // moved by half of the pixel extent along the edge normal so a pixel passes only if all of its corners are
+        // inside of the triangle (inner conservative rasterization).
+        std::array<float, 3> ea, eb, ec;
+        for (int i = 0; i < 3; ++i) {
+            const ScreenVertex& a = v[i];
+            const ScreenVertex& b = v[(i + 1) % 3];
+            ea[i] = a.y - b.y;
+            eb[i] = b.x - a.x;
+            ec[i] = -(ea[i] * a.x + eb[i] * a.y) - 0.5f * (std::abs(ea[i]) + std::abs(eb[i]));
+        }
+
+        std::vector<float>& depth_buffer = depth_levels_[0];
+        for (int y = y0; y <= y1; ++y) {
+            float py = static_cast<float>(y) + 0.5f;
+            float px = static_cast<float>(x0) + 0.5f;
+            float e0 = ea[0] * px + eb[0] * py + ec[0];
+            float e1 = ea[1] * px + eb[1] * py + ec[1];
+            float e2 = ea[2] * px + eb[2] * py + ec[2];
+            float* row = &depth_buffer[y * depth_buffer_width];
+            for (int x = x0; x <= x1; ++x) {
+                if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                    row[x] = std::min(row[x], depth);
+                }
+                e0 += ea[0];
+                e1 += ea[1];
+                e2 += ea[2];
+            }
+        }
+    }
+
+    void OcclusionCuller::finish_occluders()
+    {
+        for (int level = 1; level < num_depth_levels; ++level) {
+            const std::vector<float>& src = depth_levels_[level - 1];
+            std::vector<float>& dst = depth_levels_[level];
+            int src_w = depth_level_width(level - 1);
+            int src_h = depth_level_height(level - 1);
+            int dst_w = depth_level_width(level);
+            int dst_h = depth_level_height(level);
+            for (int y = 0; y < dst_h; ++y) {
+                int sy0 = std::min(y * 2, src_h - 1);
+                int sy1 = std::min(y * 2 + 1, src_h - 1);
+                for (int x = 0; x < dst_w; ++x) {
+                    int sx0 = std::min(x * 2, src_w - 1);
+                    int sx1 = std::min(x * 2 + 1, src_w - 1);
+                    dst[y * dst_w + x] = std::max({
+                        src[sy0 * src_w + sx0], src[sy0 * src_w + sx1],
+                        src[sy1 * src_w + sx0], src[sy1 * src_w + sx1],
+                    });
+                }
+            }
+        }
+    }
+
+    bool OcclusionCuller::is_outside_frustum(const Vector3& center, const Vector3& extents) const
+    {
+        // Box is outside if it is fully behind any plane: dot(n, c) + dot(|n|, e) + d < 0
+        __m128 cx = _mm_set1_ps(center.x);
+        __m128 cy = _mm_set1_ps(center.y);
+        __m128 cz = _mm_set1_ps(center.z);
+        __m128 ex = _mm_set1_ps(extents.x);
+        __m128 ey = _mm_set1_ps(extents.y);
+        __m128 ez = _mm_set1_ps(extents.z);
+        for (std::size_t i = 0; i < plane_d_.size(); i += 4) {
+            __m128 nx = _mm_loadu_ps(&plane_nx_[i]);
+            __m128 ny = _mm_loadu_ps(&plane_ny_[i]);
+            __m128 nz = _mm_loadu_ps(&plane_nz_[i]);
+            __m128 d = _mm_loadu_ps(&plane_d_[i]);
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), d));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_ps(nx), ex), _mm_mul_ps(abs_ps(ny), ey)),
+                _mm_mul_ps(abs_ps(nz), ez));
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps())) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool OcclusionCuller::is_occluded(const Vector3& bbox_min, const Vector3& bbox_max) const
+    {
+        // Transform all 8 corners to view space at once (4 corners with min Z and 4 corners with max Z)
+        __m128 xs = _mm_sub_ps(_mm_setr_ps(bbox_min.x, bbox_max.x, bbox_min.x, bbox_max.x), _mm_set1_ps(eye_pos_.x));
+        __m128 ys = _mm_sub_ps(_mm_setr_ps(bbox_min.y, bbox_min.y, bbox_max.y, bbox_max.y), _mm_set1_ps(eye_pos_.y));
+        __m128 z0 = _mm_set1_ps(bbox_min.z - eye_pos_.z);
+        __m128 z1 = _mm_set1_ps(bbox_max.z - eye_pos_.z);
+        auto transform = [&](const Vector3& axis, __m128& out0, __m128& out1) {
+            __m128 base = _mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(axis.x)), _mm_mul_ps(ys, _mm_set1_ps(axis.y)));
+            __m128 az = _mm_set1_ps(axis.z);
+            out0 = _mm_add_ps(base, _mm_mul_ps(z0, az));
+            out1 = _mm_add_ps(base, _mm_mul_ps(z1, az));
+        };
+        __m128 vx0, vx1, vy0, vy1, vz0, vz1;
+        transform(eye_matrix_.rvec, vx0, vx1);
+        transform(eye_matrix_.uvec, vy0, vy1);
+        transform(eye_matrix_.fvec, vz0, vz1);
+
+        float min_z = horizontal_min_ps(_mm_min_ps(vz0, vz1));
+        if (min_z < zn_) {
+            // Box crosses the near plane so it cannot be projected (and it is very close to the camera anyway)
+            return false;
+        }
+
+        __m128 half_w = _mm_set1_ps(0.5f * depth_buffer_width);
+        __m128 half_h = _mm_set1_ps(0.5f * depth_buffer_height);
+        __m128 scale_x = _mm_mul_ps(_mm_set1_ps(sx_), half_w);
+        __m128 scale_y = _mm_mul_ps(_mm_set1_ps(-sy_), half_h);
+        __m128 sx0 = _mm_add_ps(_mm_div_ps(_mm_mul_ps(vx0, scale_x), vz0), half_w);
+        __m128 sx1 = _mm_add_ps(_mm_div_ps(_mm_mul_ps(vx1, scale_x), vz1), half_w);
+        __m128 sy0 = _mm_add_ps(_mm_div_ps(_mm_mul_ps(vy0, scale_y), vz0), half_h);
+        __m128 sy1 = _mm_add_ps(_mm_div_ps(_mm_mul_ps(vy1, scale_y), vz1), half_h);
+        float min_x = horizontal_min_ps(_mm_min_ps(sx0, sx1));
+        float max_x = horizontal_max_ps(_mm_max_ps(sx0, sx1));
+        float min_y = horizontal_min_ps(_mm_min_ps(sy0, sy1));
+        float max_y = horizontal_max_ps(_mm_max_ps(sy0, sy1));
+        if (max_x < 0.0f || min_x >= depth_buffer_width || max_y < 0.0f || min_y >= depth_buffer_height) {
+            // Off screen - frustum test takes care of it
+            return false;
+        }
+        int x0 = static_cast<int>(std::max(min_x, 0.0f));
+        int x1 = static_cast<int>(std::min(max_x, depth_buffer_width - 1.0f));
+        int y0 = static_cast<int>(std::max(min_y, 0.0f));
+        int y1 = static_cast<int>(std::min(max_y, depth_buffer_height - 1.0f));
+
+        // Use the finest level where the rectangle covers at most 2x2 texels
+        int level = 0;
+        while (level < num_depth_levels - 1 && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+            ++level;
+        }
+        const std::vector<float>& depth_buffer = depth_levels_[level];
+        int level_w = depth_level_width(level);
+        for (int y = y0 >> level; y <= y1 >> level; ++y) {
+            for (int x = x0 >> level; x <= x1 >> level; ++x) {
+                if (min_z <= depth_buffer[y * level_w + x]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    CullResult OcclusionCuller::test_box(const Vector3& bbox_min, const Vector3& bbox_max) const
+    {
+        Vector3 center = (bbox_min + bbox_max) * 0.5f;
+        Vector3 extents = (bbox_max - bbox_min) * 0.5f;
+        if (is_outside_frustum(center, extents)) {
+            return CullResult::outside_frustum;
+        }
+        if (num_occluder_polygons_ > 0 && is_occluded(bbox_min, bbox_max)) {
+            return CullResult::occluded;
+        }
+        return CullResult::visible;
+    }
+}
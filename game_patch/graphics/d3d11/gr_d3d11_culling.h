@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "../../rf/math/vector.h"
+#include "../../rf/math/matrix.h"
+#include "../../rf/math/plane.h"
+#include "gr_d3d11_transform.h"
+
+namespace df::gr::d3d11
+{
+    enum class CullResult { visible, outside_frustum, occluded };
+
+    // Convex polygons (e.g. big opaque room faces) that hide geometry behind them
+    struct OccluderList
+    {
+        struct Polygon
+        {
+            rf::Plane plane;
+            int start_vertex;
+            int num_vertices;
+        };
+
+        std::vector<Polygon> polygons;
+        std::vector<rf::Vector3> vertices;
+
+        void clear()
+        {
+            polygons.clear();
+            vertices.clear();
+        }
+    };
+
+    // Per-frame CPU culling of bounding boxes against the view frustum and a coarse depth buffer.
+    // Occluders are rasterized conservatively (only pixels fully covered by a polygon are written) with the farthest
+    // depth of the polygon so the depth buffer never hides anything that is visible on the screen. Boxes are tested
+    // against a hierarchical depth buffer (max depth pyramid) so every test reads only a few texels.
+    class OcclusionCuller
+    {
+    public:
+        static constexpr int depth_buffer_width = 128;
+        static constexpr int depth_buffer_height = 64;
+        static constexpr int num_depth_levels = 8;
+
+        // Sets up the frustum for the current camera and clears the depth buffer
+        void begin(const rf::Vector3& eye_pos, const rf::Matrix3& eye_matrix, const Projection& projection);
+        // Rasterizes occluders facing the camera
+        void add_occluders(const OccluderList& occluders);
+        // Builds the depth pyramid. Must be called after all occluders are added and before testing boxes.
+        void finish_occluders();
+        // Tests world space axis aligned bounding box
+        CullResult test_box(const rf::Vector3& bbox_min, const rf::Vector3& bbox_max) const;
+        // Returns true if begin was called in the current frame with the same camera
+        bool is_current(const rf::Vector3& eye_pos, const rf::Matrix3& eye_matrix, const Projection& projection) const;
+
+        int get_num_occluder_polygons() const
+        {
+            return num_occluder_polygons_;
+        }
+
+    private:
+        struct ScreenVertex
+        {
+            float x;
+            float y;
+        };
+
+        bool is_outside_frustum(const rf::Vector3& center, const rf::Vector3& extents) const;
+        bool is_occluded(const rf::Vector3& bbox_min, const rf::Vector3& bbox_max) const;
+        rf::Vector3 to_view_space(const rf::Vector3& pos) const;
+        ScreenVertex to_screen(const rf::Vector3& view_pos) const;
+        void rasterize_triangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, float depth);
+
+        int frame_ = -1;
+        rf::Vector3 eye_pos_;
+        rf::Matrix3 eye_matrix_;
+        float sx_ = 1.0f;
+        float sy_ = 1.0f;
+        float zn_ = 0.1f;
+        // Planes in SoA layout for SSE tests (unused slots never reject anything)
+        std::array<float, 8> plane_nx_{};
+        std::array<float, 8> plane_ny_{};
+        std::array<float, 8> plane_nz_{};
+        std::array<float, 8> plane_d_{};
+        // Depth pyramid - level 0 is the depth buffer, every next level keeps max depth of 2x2 texels.
+        // Depth is a view space Z, uncovered texels are infinitely far.
+        std::array<std::vector<float>, num_depth_levels> depth_levels_;
+        int num_occluder_polygons_ = 0;
+    };
+}
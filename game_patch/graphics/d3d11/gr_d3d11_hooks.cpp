@@ -12,6 +12,8 @@
 #include "../../bmpman/bmpman.h"
 #include "../../main/main.h"
 #include "gr_d3d11.h"
+#include "gr_d3d11_solid.h"
+#include "gr_d3d11_stats.h"
 
 namespace df::gr::d3d11
 {
@@ -195,6 +197,13 @@ namespace df::gr::d3d11
         }
     }
 
+    void update_lightmap(const rf::GLightmap& lightmap, int x, int y, int w, int h)
+    {
+        if (renderer) {
+            renderer->update_lightmap(lightmap, x, y, w, h);
+        }
+    }
+
     void delete_texture(int bm_handle)
     {
         renderer->texture_mark_dirty(bm_handle);
@@ -327,6 +336,10 @@ void gr_d3d11_apply_patch()
     level_page_in_injection.install();
     level_page_out_injection.install();
 
+    // Commands
+    solid_register_commands();
+    render_stats_register_commands();
+
     // Do not use built-in render cache
     AsmWriter{0x004F0B90}.jmp(clear_solid_render_cache); // g_render_cache_clear
     AsmWriter{0x004F0B20}.ret(); // g_render_cache_init
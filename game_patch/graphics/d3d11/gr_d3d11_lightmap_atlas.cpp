@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <windows.h>
+#include <xlog/xlog.h>
+#include "../../rf/geometry.h"
+#include "../../rf/bmpman.h"
+#include "gr_d3d11.h"
+#include "gr_d3d11_lightmap_atlas.h"
+#include "gr_d3d11_texture.h"
+
+using namespace rf;
+
+namespace df::gr::d3d11
+{
+    // Border around every lightmap filled with its edge pixels so bilinear filtering does not pick neighbours
+    constexpr int lightmap_atlas_padding = 2;
+    constexpr int lightmap_atlas_bytes_per_pixel = 3; // FORMAT_888_BGR
+    // 2048 is the maximal texture size supported by all feature levels
+    constexpr std::array<int, 4> lightmap_atlas_page_sizes{256, 512, 1024, 2048};
+
+    struct PackedLightmap
+    {
+        GLightmap* lightmap;
+        int page;
+        int x;
+        int y;
+    };
+
+    // Shelf packing. Lightmaps should be sorted by height (descending). Returns number of pages or 0 if lightmaps
+    // do not fit in max_pages pages.
+    static int pack_lightmaps(const std::vector<GLightmap*>& lightmaps, int page_size, int max_pages,
+        std::vector<PackedLightmap>& packed)
+    {
+        packed.clear();
+        int page = 0;
+        int shelf_x = 0;
+        int shelf_y = 0;
+        int shelf_h = 0;
+        for (GLightmap* lightmap : lightmaps) {
+            int w = lightmap->w + 2 * lightmap_atlas_padding;
+            int h = lightmap->h + 2 * lightmap_atlas_padding;
+            if (shelf_x + w > page_size) {
+                shelf_y += shelf_h;
+                shelf_x = 0;
+                shelf_h = 0;
+            }
+            if (shelf_y + h > page_size) {
+                if (++page >= max_pages) {
+                    return 0;
+                }
+                shelf_x = 0;
+                shelf_y = 0;
+                shelf_h = 0;
+            }
+            packed.push_back({lightmap, page, shelf_x + lightmap_atlas_padding, shelf_y + lightmap_atlas_padding});
+            shelf_x += w;
+            shelf_h = std::max(shelf_h, h);
+        }
+        return page + 1;
+    }
+
+    LightmapAtlas::LightmapAtlas(TextureManager& texture_manager) :
+        texture_manager_{texture_manager}
+    {}
+
+    int LightmapAtlas::acquire_page(int size)
+    {
+        auto it = std::find_if(page_pool_.begin(), page_pool_.end(), [=](const Page& page) {
+            return !page.in_use && page.size == size;
+        });
+        if (it == page_pool_.end()) {
+            int bm_handle = bm::create(bm::FORMAT_888_RGB, size, size);
+            if (bm_handle < 0) {
+                xlog::warn("Failed to create lightmap atlas page {}x{}", size, size);
+                return -1;
+            }
+            std::vector<ubyte> pixels(size * size * lightmap_atlas_bytes_per_pixel);
+            page_pool_.push_back({bm_handle, size, false, std::move(pixels)});
+            it = page_pool_.end() - 1;
+        }
+        it->in_use = true;
+        // Texture is created from page pixels if it gets flushed or marked dirty
+        texture_manager_.set_user_texture_source(it->bm_handle, bm::FORMAT_888_BGR, it->pixels.data(),
+            size * lightmap_atlas_bytes_per_pixel);
+        // Keep the texture alive when the texture cache is flushed
+        texture_manager_.add_ref(it->bm_handle);
+        ++num_pages_in_use_;
+        return it->bm_handle;
+    }
+
+    LightmapAtlas::Page* LightmapAtlas::find_page(int bm_handle)
+    {
+        auto it = std::find_if(page_pool_.begin(), page_pool_.end(), [=](const Page& page) {
+            return page.bm_handle == bm_handle;
+        });
+        return it != page_pool_.end() ? &*it : nullptr;
+    }
+
+    void LightmapAtlas::build(GSolid* solid)
+    {
+        reset();
+
+        std::vector<GLightmap*> lightmaps;
+        for (GSurface* surface : solid->surfaces) {
+            GLightmap* lightmap = surface->lightmap;
+            if (lightmap && lightmap->bm_handle >= 0 && lightmap->buf) {
+                lightmaps.push_back(lightmap);
+            }
+        }
+        std::sort(lightmaps.begin(), lightmaps.end());
+        lightmaps.erase(std::unique(lightmaps.begin(), lightmaps.end()), lightmaps.end());
+
+        int max_page_size = lightmap_atlas_page_sizes.back();
+        auto too_big_it = std::remove_if(lightmaps.begin(), lightmaps.end(), [=](GLightmap* lightmap) {
+            return lightmap->w + 2 * lightmap_atlas_padding > max_page_size
+                || lightmap->h + 2 * lightmap_atlas_padding > max_page_size;
+        });
+        num_skipped_lightmaps_ = lightmaps.end() - too_big_it;
+        lightmaps.erase(too_big_it, lightmaps.end());
+        if (lightmaps.empty()) {
+            return;
+        }
+
+        std::stable_sort(lightmaps.begin(), lightmaps.end(), [](GLightmap* a, GLightmap* b) {
+            return a->h != b->h ? a->h > b->h : a->w > b->w;
+        });
+
+        // Use the smallest page that fits all lightmaps, otherwise as many big pages as needed
+        std::vector<PackedLightmap> packed;
+        int page_size = 0;
+        int num_pages = 0;
+        for (int size : lightmap_atlas_page_sizes) {
+            int max_pages = size == max_page_size ? INT_MAX : 1;
+            num_pages = pack_lightmaps(lightmaps, size, max_pages, packed);
+            if (num_pages > 0) {
+                page_size = size;
+                break;
+            }
+        }
+
+        std::vector<int> page_bm_handles;
+        for (int i = 0; i < num_pages; ++i) {
+            page_bm_handles.push_back(acquire_page(page_size));
+        }
+
+        float inv_page_size = 1.0f / static_cast<float>(page_size);
+        for (const PackedLightmap& p : packed) {
+            int page_bm_handle = page_bm_handles[p.page];
+            if (page_bm_handle < 0) {
+                ++num_skipped_lightmaps_;
+                continue;
+            }
+            LightmapAtlasEntry entry{
+                page_bm_handle,
+                p.x,
+                p.y,
+                static_cast<float>(p.lightmap->w) * inv_page_size,
+                static_cast<float>(p.lightmap->h) * inv_page_size,
+                static_cast<float>(p.x) * inv_page_size,
+                static_cast<float>(p.y) * inv_page_size,
+            };
+            auto [it, inserted] = entries_.emplace(p.lightmap->bm_handle, entry);
+            if (inserted) {
+                upload(it->second, *p.lightmap, 0, 0, p.lightmap->w, p.lightmap->h);
+            }
+        }
+        xlog::info("Packed {} lightmaps into {} atlas pages {}x{} ({} skipped)", entries_.size(), num_pages,
+            page_size, page_size, num_skipped_lightmaps_);
+    }
+
+    void LightmapAtlas::reset()
+    {
+        for (Page& page : page_pool_) {
+            if (page.in_use) {
+                texture_manager_.remove_user_texture_source(page.bm_handle);
+                texture_manager_.remove_ref(page.bm_handle);
+                page.in_use = false;
+            }
+        }
+        num_pages_in_use_ = 0;
+        num_skipped_lightmaps_ = 0;
+        entries_.clear();
+    }
+
+    void LightmapAtlas::update(const GLightmap& lightmap, int x, int y, int w, int h)
+    {
+        const LightmapAtlasEntry* entry = find(lightmap.bm_handle);
+        if (entry) {
+            upload(*entry, lightmap, x, y, w, h);
+        }
+    }
+
+    void LightmapAtlas::upload(const LightmapAtlasEntry& entry, const GLightmap& lightmap, int x, int y, int w, int h)
+    {
+        int x0 = std::clamp(x, 0, lightmap.w);
+        int y0 = std::clamp(y, 0, lightmap.h);
+        int x1 = std::clamp(x + w, x0, lightmap.w);
+        int y1 = std::clamp(y + h, y0, lightmap.h);
+        if (x0 == x1 || y0 == y1) {
+            return;
+        }
+        // Rectangles touching the lightmap edge also refresh the padding
+        x0 = x0 == 0 ? -lightmap_atlas_padding : x0;
+        y0 = y0 == 0 ? -lightmap_atlas_padding : y0;
+        x1 = x1 == lightmap.w ? lightmap.w + lightmap_atlas_padding : x1;
+        y1 = y1 == lightmap.h ? lightmap.h + lightmap_atlas_padding : y1;
+
+        Page* page = find_page(entry.page_bm_handle);
+        if (!page) {
+            return;
+        }
+        // Pixels are written to the page copy first so the texture can be restored later
+        int pitch = page->size * lightmap_atlas_bytes_per_pixel;
+        ubyte* dst_rect = page->pixels.data() + (entry.y + y0) * pitch + (entry.x + x0) * lightmap_atlas_bytes_per_pixel;
+        for (int dst_y = y0; dst_y < y1; ++dst_y) {
+            int src_y = std::clamp(dst_y, 0, lightmap.h - 1);
+            const ubyte* src_row = lightmap.buf + src_y * lightmap.w * lightmap_atlas_bytes_per_pixel;
+            ubyte* dst_ptr = dst_rect + (dst_y - y0) * pitch;
+            for (int dst_x = x0; dst_x < x1; ++dst_x) {
+                int src_x = std::clamp(dst_x, 0, lightmap.w - 1);
+                std::copy_n(src_row + src_x * lightmap_atlas_bytes_per_pixel, lightmap_atlas_bytes_per_pixel, dst_ptr);
+                dst_ptr += lightmap_atlas_bytes_per_pixel;
+            }
+        }
+        texture_manager_.update_texture_region(entry.page_bm_handle, entry.x + x0, entry.y + y0, x1 - x0, y1 - y0,
+            bm::FORMAT_888_BGR, dst_rect, pitch);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "../../rf/os/vtypes.h"
+
+namespace rf
+{
+    struct GSolid;
+    struct GLightmap;
+}
+
+namespace df::gr::d3d11
+{
+    class TextureManager;
+
+    // Placement of a lightmap in an atlas page
+    struct LightmapAtlasEntry
+    {
+        int page_bm_handle;
+        int x;
+        int y;
+        float u_scale;
+        float v_scale;
+        float u_offset;
+        float v_offset;
+
+        float map_u(float u) const
+        {
+            return u_offset + u * u_scale;
+        }
+
+        float map_v(float v) const
+        {
+            return v_offset + v * v_scale;
+        }
+    };
+
+    // Lightmaps of the level geometry packed into a few big textures (pages). Faces that use the same base texture
+    // can be rendered in a single batch no matter which lightmap they use.
+    // Original lightmap bitmaps are not touched - the game still uses them and lightmaps that are not in the atlas
+    // (e.g. lightmaps of movers) are rendered from them.
+    // Pages are user bitmaps so their pixels are kept in RAM and used to restore textures recreated by TextureManager.
+    class LightmapAtlas
+    {
+    public:
+        LightmapAtlas(TextureManager& texture_manager);
+        void build(rf::GSolid* solid);
+        void reset();
+        // Copies a modified rectangle of lightmap pixels (e.g. after geomod) to the atlas
+        void update(const rf::GLightmap& lightmap, int x, int y, int w, int h);
+
+        const LightmapAtlasEntry* find(int lightmap_bm_handle) const
+        {
+            auto it = entries_.find(lightmap_bm_handle);
+            return it != entries_.end() ? &it->second : nullptr;
+        }
+
+        int get_num_pages() const
+        {
+            return num_pages_in_use_;
+        }
+
+        int get_num_lightmaps() const
+        {
+            return entries_.size();
+        }
+
+        int get_num_skipped_lightmaps() const
+        {
+            return num_skipped_lightmaps_;
+        }
+
+    private:
+        struct Page
+        {
+            int bm_handle;
+            int size;
+            bool in_use;
+            // Page pixels in FORMAT_888_BGR
+            std::vector<rf::ubyte> pixels;
+        };
+
+        int acquire_page(int size);
+        Page* find_page(int bm_handle);
+        void upload(const LightmapAtlasEntry& entry, const rf::GLightmap& lightmap, int x, int y, int w, int h);
+
+        TextureManager& texture_manager_;
+        // Bitmaps cannot be released so pages are reused by next levels
+        std::vector<Page> page_pool_;
+        int num_pages_in_use_ = 0;
+        int num_skipped_lightmaps_ = 0;
+        std::unordered_map<int, LightmapAtlasEntry> entries_;
+    };
+}
@@ -4,20 +4,28 @@
 #include <windows.h>
 #include <vector>
 #include <unordered_map>
-#include <map>
 #include <memory>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <string_view>
 #include <common/ComPtr.h>
 #include <xlog/xlog.h>
 #include "../../rf/geometry.h"
+#include "../../rf/bmpman.h"
 #include "../../rf/gr/gr.h"
 #include "../../rf/gr/gr_light.h"
 #include "../../rf/level.h"
+#include "../../rf/os/timer.h"
 #include "../../os/console.h"
 #include "gr_d3d11.h"
 #include "gr_d3d11_solid.h"
 #include "gr_d3d11_shader.h"
 #include "gr_d3d11_context.h"
 #include "gr_d3d11_dynamic_geometry.h"
+#include "gr_d3d11_lightmap_atlas.h"
+#include "gr_d3d11_culling.h"
+#include "gr_d3d11_stats.h"
 
 using namespace rf;
 
@@ -40,6 +48,12 @@ namespace df::gr::d3d11
 
     static auto& set_currently_rendered_room = addr_as_ref<void (GRoom *room)>(0x004D3350);
 
+    static bool state_sorted_solid_rendering = true;
+    static bool lightmap_atlas_enabled = true;
+    static bool occlusion_culling_enabled = true;
+    // Smaller faces are not worth rasterizing as occluders (square meters)
+    static constexpr float min_occluder_face_area = 4.0f;
+
     static gr::Mode sky_room_opaque_mode{
         gr::TEXTURE_SOURCE_WRAP,
         gr::COLOR_SOURCE_TEXTURE,
@@ -74,6 +88,48 @@ namespace df::gr::d3d11
             !face->attributes.is_show_sky();
     }
 
+    // Faces that are always fully opaque so nothing behind them can be seen
+    static inline bool is_occluder_face(GFace* face)
+    {
+        return should_render_face(face) &&
+            !face->attributes.is_see_thru() &&
+            !face->attributes.is_liquid() &&
+            face->attributes.bitmap_id >= 0 &&
+            !bm::has_alpha(face->attributes.bitmap_id);
+    }
+
+    static void collect_room_occluders(GRoom* room, OccluderList& occluders)
+    {
+        occluders.clear();
+        if (room->is_sky) {
+            return;
+        }
+        for (GFace& face : room->face_list) {
+            if (!is_occluder_face(&face)) {
+                continue;
+            }
+            int start_vertex = static_cast<int>(occluders.vertices.size());
+            for (GFaceVertex* fvert = face.edge_loop; fvert; fvert = fvert->next) {
+                occluders.vertices.push_back(fvert->vertex->pos);
+            }
+            int num_vertices = static_cast<int>(occluders.vertices.size()) - start_vertex;
+            // Faces are convex so the area is a sum of triangle fan areas
+            float area = 0.0f;
+            for (int i = 2; i < num_vertices; ++i) {
+                const Vector3& v0 = occluders.vertices[start_vertex];
+                Vector3 a = occluders.vertices[start_vertex + i - 1] - v0;
+                Vector3 b = occluders.vertices[start_vertex + i] - v0;
+                Vector3 cross{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+                area += cross.len() * 0.5f;
+            }
+            if (area < min_occluder_face_area) {
+                occluders.vertices.resize(start_vertex);
+                continue;
+            }
+            occluders.polygons.push_back({face.plane, start_vertex, num_vertices});
+        }
+    }
+
     static inline gr::Mode determine_decal_mode(GDecal* decal)
     {
         if (decal->flags & DF_SELF_ILLUMINATED) {
@@ -122,7 +178,8 @@ namespace df::gr::d3d11
     class SolidGeometryBuffers
     {
     public:
-        SolidGeometryBuffers(const std::vector<GpuVertex>& vb_data, const std::vector<ushort>& ib_data, ID3D11Device* device);
+        SolidGeometryBuffers(const std::vector<GpuVertex>& vb_data, const std::vector<ushort>& ib_data, ID3D11Device* device,
+            D3D11_USAGE usage = D3D11_USAGE_IMMUTABLE);
 
         void bind_buffers(RenderContext& render_context)
         {
@@ -130,12 +187,32 @@ namespace df::gr::d3d11
             render_context.set_index_buffer(index_buffer_);
         }
 
+        // Can be used only if buffers were created with D3D11_USAGE_DEFAULT
+        void update_vertices(ID3D11DeviceContext* device_context, int start, const GpuVertex* data, int count)
+        {
+            update_buffer(device_context, vertex_buffer_, start * sizeof(GpuVertex), data, count * sizeof(GpuVertex));
+        }
+
+        void update_indices(ID3D11DeviceContext* device_context, int start, const ushort* data, int count)
+        {
+            update_buffer(device_context, index_buffer_, start * sizeof(ushort), data, count * sizeof(ushort));
+        }
+
     private:
+        static void update_buffer(ID3D11DeviceContext* device_context, ID3D11Buffer* buffer, UINT offset, const void* data, UINT size)
+        {
+            if (size > 0) {
+                D3D11_BOX box{offset, 0, 0, offset + size, 1, 1};
+                device_context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+            }
+        }
+
         ComPtr<ID3D11Buffer> vertex_buffer_;
         ComPtr<ID3D11Buffer> index_buffer_;
     };
 
-    SolidGeometryBuffers::SolidGeometryBuffers(const std::vector<GpuVertex>& vb_data, const std::vector<ushort>& ib_data, ID3D11Device* device)
+    SolidGeometryBuffers::SolidGeometryBuffers(const std::vector<GpuVertex>& vb_data, const std::vector<ushort>& ib_data, ID3D11Device* device,
+        D3D11_USAGE usage)
     {
         if (vb_data.empty() || ib_data.empty()) {
             return;
@@ -144,7 +221,7 @@ namespace df::gr::d3d11
         CD3D11_BUFFER_DESC vb_desc{
             sizeof(vb_data[0]) * vb_data.size(),
             D3D11_BIND_VERTEX_BUFFER,
-            D3D11_USAGE_IMMUTABLE,
+            usage,
         };
         D3D11_SUBRESOURCE_DATA vb_subres_data{vb_data.data(), 0, 0};
         DF_GR_D3D11_CHECK_HR(
@@ -154,7 +231,7 @@ namespace df::gr::d3d11
         CD3D11_BUFFER_DESC ib_desc{
             sizeof(ib_data[0]) * ib_data.size(),
             D3D11_BIND_INDEX_BUFFER,
-            D3D11_USAGE_IMMUTABLE,
+            usage,
         };
         D3D11_SUBRESOURCE_DATA ib_subres_data{ib_data.data(), 0, 0};
         DF_GR_D3D11_CHECK_HR(
@@ -164,15 +241,25 @@ namespace df::gr::d3d11
 
     struct SolidBatch
     {
-        SolidBatch(int start_index, int num_indices, int base_vertex, std::array<int, 2> textures, rf::gr::Mode mode) :
-            start_index{start_index}, num_indices{num_indices}, base_vertex{base_vertex}, textures{textures}, mode{mode}
+        SolidBatch(int start_index, int num_indices, int base_vertex, int num_vertices, std::array<int, 2> textures, rf::gr::Mode mode, bool is_decal) :
+            start_index{start_index}, num_indices{num_indices}, base_vertex{base_vertex}, num_vertices{num_vertices},
+            textures{textures}, mode{mode}, is_decal{is_decal}
         {}
 
         int start_index;
         int num_indices;
         int base_vertex = 0;
+        int num_vertices;
         std::array<int, 2> textures;
         rf::gr::Mode mode;
+        // Level decals must be rendered after faces
+        bool is_decal;
+    };
+
+    struct VisibleSolidBatch
+    {
+        GRenderCache* cache;
+        const SolidBatch* batch;
     };
 
     class SolidBatches
@@ -206,9 +293,26 @@ namespace df::gr::d3d11
 
         void render(FaceRenderType what, RenderContext& context);
 
+        void render_batch(const SolidBatch& batch, RenderContext& render_context)
+        {
+            geometry_buffers_.bind_buffers(render_context);
+            render_context.set_mode(batch.mode);
+            render_context.set_textures(batch.textures[0], batch.textures[1]);
+            render_context.draw_indexed(batch.num_indices, batch.start_index, batch.base_vertex);
+        }
+
+        void collect_batches(FaceRenderType what, std::vector<VisibleSolidBatch>& visible_batches)
+        {
+            for (const SolidBatch& b : batches_.get_batches(what)) {
+                visible_batches.push_back({this, &b});
+            }
+        }
+
     private:
         SolidBatches batches_;
         SolidGeometryBuffers geometry_buffers_;
+
+        friend class RoomRenderCache;
     };
 
     void GRenderCache::render(FaceRenderType what, RenderContext& render_context)
@@ -231,21 +335,56 @@ namespace df::gr::d3d11
     class GRenderCacheBuilder
     {
     private:
-        // render_type, texture_1, texture_2
-        using FaceBatchKey = std::tuple<FaceRenderType, int, int>;
-        // render_type, texture_1, texture_2, mode
-        using DecalPolyBatchKey = std::tuple<FaceRenderType, int, int, gr::Mode>;
+        // Render state shared by all faces (or level decal polygons) in a batch
+        struct BatchKey
+        {
+            FaceRenderType render_type;
+            std::array<int, 2> textures;
+            gr::Mode mode;
+            bool is_decal;
+
+            bool operator==(const BatchKey& other) const = default;
+        };
+
+        // Either face or decal_poly is set. Key is an index into batch_keys_ until items are sorted.
+        // Lightmap UVs are remapped to the atlas page if lightmap_entry is set.
+        struct BatchItem
+        {
+            uint32_t key;
+            GFace* face;
+            DecalPoly* decal_poly;
+            const LightmapAtlasEntry* lightmap_entry;
+        };
+
+        static constexpr uint32_t empty_batch_key_slot = UINT32_MAX;
 
         int num_verts_ = 0;
         int num_inds_ = 0;
-        std::map<FaceBatchKey, std::vector<GFace*>> batched_faces_;
-        std::map<DecalPolyBatchKey, std::vector<DecalPoly*>> batched_decal_polys_;
+        std::vector<BatchKey> batch_keys_;
+        // Open addressing hash table of batch_keys_ indices
+        std::vector<uint32_t> batch_key_table_;
+        std::vector<BatchItem> items_;
+        const LightmapAtlas* lightmap_atlas_;
         bool is_sky_ = false;
 
+        static std::size_t hash_batch_key(const BatchKey& key);
+        void rehash_batch_keys(std::size_t table_size);
+        uint32_t get_batch_key_index(const BatchKey& key);
+        static void add_face_vertices(GFace* face, const LightmapAtlasEntry* lightmap_entry, std::size_t base_vertex, std::vector<GpuVertex>& vb_data, std::vector<ushort>& ib_data);
+        static void add_decal_poly_vertices(DecalPoly* dp, const LightmapAtlasEntry* lightmap_entry, std::size_t base_vertex, std::vector<GpuVertex>& vb_data, std::vector<ushort>& ib_data);
+        static void radix_sort(std::vector<BatchItem>& items, uint32_t max_key);
+
     public:
+        // Lightmaps found in the atlas are replaced by atlas pages
+        GRenderCacheBuilder(const LightmapAtlas* lightmap_atlas = nullptr) :
+            lightmap_atlas_{lightmap_atlas}
+        {}
+
         void add_solid(GSolid* solid);
         void add_room(GRoom* room, GSolid* solid);
         void add_face(GFace* face, GSolid* solid);
+        // Fills geometry data without touching the GPU. Can be called only once.
+        SolidBatches build_geometry(std::vector<GpuVertex>& vb_data, std::vector<ushort>& ib_data);
         GRenderCache build(ID3D11Device* device);
 
         int get_num_verts() const
@@ -260,7 +399,7 @@ namespace df::gr::d3d11
 
         int get_num_batches() const
         {
-            return batched_faces_.size() + batched_decal_polys_.size();
+            return batch_keys_.size();
         }
 
         friend class GRenderCache;
@@ -318,6 +457,49 @@ namespace df::gr::d3d11
         return FaceRenderType::opaque;
     }
 
+    std::size_t GRenderCacheBuilder::hash_batch_key(const BatchKey& key)
+    {
+        std::size_t h = static_cast<std::size_t>(key.render_type) | (static_cast<std::size_t>(key.is_decal) << 2);
+        h = h * 31 + static_cast<std::size_t>(key.textures[0]);
+        h = h * 31 + static_cast<std::size_t>(key.textures[1]);
+        h = h * 31 + static_cast<std::size_t>(static_cast<int>(key.mode));
+        return h;
+    }
+
+    void GRenderCacheBuilder::rehash_batch_keys(std::size_t table_size)
+    {
+        batch_key_table_.assign(table_size, empty_batch_key_slot);
+        std::size_t mask = table_size - 1;
+        for (std::size_t index = 0; index < batch_keys_.size(); ++index) {
+            std::size_t pos = hash_batch_key(batch_keys_[index]) & mask;
+            while (batch_key_table_[pos] != empty_batch_key_slot) {
+                pos = (pos + 1) & mask;
+            }
+            batch_key_table_[pos] = static_cast<uint32_t>(index);
+        }
+    }
+
+    uint32_t GRenderCacheBuilder::get_batch_key_index(const BatchKey& key)
+    {
+        // Keep load factor below 1/2 so linear probing stays short
+        if (batch_keys_.size() * 2 >= batch_key_table_.size()) {
+            rehash_batch_keys(std::max<std::size_t>(batch_key_table_.size() * 2, 64));
+        }
+        std::size_t mask = batch_key_table_.size() - 1;
+        std::size_t pos = hash_batch_key(key) & mask;
+        while (batch_key_table_[pos] != empty_batch_key_slot) {
+            uint32_t index = batch_key_table_[pos];
+            if (batch_keys_[index] == key) {
+                return index;
+            }
+            pos = (pos + 1) & mask;
+        }
+        auto index = static_cast<uint32_t>(batch_keys_.size());
+        batch_key_table_[pos] = index;
+        batch_keys_.push_back(key);
+        return index;
+    }
+
     void GRenderCacheBuilder::add_face(GFace* face, GSolid* solid)
     {
         if (!should_render_face(face)) {
@@ -326,12 +508,18 @@ namespace df::gr::d3d11
         FaceRenderType render_type = determine_face_render_type(face);
         int face_tex = face->attributes.bitmap_id;
         int lightmap_tex = -1;
+        const LightmapAtlasEntry* lightmap_entry = nullptr;
         if (!is_sky_ && render_type != FaceRenderType::liquid && face->attributes.surface_index >= 0) {
             GSurface* surface = solid->surfaces[face->attributes.surface_index];
             lightmap_tex = surface->lightmap->bm_handle;
+            lightmap_entry = lightmap_atlas_ ? lightmap_atlas_->find(lightmap_tex) : nullptr;
+            if (lightmap_entry) {
+                lightmap_tex = lightmap_entry->page_bm_handle;
+            }
         }
-        FaceBatchKey key = std::make_tuple(render_type, face_tex, lightmap_tex);
-        batched_faces_[key].push_back(face);
+        gr::Mode face_mode = determine_face_mode(render_type, lightmap_tex != -1, is_sky_);
+        BatchKey key{render_type, {face_tex, lightmap_tex}, face_mode, false};
+        items_.push_back({get_batch_key_index(key), face, nullptr, lightmap_entry});
         auto fvert = face->edge_loop;
         int num_fverts = 0;
         while (fvert) {
@@ -347,8 +535,8 @@ namespace df::gr::d3d11
             if (dp->my_decal->flags & DF_LEVEL_DECAL) {
                 rf::gr::Mode mode = determine_decal_mode(dp->my_decal);
                 std::array<int, 2> textures = normalize_texture_handles_for_mode(mode, {dp->my_decal->bitmap_id, lightmap_tex});
-                DecalPolyBatchKey dp_key = std::make_tuple(render_type, textures[0], textures[1], mode);
-                batched_decal_polys_[dp_key].push_back(dp);
+                BatchKey dp_key{render_type, textures, mode, true};
+                items_.push_back({get_batch_key_index(dp_key), nullptr, dp, lightmap_entry});
                 ++num_dp;
             }
             dp = dp->next_for_face;
@@ -357,134 +545,240 @@ namespace df::gr::d3d11
         num_inds_ += (1 + num_dp) * (num_fverts - 2) * 3;
     }
 
-    GRenderCache GRenderCacheBuilder::build(ID3D11Device* device)
+    void GRenderCacheBuilder::add_face_vertices(GFace* face, const LightmapAtlasEntry* lightmap_entry, std::size_t base_vertex, std::vector<GpuVertex>& vb_data, std::vector<ushort>& ib_data)
+    {
+        auto fvert = face->edge_loop;
+        GTextureMover* texture_mover = face->attributes.texture_mover;
+        float u_pan_speed = texture_mover ? texture_mover->u_pan_speed : 0.0f;
+        float v_pan_speed = texture_mover ? texture_mover->v_pan_speed : 0.0f;
+        auto face_start_index = static_cast<ushort>(vb_data.size() - base_vertex);
+        int fvert_index = 0;
+        while (fvert) {
+            auto& gpu_vert = vb_data.emplace_back();
+            gpu_vert.x = fvert->vertex->pos.x;
+            gpu_vert.y = fvert->vertex->pos.y;
+            gpu_vert.z = fvert->vertex->pos.z;
+            Vector3 normal = calculate_face_vertex_normal(fvert, face);
+            gpu_vert.norm = {normal.x, normal.y, normal.z};
+            gpu_vert.diffuse = 0xFFFFFFFF;
+            gpu_vert.u0 = fvert->texture_u;
+            gpu_vert.v0 = fvert->texture_v;
+            gpu_vert.u1 = lightmap_entry ? lightmap_entry->map_u(fvert->lightmap_u) : fvert->lightmap_u;
+            gpu_vert.v1 = lightmap_entry ? lightmap_entry->map_v(fvert->lightmap_v) : fvert->lightmap_v;
+            gpu_vert.u0_pan_speed = u_pan_speed;
+            gpu_vert.v0_pan_speed = v_pan_speed;
+
+            if (fvert_index >= 2) {
+                ib_data.emplace_back(face_start_index);
+                ib_data.emplace_back(face_start_index + fvert_index - 1);
+                ib_data.emplace_back(face_start_index + fvert_index);
+            }
+            ++fvert_index;
+
+            fvert = fvert->next;
+            if (fvert == face->edge_loop) {
+                break;
+            }
+        }
+    }
+
+    void GRenderCacheBuilder::add_decal_poly_vertices(DecalPoly* dp, const LightmapAtlasEntry* lightmap_entry, std::size_t base_vertex, std::vector<GpuVertex>& vb_data, std::vector<ushort>& ib_data)
+    {
+        auto face = dp->face;
+        auto fvert = face->edge_loop;
+        auto face_start_index = static_cast<ushort>(vb_data.size() - base_vertex);
+        int fvert_index = 0;
+        while (fvert) {
+            auto& gpu_vert = vb_data.emplace_back();
+            gpu_vert.x = fvert->vertex->pos.x;
+            gpu_vert.y = fvert->vertex->pos.y;
+            gpu_vert.z = fvert->vertex->pos.z;
+            Vector3 normal = calculate_face_vertex_normal(fvert, face);
+            gpu_vert.norm = {normal.x, normal.y, normal.z};
+            gpu_vert.diffuse = 0xFFFFFFFF;
+            gpu_vert.u0 = dp->uvs[fvert_index].x;
+            gpu_vert.v0 = dp->uvs[fvert_index].y;
+            gpu_vert.u0_pan_speed = 0.0f;
+            gpu_vert.v0_pan_speed = 0.0f;
+            gpu_vert.u1 = lightmap_entry ? lightmap_entry->map_u(fvert->lightmap_u) : fvert->lightmap_u;
+            gpu_vert.v1 = lightmap_entry ? lightmap_entry->map_v(fvert->lightmap_v) : fvert->lightmap_v;
+
+            if (fvert_index >= 2) {
+                ib_data.emplace_back(face_start_index);
+                ib_data.emplace_back(face_start_index + fvert_index - 1);
+                ib_data.emplace_back(face_start_index + fvert_index);
+            }
+            ++fvert_index;
+
+            fvert = fvert->next;
+            if (fvert == face->edge_loop) {
+                break;
+            }
+        }
+    }
+
+    void GRenderCacheBuilder::radix_sort(std::vector<BatchItem>& items, uint32_t max_key)
+    {
+        // LSD radix sort (stable) - faces keep their original order inside a batch
+        std::vector<BatchItem> sorted(items.size());
+        for (unsigned shift = 0; shift < 32 && (max_key >> shift) != 0; shift += 8) {
+            std::array<std::size_t, 256> offsets{};
+            for (const BatchItem& item : items) {
+                ++offsets[(item.key >> shift) & 0xFF];
+            }
+            std::size_t offset = 0;
+            for (std::size_t& count : offsets) {
+                std::size_t next_offset = offset + count;
+                count = offset;
+                offset = next_offset;
+            }
+            for (const BatchItem& item : items) {
+                sorted[offsets[(item.key >> shift) & 0xFF]++] = item;
+            }
+            items.swap(sorted);
+        }
+    }
+
+    SolidBatches GRenderCacheBuilder::build_geometry(std::vector<GpuVertex>& vb_data, std::vector<ushort>& ib_data)
     {
         SolidBatches batches;
-        std::vector<GpuVertex> vb_data;
-        std::vector<ushort> ib_data;
         vb_data.reserve(num_verts_);
         ib_data.reserve(num_inds_);
 
-        for (auto& e : batched_faces_) {
-            const GRenderCacheBuilder::FaceBatchKey& key = e.first;
-            auto& faces = e.second;
-            auto [render_type, texture_1, texture_2] = key;
-            std::size_t start_index = ib_data.size();
-            std::size_t base_vertex = vb_data.size();
-
-            for (GFace* face : faces) {
-                auto fvert = face->edge_loop;
-                GTextureMover* texture_mover = face->attributes.texture_mover;
-                float u_pan_speed = texture_mover ? texture_mover->u_pan_speed : 0.0f;
-                float v_pan_speed = texture_mover ? texture_mover->v_pan_speed : 0.0f;
-                auto face_start_index = static_cast<ushort>(vb_data.size() - base_vertex);
-                int fvert_index = 0;
-                while (fvert) {
-                    auto& gpu_vert = vb_data.emplace_back();
-                    gpu_vert.x = fvert->vertex->pos.x;
-                    gpu_vert.y = fvert->vertex->pos.y;
-                    gpu_vert.z = fvert->vertex->pos.z;
-                    Vector3 normal = calculate_face_vertex_normal(fvert, face);
-                    gpu_vert.norm = {normal.x, normal.y, normal.z};
-                    gpu_vert.diffuse = 0xFFFFFFFF;
-                    gpu_vert.u0 = fvert->texture_u;
-                    gpu_vert.v0 = fvert->texture_v;
-                    gpu_vert.u1 = fvert->lightmap_u;
-                    gpu_vert.v1 = fvert->lightmap_v;
-                    gpu_vert.u0_pan_speed = u_pan_speed;
-                    gpu_vert.v0_pan_speed = v_pan_speed;
-
-                    if (fvert_index >= 2) {
-                        ib_data.emplace_back(face_start_index);
-                        ib_data.emplace_back(face_start_index + fvert_index - 1);
-                        ib_data.emplace_back(face_start_index + fvert_index);
-                    }
-                    ++fvert_index;
+        if (items_.empty()) {
+            return batches;
+        }
 
-                    fvert = fvert->next;
-                    if (fvert == face->edge_loop) {
-                        break;
-                    }
-                }
-            }
-            std::size_t num_indices = ib_data.size() - start_index;
-            std::array<int, 2> textures = {texture_1, texture_2};
-            gr::Mode mode = determine_face_mode(render_type, texture_2 != -1, is_sky_);
-            batches.get_batches(render_type).emplace_back(
-                start_index, num_indices, base_vertex, textures, mode
-            );
+        // Replace batch key indices by their rank so batches are ordered like before: faces first, then level decals,
+        // each group ordered by render type, textures and mode
+        std::vector<uint32_t> sorted_key_indices(batch_keys_.size());
+        std::iota(sorted_key_indices.begin(), sorted_key_indices.end(), 0);
+        std::sort(sorted_key_indices.begin(), sorted_key_indices.end(), [this](uint32_t a, uint32_t b) {
+            const BatchKey& ka = batch_keys_[a];
+            const BatchKey& kb = batch_keys_[b];
+            return std::make_tuple(ka.is_decal, ka.render_type, ka.textures[0], ka.textures[1], static_cast<int>(ka.mode))
+                < std::make_tuple(kb.is_decal, kb.render_type, kb.textures[0], kb.textures[1], static_cast<int>(kb.mode));
+        });
+        std::vector<uint32_t> key_ranks(batch_keys_.size());
+        for (std::size_t rank = 0; rank < sorted_key_indices.size(); ++rank) {
+            key_ranks[sorted_key_indices[rank]] = static_cast<uint32_t>(rank);
         }
-        for (auto& e : batched_decal_polys_) {
-            const GRenderCacheBuilder::DecalPolyBatchKey& key = e.first;
-            auto& dps = e.second;
-            auto [render_type, texture_1, texture_2, mode] = key;
+        for (BatchItem& item : items_) {
+            item.key = key_ranks[item.key];
+        }
+        radix_sort(items_, static_cast<uint32_t>(batch_keys_.size() - 1));
+
+        // Every run of items with the same key becomes a single batch
+        for (std::size_t run_start = 0; run_start < items_.size();) {
+            uint32_t rank = items_[run_start].key;
+            const BatchKey& key = batch_keys_[sorted_key_indices[rank]];
             std::size_t start_index = ib_data.size();
             std::size_t base_vertex = vb_data.size();
-            for (DecalPoly* dp : dps) {
-                auto face = dp->face;
-                auto fvert = face->edge_loop;
-                auto face_start_index = static_cast<ushort>(vb_data.size() - base_vertex);
-                int fvert_index = 0;
-                while (fvert) {
-                    auto& gpu_vert = vb_data.emplace_back();
-                    gpu_vert.x = fvert->vertex->pos.x;
-                    gpu_vert.y = fvert->vertex->pos.y;
-                    gpu_vert.z = fvert->vertex->pos.z;
-                    Vector3 normal = calculate_face_vertex_normal(fvert, face);
-                    gpu_vert.norm = {normal.x, normal.y, normal.z};
-                    gpu_vert.diffuse = 0xFFFFFFFF;
-                    gpu_vert.u0 = dp->uvs[fvert_index].x;
-                    gpu_vert.v0 = dp->uvs[fvert_index].y;
-                    gpu_vert.u0_pan_speed = 0.0f;
-                    gpu_vert.v0_pan_speed = 0.0f;
-                    gpu_vert.u1 = fvert->lightmap_u;
-                    gpu_vert.v1 = fvert->lightmap_v;
-
-                    if (fvert_index >= 2) {
-                        ib_data.emplace_back(face_start_index);
-                        ib_data.emplace_back(face_start_index + fvert_index - 1);
-                        ib_data.emplace_back(face_start_index + fvert_index);
-                    }
-                    ++fvert_index;
-
-                    fvert = fvert->next;
-                    if (fvert == face->edge_loop) {
-                        break;
-                    }
+            std::size_t run_end = run_start;
+            for (; run_end < items_.size() && items_[run_end].key == rank; ++run_end) {
+                const BatchItem& item = items_[run_end];
+                if (item.decal_poly) {
+                    add_decal_poly_vertices(item.decal_poly, item.lightmap_entry, base_vertex, vb_data, ib_data);
+                }
+                else {
+                    add_face_vertices(item.face, item.lightmap_entry, base_vertex, vb_data, ib_data);
                 }
             }
-            int num_indices = ib_data.size() - start_index;
-            std::array<int, 2> textures = {texture_1, texture_2};
-            batches.get_batches(render_type).emplace_back(
-                start_index, num_indices, base_vertex, textures, mode
+            std::size_t num_indices = ib_data.size() - start_index;
+            std::size_t num_vertices = vb_data.size() - base_vertex;
+            batches.get_batches(key.render_type).emplace_back(
+                start_index, num_indices, base_vertex, num_vertices, key.textures, key.mode, key.is_decal
             );
+            run_start = run_end;
         }
+        return batches;
+    }
 
+    GRenderCache GRenderCacheBuilder::build(ID3D11Device* device)
+    {
+        std::vector<GpuVertex> vb_data;
+        std::vector<ushort> ib_data;
+        SolidBatches batches = build_geometry(vb_data, ib_data);
         SolidGeometryBuffers geometry_buffers{vb_data, ib_data, device};
         return GRenderCache{batches, geometry_buffers};
     }
 
+    static constexpr std::array<FaceRenderType, 3> all_face_render_types{
+        FaceRenderType::opaque,
+        FaceRenderType::alpha,
+        FaceRenderType::liquid,
+    };
+
+    static std::size_t hash_batch_data(const GpuVertex* vertices, int num_vertices, const ushort* indices, int num_indices)
+    {
+        std::string_view vertex_bytes{reinterpret_cast<const char*>(vertices), num_vertices * sizeof(GpuVertex)};
+        std::string_view index_bytes{reinterpret_cast<const char*>(indices), num_indices * sizeof(ushort)};
+        std::size_t h = std::hash<std::string_view>{}(vertex_bytes);
+        return h ^ (std::hash<std::string_view>{}(index_bytes) + 0x9E3779B9 + (h << 6) + (h >> 2));
+    }
+
+    // Normal rooms can be modified by geomod. Every batch gets its own range of the room buffers with some spare
+    // space, so after geomod only batches that changed are uploaded and they can usually grow in place. Batches that
+    // do not fit in their range are moved to free space at the end of the buffers. Space left behind is reclaimed by
+    // rebuilding the cache later (compaction).
     class RoomRenderCache
     {
     public:
-        RoomRenderCache(rf::GSolid* solid, rf::GRoom* room, ID3D11Device* device);
+        RoomRenderCache(rf::GSolid* solid, rf::GRoom* room, const LightmapAtlas* lightmap_atlas, ID3D11Device* device);
         ~RoomRenderCache() {}
         void render(FaceRenderType render_type, ID3D11Device* device, RenderContext& context);
+        // Updates the cache if it was invalidated by geomod. Returns nothing if room has no visible faces.
+        GRenderCache* prepare(ID3D11Device* device, RenderContext& context);
 
         rf::GRoom* room() const
         {
             return room_;
         }
 
+        const OccluderList& occluders() const
+        {
+            return occluders_;
+        }
+
     private:
+        // Range of the room buffers reserved for a single batch
+        struct BatchAllocation
+        {
+            FaceRenderType render_type;
+            std::array<int, 2> textures;
+            gr::Mode mode;
+            bool is_decal;
+            int vertex_start;
+            int vertex_capacity;
+            int index_start;
+            int index_capacity;
+            std::size_t data_hash;
+        };
+
         char padding_[0x20];
         int state_ = 0; // modified by the game engine during geomod operation
         rf::GRoom* room_;
         rf::GSolid* solid_;
+        const LightmapAtlas* lightmap_atlas_;
         std::optional<GRenderCache> cache_;
-
-        void update(ID3D11Device* device);
+        std::vector<BatchAllocation> allocations_;
+        int vb_capacity_ = 0;
+        int ib_capacity_ = 0;
+        int vb_used_ = 0;
+        int ib_used_ = 0;
+        int vb_wasted_ = 0;
+        int ib_wasted_ = 0;
+        OccluderList occluders_;
+
+        void update(ID3D11Device* device, ID3D11DeviceContext* device_context);
+        void rebuild(SolidBatches& batches, const std::vector<GpuVertex>& vb_data, const std::vector<ushort>& ib_data,
+            ID3D11Device* device);
+        bool patch(SolidBatches& batches, const std::vector<GpuVertex>& vb_data, const std::vector<ushort>& ib_data,
+            ID3D11DeviceContext* device_context);
+        static BatchAllocation allocate(FaceRenderType render_type, const SolidBatch& batch, std::size_t data_hash,
+            int& vb_used, int& ib_used);
         bool invalid() const;
+        bool needs_compaction() const;
     };
 
     inline bool RoomRenderCache::invalid() const
@@ -496,48 +790,211 @@ namespace df::gr::d3d11
         return state_ == 2;
     }
 
-    RoomRenderCache::RoomRenderCache(GSolid* solid, GRoom* room, ID3D11Device* device) :
-        room_(room), solid_(solid)
+    inline bool RoomRenderCache::needs_compaction() const
+    {
+        return vb_wasted_ > vb_used_ / 2 || ib_wasted_ > ib_used_ / 2;
+    }
+
+    RoomRenderCache::RoomRenderCache(GSolid* solid, GRoom* room, const LightmapAtlas* lightmap_atlas, ID3D11Device* device) :
+        room_(room), solid_(solid), lightmap_atlas_(lightmap_atlas)
     {
-        update(device);
+        update(device, nullptr);
+    }
+
+    RoomRenderCache::BatchAllocation RoomRenderCache::allocate(FaceRenderType render_type, const SolidBatch& batch,
+        std::size_t data_hash, int& vb_used, int& ib_used)
+    {
+        // Spare space lets batches grow a bit without moving them
+        int vertex_capacity = batch.num_vertices + batch.num_vertices / 4 + 8;
+        int index_capacity = batch.num_indices + batch.num_indices / 4 + 24;
+        BatchAllocation alloc{
+            render_type, batch.textures, batch.mode, batch.is_decal,
+            vb_used, vertex_capacity,
+            ib_used, index_capacity,
+            data_hash,
+        };
+        vb_used += vertex_capacity;
+        ib_used += index_capacity;
+        return alloc;
+    }
+
+    void RoomRenderCache::rebuild(SolidBatches& batches, const std::vector<GpuVertex>& vb_data,
+        const std::vector<ushort>& ib_data, ID3D11Device* device)
+    {
+        allocations_.clear();
+        vb_used_ = 0;
+        ib_used_ = 0;
+        vb_wasted_ = 0;
+        ib_wasted_ = 0;
+        for (FaceRenderType render_type : all_face_render_types) {
+            for (SolidBatch& b : batches.get_batches(render_type)) {
+                std::size_t data_hash = hash_batch_data(&vb_data[b.base_vertex], b.num_vertices,
+                    &ib_data[b.start_index], b.num_indices);
+                allocations_.push_back(allocate(render_type, b, data_hash, vb_used_, ib_used_));
+            }
+        }
+        // Free space at the end is used by batches that outgrow their ranges
+        vb_capacity_ = vb_used_ + vb_used_ / 4;
+        ib_capacity_ = ib_used_ + ib_used_ / 4;
+
+        std::vector<GpuVertex> vb_layout(vb_capacity_);
+        std::vector<ushort> ib_layout(ib_capacity_);
+        auto alloc_it = allocations_.begin();
+        for (FaceRenderType render_type : all_face_render_types) {
+            for (SolidBatch& b : batches.get_batches(render_type)) {
+                std::copy_n(vb_data.begin() + b.base_vertex, b.num_vertices, vb_layout.begin() + alloc_it->vertex_start);
+                std::copy_n(ib_data.begin() + b.start_index, b.num_indices, ib_layout.begin() + alloc_it->index_start);
+                b.base_vertex = alloc_it->vertex_start;
+                b.start_index = alloc_it->index_start;
+                ++alloc_it;
+            }
+        }
+        cache_.emplace(batches, SolidGeometryBuffers{vb_layout, ib_layout, device, D3D11_USAGE_DEFAULT});
+    }
+
+    bool RoomRenderCache::patch(SolidBatches& batches, const std::vector<GpuVertex>& vb_data,
+        const std::vector<ushort>& ib_data, ID3D11DeviceContext* device_context)
+    {
+        struct Upload
+        {
+            const SolidBatch* batch;
+            int vertex_start;
+            int index_start;
+        };
+        std::vector<BatchAllocation> new_allocations;
+        std::vector<Upload> uploads;
+        std::vector<bool> old_allocation_used(allocations_.size());
+        int vb_used = vb_used_;
+        int ib_used = ib_used_;
+        int vb_wasted = vb_wasted_;
+        int ib_wasted = ib_wasted_;
+
+        for (FaceRenderType render_type : all_face_render_types) {
+            for (const SolidBatch& b : batches.get_batches(render_type)) {
+                std::size_t data_hash = hash_batch_data(&vb_data[b.base_vertex], b.num_vertices,
+                    &ib_data[b.start_index], b.num_indices);
+                // Note: batch and its decal counterpart have the same textures and mode so every allocation can be
+                // matched only once
+                auto old_it = std::find_if(allocations_.begin(), allocations_.end(), [&](const BatchAllocation& a) {
+                    return !old_allocation_used[&a - allocations_.data()] && a.render_type == render_type &&
+                        a.textures == b.textures && a.mode == b.mode && a.is_decal == b.is_decal;
+                });
+                if (old_it != allocations_.end()) {
+                    old_allocation_used[old_it - allocations_.begin()] = true;
+                    if (old_it->data_hash == data_hash) {
+                        // Batch was not affected
+                        new_allocations.push_back(*old_it);
+                        continue;
+                    }
+                    if (b.num_vertices <= old_it->vertex_capacity && b.num_indices <= old_it->index_capacity) {
+                        new_allocations.push_back(*old_it);
+                        new_allocations.back().data_hash = data_hash;
+                        uploads.push_back({&b, old_it->vertex_start, old_it->index_start});
+                        continue;
+                    }
+                    vb_wasted += old_it->vertex_capacity;
+                    ib_wasted += old_it->index_capacity;
+                }
+                new_allocations.push_back(allocate(render_type, b, data_hash, vb_used, ib_used));
+                uploads.push_back({&b, new_allocations.back().vertex_start, new_allocations.back().index_start});
+            }
+        }
+        if (vb_used > vb_capacity_ || ib_used > ib_capacity_) {
+            // Out of free space - whole cache has to be rebuilt
+            return false;
+        }
+        for (std::size_t i = 0; i < allocations_.size(); ++i) {
+            if (!old_allocation_used[i]) {
+                vb_wasted += allocations_[i].vertex_capacity;
+                ib_wasted += allocations_[i].index_capacity;
+            }
+        }
+
+        SolidGeometryBuffers& geometry_buffers = cache_.value().geometry_buffers_;
+        for (const Upload& upload : uploads) {
+            geometry_buffers.update_vertices(device_context, upload.vertex_start, &vb_data[upload.batch->base_vertex],
+                upload.batch->num_vertices);
+            geometry_buffers.update_indices(device_context, upload.index_start, &ib_data[upload.batch->start_index],
+                upload.batch->num_indices);
+        }
+        auto alloc_it = new_allocations.begin();
+        for (FaceRenderType render_type : all_face_render_types) {
+            for (SolidBatch& b : batches.get_batches(render_type)) {
+                b.base_vertex = alloc_it->vertex_start;
+                b.start_index = alloc_it->index_start;
+                ++alloc_it;
+            }
+        }
+        cache_.value().batches_ = batches;
+        allocations_ = std::move(new_allocations);
+        vb_used_ = vb_used;
+        ib_used_ = ib_used;
+        vb_wasted_ = vb_wasted;
+        ib_wasted_ = ib_wasted;
+        xlog::debug("Patched render cache for room {} - uploaded {} of {} batches", room_->room_index, uploads.size(),
+            allocations_.size());
+        return true;
     }
 
-    void RoomRenderCache::update(ID3D11Device* device)
+    void RoomRenderCache::update(ID3D11Device* device, ID3D11DeviceContext* device_context)
     {
-        GRenderCacheBuilder builder;
+        GRenderCacheBuilder builder{lightmap_atlas_};
         builder.add_room(room_, solid_);
+        state_ = 0;
+        collect_room_occluders(room_, occluders_);
 
         if (builder.get_num_batches() == 0) {
-            state_ = 0;
             xlog::debug("Skipping empty room {}", room_->room_index);
+            cache_.reset();
+            allocations_.clear();
+            return;
+        }
+
+        std::vector<GpuVertex> vb_data;
+        std::vector<ushort> ib_data;
+        SolidBatches batches = builder.build_geometry(vb_data, ib_data);
+        if (cache_ && device_context && patch(batches, vb_data, ib_data, device_context)) {
             return;
         }
 
         xlog::debug("Creating render cache for room {} - verts {} inds {} batches {}", room_->room_index,
             builder.get_num_verts(), builder.get_num_inds(), builder.get_num_batches());
-
-        cache_ = std::optional{builder.build(device)};
-
-        state_ = 0;
+        rebuild(batches, vb_data, ib_data, device);
     }
 
-    void RoomRenderCache::render(FaceRenderType render_type, ID3D11Device* device, RenderContext& context)
+    GRenderCache* RoomRenderCache::prepare(ID3D11Device* device, RenderContext& context)
     {
         if (invalid()) {
             xlog::debug("Room {} render cache invalidated!", room_->room_index);
-            cache_.reset();
-            update(device);
+            int start_us = rf::timer_get_microseconds();
+            update(device, context.device_context());
+            ++render_stats.num_room_cache_updates;
+            render_stats.room_cache_update_time_us += rf::timer_get_microseconds() - start_us;
+        }
+        else if (needs_compaction() && render_stats.num_room_cache_updates == 0 && render_stats.num_room_cache_compactions == 0) {
+            // Compact at most one room per frame and only in frames without geomod updates to avoid spikes
+            xlog::debug("Compacting render cache for room {}", room_->room_index);
+            int start_us = rf::timer_get_microseconds();
+            update(device, nullptr);
+            ++render_stats.num_room_cache_compactions;
+            render_stats.room_cache_update_time_us += rf::timer_get_microseconds() - start_us;
         }
+        return cache_ ? &cache_.value() : nullptr;
+    }
 
-        if (cache_) {
-            cache_.value().render(render_type, context);
+    void RoomRenderCache::render(FaceRenderType render_type, ID3D11Device* device, RenderContext& context)
+    {
+        GRenderCache* cache = prepare(device, context);
+        if (cache) {
+            cache->render(render_type, context);
         }
     }
 
     SolidRenderer::SolidRenderer(ComPtr<ID3D11Device> device, ShaderManager& shader_manager,
-        [[maybe_unused]] StateManager& state_manager, DynamicGeometryRenderer& dyn_geo_renderer,
-        RenderContext& render_context) :
-        device_{std::move(device)}, context_{render_context.device_context()}, dyn_geo_renderer_{dyn_geo_renderer}, render_context_(render_context)
+        [[maybe_unused]] StateManager& state_manager, TextureManager& texture_manager,
+        DynamicGeometryRenderer& dyn_geo_renderer, RenderContext& render_context) :
+        device_{std::move(device)}, context_{render_context.device_context()}, dyn_geo_renderer_{dyn_geo_renderer},
+        render_context_(render_context), lightmap_atlas_{texture_manager}
     {
         vertex_shader_ = shader_manager.get_vertex_shader(VertexShaderId::standard);
         pixel_shader_ = shader_manager.get_pixel_shader(PixelShaderId::standard);
@@ -649,7 +1106,7 @@ namespace df::gr::d3d11
         auto cache = reinterpret_cast<RoomRenderCache*>(room->geo_cache);
         if (!cache) {
             xlog::debug("Creating render cache for room {}", room->room_index);
-            room_cache_.push_back(std::make_unique<RoomRenderCache>(solid, room, device_));
+            room_cache_.push_back(std::make_unique<RoomRenderCache>(solid, room, get_lightmap_atlas(), device_));
             cache = room_cache_.back().get();
             room->geo_cache = reinterpret_cast<GCache*>(cache);
             geo_cache_rooms[geo_cache_num_rooms++] = room;
@@ -669,7 +1126,7 @@ namespace df::gr::d3d11
         auto cache = reinterpret_cast<GRenderCache*>(room->geo_cache);
         if (!cache) {
             xlog::debug("Creating render cache for detail room {}", room->room_index);
-            GRenderCacheBuilder builder;
+            GRenderCacheBuilder builder{get_lightmap_atlas()};
             builder.add_room(room, solid);
             detail_render_cache_.push_back(std::make_unique<GRenderCache>(builder.build(device_)));
             cache = detail_render_cache_.back().get();
@@ -705,6 +1162,9 @@ namespace df::gr::d3d11
     void SolidRenderer::render_movable_solid(GSolid* solid, const Vector3& pos, const Matrix3& orient)
     {
         xlog::trace("Rendering movable solid {}", solid);
+        if (!is_movable_solid_visible(solid, pos, orient)) {
+            return;
+        }
         GRenderCache* cache = get_or_create_movable_solid_cache(solid);
         before_render(pos, orient);
         cache->render(FaceRenderType::opaque, render_context_);
@@ -719,7 +1179,7 @@ namespace df::gr::d3d11
         auto it = mover_render_cache_.find(solid);
         if (it == mover_render_cache_.end()) {
             xlog::debug("Creating render cache for a mover {}", static_cast<void*>(solid));
-            GRenderCacheBuilder cache_builder;
+            GRenderCacheBuilder cache_builder{get_lightmap_atlas()};
             cache_builder.add_solid(solid);
             GRenderCache cache = cache_builder.build(device_);
             auto p = mover_render_cache_.emplace(std::make_pair(solid, std::make_unique<GRenderCache>(cache)));
@@ -735,6 +1195,9 @@ namespace df::gr::d3d11
             // Happens when glass is killed
             return;
         }
+        if (!is_detail_room_visible(room)) {
+            return;
+        }
         before_render(rf::zero_vector, rf::identity_matrix);
         render_detail(solid, room, true);
         if (decals_enabled) {
@@ -756,16 +1219,25 @@ namespace df::gr::d3d11
 
         before_render(rf::zero_vector, rf::identity_matrix);
 
-        for (int i = 0; i < num_rooms; ++i) {
-            auto room = rooms[i];
+        if (occlusion_culling_enabled) {
+            build_occlusion_buffer(solid, rooms, num_rooms);
+        }
 
-            render_room_faces(solid, room, FaceRenderType::opaque);
+        if (state_sorted_solid_rendering) {
+            render_solid_state_sorted(solid, rooms, num_rooms);
+        }
+        else {
+            for (int i = 0; i < num_rooms; ++i) {
+                auto room = rooms[i];
 
-            // Note: calling set_currently_rendered_room could improve culling here but it breaks some levels
-            // if a detail brush is contained in multiple normal rooms
-            for (GRoom* detail_room : room->detail_rooms) {
-                if (detail_room->room_to_render_with == room && !gr::cull_bounding_box(detail_room->bbox_min, detail_room->bbox_max)) {
-                    render_detail(solid, detail_room, false);
+                render_room_faces(solid, room, FaceRenderType::opaque);
+
+                // Note: calling set_currently_rendered_room could improve culling here but it breaks some levels
+                // if a detail brush is contained in multiple normal rooms
+                for (GRoom* detail_room : room->detail_rooms) {
+                    if (detail_room->room_to_render_with == room && is_detail_room_visible(detail_room)) {
+                        render_detail(solid, detail_room, false);
+                    }
                 }
             }
         }
@@ -778,6 +1250,120 @@ namespace df::gr::d3d11
         render_context_.update_lights();
     }
 
+    void SolidRenderer::render_solid_state_sorted(rf::GSolid* solid, rf::GRoom** rooms, int num_rooms)
+    {
+        // Opaque batches of all visible rooms are rendered together ordered by render state so every texture and
+        // mode is set only once per frame instead of once per room
+        visible_batches_.clear();
+        for (int i = 0; i < num_rooms; ++i) {
+            auto room = rooms[i];
+            RoomRenderCache* room_cache = get_or_create_normal_room_cache(solid, room);
+            GRenderCache* cache = room_cache->prepare(device_, render_context_);
+            if (cache) {
+                cache->collect_batches(FaceRenderType::opaque, visible_batches_);
+            }
+            for (GRoom* detail_room : room->detail_rooms) {
+                if (detail_room->room_to_render_with == room && is_detail_room_visible(detail_room)) {
+                    get_or_create_detail_room_cache(solid, detail_room)->collect_batches(FaceRenderType::opaque, visible_batches_);
+                }
+            }
+        }
+
+        // Stable sort keeps rooms in the portal traversal order inside a state bucket
+        std::stable_sort(visible_batches_.begin(), visible_batches_.end(), [](const VisibleSolidBatch& a, const VisibleSolidBatch& b) {
+            return std::make_tuple(a.batch->is_decal, static_cast<int>(a.batch->mode), a.batch->textures[0], a.batch->textures[1])
+                < std::make_tuple(b.batch->is_decal, static_cast<int>(b.batch->mode), b.batch->textures[0], b.batch->textures[1]);
+        });
+
+        const SolidBatch* prev_batch = nullptr;
+        for (const VisibleSolidBatch& vb : visible_batches_) {
+            if (!prev_batch || prev_batch->is_decal != vb.batch->is_decal || prev_batch->mode != vb.batch->mode
+                || prev_batch->textures != vb.batch->textures) {
+                ++render_stats.num_solid_state_buckets;
+            }
+            vb.cache->render_batch(*vb.batch, render_context_);
+            prev_batch = vb.batch;
+        }
+        render_stats.num_solid_batches += static_cast<int>(visible_batches_.size());
+    }
+
+    void SolidRenderer::build_occlusion_buffer(rf::GSolid* solid, rf::GRoom** rooms, int num_rooms)
+    {
+        // Occluders are updated together with render caches after geomod
+        for (int i = 0; i < num_rooms; ++i) {
+            get_or_create_normal_room_cache(solid, rooms[i])->prepare(device_, render_context_);
+        }
+        int start_us = rf::timer_get_microseconds();
+        culler_.begin(gr::eye_pos, gr::eye_matrix, render_context_.projection());
+        for (int i = 0; i < num_rooms; ++i) {
+            culler_.add_occluders(get_or_create_normal_room_cache(solid, rooms[i])->occluders());
+        }
+        culler_.finish_occluders();
+        render_stats.num_occluder_polygons += culler_.get_num_occluder_polygons();
+        render_stats.culling_time_us += rf::timer_get_microseconds() - start_us;
+    }
+
+    CullResult SolidRenderer::cull_box(const rf::Vector3& bbox_min, const rf::Vector3& bbox_max)
+    {
+        if (!occlusion_culling_enabled) {
+            return CullResult::visible;
+        }
+        int start_us = rf::timer_get_microseconds();
+        if (!culler_.is_current(gr::eye_pos, gr::eye_matrix, render_context_.projection())) {
+            // Level geometry was not rendered from this camera (e.g. monitors) so only the frustum can be used
+            culler_.begin(gr::eye_pos, gr::eye_matrix, render_context_.projection());
+            culler_.finish_occluders();
+        }
+        CullResult result = culler_.test_box(bbox_min, bbox_max);
+        render_stats.culling_time_us += rf::timer_get_microseconds() - start_us;
+        return result;
+    }
+
+    static bool count_cull_result(CullResult result, RenderStats::CullCounters& counters)
+    {
+        switch (result) {
+            case CullResult::outside_frustum:
+                ++counters.num_outside_frustum;
+                return false;
+            case CullResult::occluded:
+                ++counters.num_occluded;
+                return false;
+            default:
+                ++counters.num_drawn;
+                return true;
+        }
+    }
+
+    bool SolidRenderer::is_detail_room_visible(rf::GRoom* detail_room)
+    {
+        // Game culling is kept - the culler only tests boxes that passed it
+        CullResult result = gr::cull_bounding_box(detail_room->bbox_min, detail_room->bbox_max)
+            ? CullResult::outside_frustum
+            : cull_box(detail_room->bbox_min, detail_room->bbox_max);
+        return count_cull_result(result, render_stats.detail_rooms);
+    }
+
+    bool SolidRenderer::is_movable_solid_visible(rf::GSolid* solid, const rf::Vector3& pos, const rf::Matrix3& orient)
+    {
+        const Vector3& bbox_min = solid->bbox_min;
+        const Vector3& bbox_max = solid->bbox_max;
+        if (bbox_min.x > bbox_max.x || bbox_min.y > bbox_max.y || bbox_min.z > bbox_max.z) {
+            // Bounding box is not known
+            return count_cull_result(CullResult::visible, render_stats.movers);
+        }
+        // Axis aligned box containing the rotated local bounding box
+        Vector3 center = (bbox_min + bbox_max) * 0.5f;
+        Vector3 extents = (bbox_max - bbox_min) * 0.5f;
+        Vector3 world_center = pos + orient.rvec * center.x + orient.uvec * center.y + orient.fvec * center.z;
+        Vector3 world_extents{
+            std::abs(orient.rvec.x) * extents.x + std::abs(orient.uvec.x) * extents.y + std::abs(orient.fvec.x) * extents.z,
+            std::abs(orient.rvec.y) * extents.x + std::abs(orient.uvec.y) * extents.y + std::abs(orient.fvec.y) * extents.z,
+            std::abs(orient.rvec.z) * extents.x + std::abs(orient.uvec.z) * extents.y + std::abs(orient.fvec.z) * extents.z,
+        };
+        CullResult result = cull_box(world_center - world_extents, world_center + world_extents);
+        return count_cull_result(result, render_stats.movers);
+    }
+
     void SolidRenderer::before_render(const rf::Vector3& pos, const rf::Matrix3& orient)
     {
         render_context_.set_vertex_shader(vertex_shader_);
@@ -787,8 +1373,18 @@ namespace df::gr::d3d11
         render_context_.set_primitive_topology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     }
 
+    const LightmapAtlas* SolidRenderer::get_lightmap_atlas() const
+    {
+        return lightmap_atlas_enabled ? &lightmap_atlas_ : nullptr;
+    }
+
     void SolidRenderer::page_in_solid(rf::GSolid* solid)
     {
+        if (solid == rf::level.geometry) {
+            // Caches created earlier could use a stale atlas layout
+            clear_cache();
+            lightmap_atlas_.build(solid);
+        }
         for (rf::GRoom* room: solid->cached_normal_room_list) {
             get_or_create_normal_room_cache(solid, room);
         }
@@ -796,4 +1392,90 @@ namespace df::gr::d3d11
             get_or_create_detail_room_cache(solid, room);
         }
     }
+
+    void SolidRenderer::update_lightmap(const rf::GLightmap& lightmap, int x, int y, int w, int h)
+    {
+        lightmap_atlas_.update(lightmap, x, y, w, h);
+    }
+
+    void SolidRenderer::flush_caches()
+    {
+        lightmap_atlas_.reset();
+    }
+
+    ConsoleCommand2 solid_cache_bench_cmd{
+        "d_solid_cache_bench",
+        [](std::optional<int> num_iterations_opt) {
+            if (!rf::level.geometry) {
+                rf::console::print("No level loaded");
+                return;
+            }
+            // Only CPU side of the render cache is built so results do not depend on the driver
+            int num_iterations = std::max(num_iterations_opt.value_or(10), 1);
+            std::vector<GpuVertex> vb_data;
+            std::vector<ushort> ib_data;
+            std::size_t num_verts = 0;
+            std::size_t num_batches = 0;
+            int start_us = rf::timer_get_microseconds();
+            for (int i = 0; i < num_iterations; ++i) {
+                num_verts = 0;
+                num_batches = 0;
+                for (GRoom* room : rf::level.geometry->all_rooms) {
+                    GRenderCacheBuilder builder;
+                    builder.add_room(room, rf::level.geometry);
+                    num_batches += builder.get_num_batches();
+                    vb_data.clear();
+                    ib_data.clear();
+                    builder.build_geometry(vb_data, ib_data);
+                    num_verts += vb_data.size();
+                }
+            }
+            int duration_us = rf::timer_get_microseconds() - start_us;
+            rf::console::print("Level {}: {} rooms, {} verts, {} batches", rf::level.filename,
+                rf::level.geometry->all_rooms.size(), num_verts, num_batches);
+            rf::console::print("Render cache build: {:.3f} ms per level ({} iterations)",
+                duration_us / 1000.0f / num_iterations, num_iterations);
+        },
+        "Measures CPU time needed to build render caches for all rooms of the current level",
+        "d_solid_cache_bench [iterations]",
+    };
+
+    ConsoleCommand2 solid_state_sorting_cmd{
+        "d_solid_state_sorting",
+        []() {
+            state_sorted_solid_rendering = !state_sorted_solid_rendering;
+            rf::console::print("State sorted rendering of level geometry is {}",
+                state_sorted_solid_rendering ? "enabled" : "disabled");
+        },
+        "Toggles rendering of visible level geometry sorted by render state (disabled: room by room)",
+    };
+
+    ConsoleCommand2 lightmap_atlas_cmd{
+        "d_lightmap_atlas",
+        []() {
+            lightmap_atlas_enabled = !lightmap_atlas_enabled;
+            // Rebuild render caches so new lightmap UVs are used
+            rf::g_cache_clear();
+            rf::console::print("Lightmap atlas is {}", lightmap_atlas_enabled ? "enabled" : "disabled");
+        },
+        "Toggles packing of level lightmaps into atlas textures (fewer batches when rendering level geometry)",
+    };
+
+    ConsoleCommand2 occlusion_culling_cmd{
+        "d_occlusion_culling",
+        []() {
+            occlusion_culling_enabled = !occlusion_culling_enabled;
+            rf::console::print("Occlusion culling of detail rooms and movers is {}",
+                occlusion_culling_enabled ? "enabled" : "disabled");
+        },
+        "Toggles CPU frustum and occlusion culling of detail rooms and movers (see d_render_stats for results)",
+    };
+
+    void solid_register_commands()
+    {
+        solid_cache_bench_cmd.register_cmd();
+        solid_state_sorting_cmd.register_cmd();
+        lightmap_atlas_cmd.register_cmd();
+        occlusion_culling_cmd.register_cmd();
+    }
 }
@@ -3,32 +3,38 @@
 #include <vector>
 #include <optional>
 #include <memory>
+#include <unordered_map>
 #include <d3d11.h>
 #include <common/ComPtr.h>
 #include "gr_d3d11_shader.h"
+#include "gr_d3d11_lightmap_atlas.h"
+#include "gr_d3d11_culling.h"
 
 namespace rf
 {
     struct GRoom;
     struct GSolid;
     struct GDecal;
+    struct GLightmap;
 }
 
 namespace df::gr::d3d11
 {
     class StateManager;
+    class TextureManager;
     class DynamicGeometryRenderer;
     class RenderContext;
     class GRenderCacheBuilder;
     class RoomRenderCache;
     class GRenderCache;
+    struct VisibleSolidBatch;
 
     enum class FaceRenderType { opaque, alpha, liquid };
 
     class SolidRenderer
     {
     public:
-        SolidRenderer(ComPtr<ID3D11Device> device, ShaderManager& shader_manager, StateManager& state_manager, DynamicGeometryRenderer& dyn_geo_renderer, RenderContext& render_context);
+        SolidRenderer(ComPtr<ID3D11Device> device, ShaderManager& shader_manager, StateManager& state_manager, TextureManager& texture_manager, DynamicGeometryRenderer& dyn_geo_renderer, RenderContext& render_context);
         ~SolidRenderer();
         void render_solid(rf::GSolid* solid, rf::GRoom** rooms, int num_rooms);
         void render_movable_solid(rf::GSolid* solid, const rf::Vector3& pos, const rf::Matrix3& orient);
@@ -37,6 +43,8 @@ namespace df::gr::d3d11
         void render_room_liquid_surface(rf::GSolid* solid, rf::GRoom* room);
         void clear_cache();
         void page_in_solid(rf::GSolid* solid);
+        void update_lightmap(const rf::GLightmap& lightmap, int x, int y, int w, int h);
+        void flush_caches();
 
         void page_in_movable_solid(rf::GSolid* solid)
         {
@@ -47,6 +55,11 @@ namespace df::gr::d3d11
         void before_render(const rf::Vector3& pos, const rf::Matrix3& orient);
         void after_render();
         void render_room_faces(rf::GSolid* solid, rf::GRoom* room, FaceRenderType render_type);
+        void render_solid_state_sorted(rf::GSolid* solid, rf::GRoom** rooms, int num_rooms);
+        void build_occlusion_buffer(rf::GSolid* solid, rf::GRoom** rooms, int num_rooms);
+        CullResult cull_box(const rf::Vector3& bbox_min, const rf::Vector3& bbox_max);
+        bool is_detail_room_visible(rf::GRoom* detail_room);
+        bool is_movable_solid_visible(rf::GSolid* solid, const rf::Vector3& pos, const rf::Matrix3& orient);
         void render_detail(rf::GSolid* solid, rf::GRoom* room, bool alpha);
         void render_dynamic_decals(rf::GRoom** rooms, int num_rooms);
         void render_alpha_detail_dynamic_decals(rf::GRoom* detail_room);
@@ -56,6 +69,7 @@ namespace df::gr::d3d11
         RoomRenderCache* get_or_create_normal_room_cache(rf::GSolid* solid, rf::GRoom* room);
         GRenderCache* get_or_create_detail_room_cache(rf::GSolid* solid, rf::GRoom* room);
         GRenderCache* get_or_create_movable_solid_cache(rf::GSolid* solid);
+        const LightmapAtlas* get_lightmap_atlas() const;
 
         ComPtr<ID3D11Device> device_;
         ComPtr<ID3D11DeviceContext> context_;
@@ -63,8 +77,13 @@ namespace df::gr::d3d11
         ComPtr<ID3D11PixelShader> pixel_shader_;
         DynamicGeometryRenderer& dyn_geo_renderer_;
         RenderContext& render_context_;
+        LightmapAtlas lightmap_atlas_;
+        OcclusionCuller culler_;
         std::vector<std::unique_ptr<RoomRenderCache>> room_cache_;
         std::vector<std::unique_ptr<GRenderCache>> detail_render_cache_;
         std::unordered_map<rf::GSolid*, std::unique_ptr<GRenderCache>> mover_render_cache_;
+        std::vector<VisibleSolidBatch> visible_batches_;
     };
+
+    void solid_register_commands();
 }
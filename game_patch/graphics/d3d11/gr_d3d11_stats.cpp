@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <array>
+#include <format>
+#include "../../rf/gr/gr.h"
+#include "../../rf/gr/gr_font.h"
+#include "../../os/console.h"
+#include "gr_d3d11_stats.h"
+
+namespace df::gr::d3d11
+{
+    RenderStats render_stats;
+
+    static bool show_render_stats = false;
+    // Room cache update times of recent frames so spikes are visible for a while
+    static std::array<int, 128> room_cache_update_time_history{};
+    static int room_cache_update_time_history_index = 0;
+
+    void render_stats_render_ui()
+    {
+        if (!show_render_stats) {
+            return;
+        }
+        int max_update_time_us = std::max(render_stats.room_cache_update_time_us,
+            *std::max_element(room_cache_update_time_history.begin(), room_cache_update_time_history.end()));
+        auto text = std::format(
+            "Draw calls: {}\n"
+            "Texture changes: {}\n"
+            "Mode changes: {}\n"
+            "Vertex buffer changes: {}\n"
+            "Solid batches: {} (state buckets: {})\n"
+            "Room cache updates: {} (compactions: {})\n"
+            "Room cache update time: {} us (max {} us)\n"
+            "Detail rooms: {} drawn, {} outside frustum, {} occluded\n"
+            "Movers: {} drawn, {} outside frustum, {} occluded\n"
+            "Occluders: {} polygons, culling time: {} us",
+            render_stats.num_draw_calls, render_stats.num_texture_changes, render_stats.num_mode_changes,
+            render_stats.num_buffer_changes, render_stats.num_solid_batches, render_stats.num_solid_state_buckets,
+            render_stats.num_room_cache_updates, render_stats.num_room_cache_compactions,
+            render_stats.room_cache_update_time_us, max_update_time_us,
+            render_stats.detail_rooms.num_drawn, render_stats.detail_rooms.num_outside_frustum,
+            render_stats.detail_rooms.num_occluded, render_stats.movers.num_drawn,
+            render_stats.movers.num_outside_frustum, render_stats.movers.num_occluded,
+            render_stats.num_occluder_polygons, render_stats.culling_time_us);
+        int x = 10;
+        int y = rf::gr::screen_height() / 4;
+        rf::gr::set_color(0, 0, 0, 255);
+        rf::gr::string(x + 1, y + 1, text.c_str());
+        rf::gr::set_color(255, 255, 255, 255);
+        rf::gr::string(x, y, text.c_str());
+    }
+
+    void render_stats_next_frame()
+    {
+        room_cache_update_time_history[room_cache_update_time_history_index] = render_stats.room_cache_update_time_us;
+        room_cache_update_time_history_index = (room_cache_update_time_history_index + 1) % room_cache_update_time_history.size();
+        render_stats = {};
+    }
+
+    ConsoleCommand2 render_stats_cmd{
+        "d_render_stats",
+        []() {
+            show_render_stats = !show_render_stats;
+            rf::console::print("Render stats display is {}", show_render_stats ? "enabled" : "disabled");
+        },
+        "Toggles display of renderer statistics",
+    };
+
+    void render_stats_register_commands()
+    {
+        render_stats_cmd.register_cmd();
+    }
+}
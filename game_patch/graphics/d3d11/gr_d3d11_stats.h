@@ -0,0 +1,39 @@
+#pragma once
+
+namespace df::gr::d3d11
+{
+    // Counters collected while rendering a single frame
+    struct RenderStats
+    {
+        struct CullCounters
+        {
+            int num_drawn = 0;
+            int num_outside_frustum = 0;
+            int num_occluded = 0;
+        };
+
+        // Room render caches updated after geomod or compacted
+        int num_room_cache_updates = 0;
+        int num_room_cache_compactions = 0;
+        int room_cache_update_time_us = 0;
+        // Draw calls and state changes done by RenderContext
+        int num_draw_calls = 0;
+        int num_texture_changes = 0;
+        int num_mode_changes = 0;
+        int num_buffer_changes = 0;
+        // Batches of level geometry merged by state sorted rendering
+        int num_solid_batches = 0;
+        int num_solid_state_buckets = 0;
+        // Results of detail room (opaque and alpha pass) and mover culling
+        CullCounters detail_rooms;
+        CullCounters movers;
+        int num_occluder_polygons = 0;
+        int culling_time_us = 0;
+    };
+
+    extern RenderStats render_stats;
+
+    void render_stats_render_ui();
+    void render_stats_next_frame();
+    void render_stats_register_commands();
+}
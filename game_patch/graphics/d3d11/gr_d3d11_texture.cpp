@@ -155,6 +155,11 @@ namespace df::gr::d3d11
         if (bm::get_type(bm_handle) == bm::TYPE_USER) {
             xlog::trace("Creating user bitmap texture: handle {}", bm_handle);
             auto texture = create_texture(bm_handle, fmt, w, h, nullptr, nullptr, 1, staging);
+            auto source_it = user_texture_sources_.find(bm::get_cache_slot(bm_handle));
+            if (source_it != user_texture_sources_.end() && texture.gpu_texture) {
+                const UserTextureSource& source = source_it->second;
+                upload_texture_region(texture, 0, 0, w, h, source.format, source.bits, source.pitch);
+            }
             return texture;
         }
 
@@ -387,6 +392,53 @@ namespace df::gr::d3d11
         }
     }
 
+    bool TextureManager::update_texture_region(int bm_handle, int x, int y, int w, int h, bm::Format fmt, const ubyte* bits, int pitch)
+    {
+        if (bm_handle < 0 || w <= 0 || h <= 0) {
+            return false;
+        }
+        Texture& texture = get_or_load_texture(bm_handle, false);
+        texture.get_or_create_texture_view(device_, device_context_);
+        if (!texture.gpu_texture) {
+            xlog::warn("Attempted to update texture without GPU resource {}", bm_handle);
+            return false;
+        }
+        upload_texture_region(texture, x, y, w, h, fmt, bits, pitch);
+        return true;
+    }
+
+    void TextureManager::upload_texture_region(Texture& texture, int x, int y, int w, int h, bm::Format fmt, const ubyte* bits, int pitch)
+    {
+        bm::Format dst_fmt = get_bm_format(texture.format);
+        int converted_pitch = bm_calculate_pitch(w, dst_fmt);
+        auto converted_bits = std::make_unique<ubyte[]>(converted_pitch * h);
+        if (!bm_convert_format(converted_bits.get(), dst_fmt, bits, fmt, w, h, converted_pitch, pitch)) {
+            xlog::error("bm_convert_format failed for texture update (fmt {} -> {})", fmt, dst_fmt);
+            return;
+        }
+
+        D3D11_BOX box{
+            static_cast<UINT>(x),
+            static_cast<UINT>(y),
+            0,
+            static_cast<UINT>(x + w),
+            static_cast<UINT>(y + h),
+            1,
+        };
+        device_context_->UpdateSubresource(texture.gpu_texture, 0, &box, converted_bits.get(), converted_pitch, 0);
+    }
+
+    void TextureManager::set_user_texture_source(int bm_handle, bm::Format fmt, const ubyte* bits, int pitch)
+    {
+        assert(bm::get_type(bm_handle) == bm::TYPE_USER);
+        user_texture_sources_[bm::get_cache_slot(bm_handle)] = {fmt, bits, pitch};
+    }
+
+    void TextureManager::remove_user_texture_source(int bm_handle)
+    {
+        user_texture_sources_.erase(bm::get_cache_slot(bm_handle));
+    }
+
     void TextureManager::get_texel(
         [[maybe_unused]] int bm_handle,
         [[maybe_unused]] float u,
@@ -37,6 +37,12 @@ namespace df::gr::d3d11
         void mark_dirty(int bm_handle);
         bool lock(int bm_handle, int section, rf::gr::LockInfo *lock);
         void unlock(rf::gr::LockInfo *lock);
+        // Uploads a rectangle of pixels directly to the GPU texture (CPU copy used by lock is not updated)
+        bool update_texture_region(int bm_handle, int x, int y, int w, int h, rf::bm::Format fmt, const rf::ubyte* bits, int pitch);
+        // Sets pixels used to initialize the texture of a user bitmap every time it is created (e.g. after a cache
+        // flush). Bits must stay valid until the source is removed.
+        void set_user_texture_source(int bm_handle, rf::bm::Format fmt, const rf::ubyte* bits, int pitch);
+        void remove_user_texture_source(int bm_handle);
         void get_texel(int bm_handle, float u, float v, rf::gr::Color *clr);
         rf::bm::Format read_back_buffer(ID3D11Texture2D* back_buffer, int x, int y, int w, int h, rf::ubyte* data);
         ComPtr<ID3D11ShaderResourceView> create_solid_color_texture(float r, float g, float b, float a);
@@ -103,6 +109,13 @@ namespace df::gr::d3d11
             void init_cpu_texture(ID3D11Device* device, ID3D11DeviceContext* device_context, bool copy_from_gpu);
         };
 
+        struct UserTextureSource
+        {
+            rf::bm::Format format;
+            const rf::ubyte* bits;
+            int pitch;
+        };
+
         Texture& get_or_load_texture(int bm_handle, bool staging)
         {
             // Note: bm_index will change for each animation frame but bm_handle will stay the same
@@ -119,6 +132,7 @@ namespace df::gr::d3d11
         Texture create_texture(int bm_handle, rf::bm::Format fmt, int w, int h, rf::ubyte* bits, rf::ubyte* pal, int mip_levels, bool staging);
         Texture create_render_target(int bm_handle, int w, int h);
         Texture load_texture(int bm_handle, bool staging);
+        void upload_texture_region(Texture& texture, int x, int y, int w, int h, rf::bm::Format fmt, const rf::ubyte* bits, int pitch);
         std::pair<DXGI_FORMAT, rf::bm::Format> determine_supported_texture_format(rf::bm::Format fmt);
         std::pair<DXGI_FORMAT, rf::bm::Format> get_supported_texture_format(rf::bm::Format fmt);
         static rf::bm::Format get_bm_format(DXGI_FORMAT dxgi_fmt);
@@ -126,6 +140,7 @@ namespace df::gr::d3d11
         ComPtr<ID3D11Device> device_;
         ComPtr<ID3D11DeviceContext> device_context_;
         std::unordered_map<int, Texture> texture_cache_;
+        std::unordered_map<int, UserTextureSource> user_texture_sources_;
         ComPtr<ID3D11Texture2D> back_buffer_staging_texture_;
         std::unordered_map<rf::bm::Format, std::pair<DXGI_FORMAT, rf::bm::Format>> supported_texture_format_cache_;
         ComPtr<ID3D11ShaderResourceView> white_texture_view_;
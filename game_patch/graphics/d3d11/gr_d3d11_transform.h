@@ -17,6 +17,7 @@ namespace df::gr::d3d11
         float sy_ = 1.0f;
         float sz_ = -0.1f;
         float tz_ = 1.0f;
+        float zn_ = 0.1f;
         float zf_ = 1.0f;
 
     public:
@@ -25,7 +26,7 @@ namespace df::gr::d3d11
             sx_{sx}, sy_{sy},
             sz_{-zn / (zf - zn)},
             tz_{zf * zn / (zf - zn)},
-            zf_{zf}
+            zn_{zn}, zf_{zf}
         {}
 
         float project_z(float z) const
@@ -65,6 +66,21 @@ namespace df::gr::d3d11
             }};
         }
 
+        float scale_x() const
+        {
+            return sx_;
+        }
+
+        float scale_y() const
+        {
+            return sy_;
+        }
+
+        float z_near() const
+        {
+            return zn_;
+        }
+
         float z_far() const
         {
             return zf_;
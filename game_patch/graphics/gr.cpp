@@ -26,6 +26,7 @@ namespace df::gr::d3d11
 {
     bool set_render_target(int bm_handle);
     void update_window_mode();
+    void update_lightmap(const rf::GLightmap& lightmap, int x, int y, int w, int h);
     void bitmap_float(int bitmap_handle, float x, float y, float w, float h, float sx, float sy, float sw, float sh, bool flip_x, bool flip_y, rf::gr::Mode mode);
 }
 
@@ -190,6 +191,15 @@ void gr_bitmap_scaled_float(int bitmap_handle, float x, float y, float w, float
     }
 }
 
+void gr_update_lightmap(const rf::GLightmap& lightmap, int x, int y, int w, int h)
+{
+    if (rf::gr::screen.mode == rf::gr::DIRECT3D) {
+        if (g_game_config.renderer == GameConfig::Renderer::d3d11) {
+            df::gr::d3d11::update_lightmap(lightmap, x, y, w, h);
+        }
+    }
+}
+
 void gr_set_window_mode(rf::gr::WindowMode window_mode)
 {
     if (rf::gr::screen.mode == rf::gr::DIRECT3D) {
@@ -3,11 +3,18 @@
 #include "../rf/bmpman.h"
 #include "../rf/gr/gr.h"
 
+namespace rf
+{
+    struct GLightmap;
+}
+
 void gr_apply_patch();
 int gr_font_get_default();
 void gr_font_set_default(int font_id);
 bool gr_set_render_target(int bm_handle);
 bool gr_is_texture_format_supported(rf::bm::Format format);
+// Called after lightmap pixels were modified (e.g. by geomod)
+void gr_update_lightmap(const rf::GLightmap& lightmap, int x, int y, int w, int h);
 void gr_bitmap_scaled_float(int bitmap_handle, float x, float y, float w, float h, float sx, float sy, float sw, float sh, bool flip_x, bool flip_y, rf::gr::Mode mode);
 float gr_scale_fov_hor_plus(float horizontal_fov);
 
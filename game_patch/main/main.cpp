@@ -104,9 +104,11 @@ FunHook<int()> rf_do_frame_hook{
         high_fps_update();
         server_do_frame();
         int result = rf_do_frame_hook.call_target();
+        server_do_frame_post();
         maybe_autosave();
         debug_do_frame_post();
         multi_level_download_update();
+        vpackfile_do_frame();
         return result;
     },
 };
@@ -142,7 +144,12 @@ FunHook<int(rf::String&, rf::String&, char*)> level_load_hook{
         xlog::info("Loading level: {}", level_filename);
         if (!save_filename.empty())
             xlog::info("Restoring game from save file: {}", save_filename);
+        // Apply changes in user_maps before the new level is loaded so it never uses a removed packfile
+        // Note: the old level is still loaded so removed packfiles are released by the next reload
+        vpackfile_reload_user_maps();
+        vpackfile_level_load_begin(level_filename.c_str());
         int ret = level_load_hook.call_target(level_filename, save_filename, error);
+        vpackfile_level_load_end(ret == 0);
         if (ret != 0)
             xlog::warn("Loading failed: {}", error);
         else {
@@ -156,6 +163,7 @@ FunHook<void(bool)> level_init_post_hook{
     0x00435DF0,
     [](bool transition) {
         level_init_post_hook.call_target(transition);
+        multi_invalidate_game_info_cache();
         xlog::info("Level loaded: {}{}", rf::level.filename, transition ? " (transition)" : "");
     },
 };
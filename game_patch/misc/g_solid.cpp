@@ -11,6 +11,7 @@
 #include "../os/console.h"
 #include "../bmpman/bmpman.h"
 #include "../bmpman/fmt_conv_templates.h"
+#include "../graphics/gr.h"
 
 constexpr auto reference_fps = 30.0f;
 constexpr auto reference_frametime = 1.0f / reference_fps;
@@ -43,6 +44,7 @@ CodeInjection GSurface_calculate_lightmap_color_conv_patch{
 
         rf::GSurface* surface = regs.esi;
         rf::GLightmap& lightmap = *surface->lightmap;
+        gr_update_lightmap(lightmap, surface->xstart, surface->ystart, surface->width, surface->height);
         rf::gr::LockInfo lock;
         if (!rf::gr::lock(lightmap.bm_handle, 0, &lock, rf::gr::LOCK_WRITE_ONLY)) {
             return;
@@ -72,6 +74,7 @@ CodeInjection GSurface_alloc_lightmap_color_conv_patch{
 
         rf::GSurface* surface = regs.esi;
         rf::GLightmap& lightmap = *surface->lightmap;
+        gr_update_lightmap(lightmap, surface->xstart, surface->ystart, surface->width, surface->height);
         rf::gr::LockInfo lock;
         if (!rf::gr::lock(lightmap.bm_handle, 0, &lock, rf::gr::LOCK_WRITE_ONLY)) {
             return;
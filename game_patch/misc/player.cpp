@@ -44,6 +44,7 @@ FunHook<rf::Player*(bool)> player_create_hook{
     [](bool is_local) {
         rf::Player* player = player_create_hook.call_target(is_local);
         multi_init_player(player);
+        multi_invalidate_game_info_cache();
         return player;
     },
 };
@@ -54,6 +55,7 @@ FunHook<void(rf::Player*)> player_destroy_hook{
         multi_spectate_on_destroy_player(player);
         reset_player_additional_data(player);
         player_destroy_hook.call_target(player);
+        multi_invalidate_game_info_cache();
     },
 };
 
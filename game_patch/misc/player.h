@@ -1,12 +1,16 @@
 #include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 #include <common/utils/string-utils.h>
 #include "../rf/math/vector.h"
 #include "../rf/math/matrix.h"
 #include "../rf/os/timestamp.h"
 #include "../purefaction/pf_packets.h"
+#include "../multi/obj_update_codec.h"
+#include "../multi/reliable_channel.h"
 
 // Forward declarations
 namespace rf
@@ -29,6 +33,11 @@ struct PlayerAdditionalData
     std::map<std::string, PlayerNetGameSaveData> saves;
     rf::Vector3 last_teleport_pos;
     rf::TimestampRealtime last_teleport_timestamp;
+    std::unique_ptr<ObjUpdateDeltaEncoder> obj_update_encoder;
+    std::unique_ptr<ReliableChannelSender> reliable_sender;
+    bool batched_packets = false;
+    std::vector<std::byte> unreliable_batch;
+    int unreliable_batch_num_sends = 0;
 };
 
 void find_player(const StringMatcher& query, std::function<void(rf::Player*)> consumer);
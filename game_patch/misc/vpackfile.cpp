@@ -12,20 +12,35 @@
 #include <array>
 #include <cctype>
 #include <cstring>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <shlwapi.h>
 #include "vpackfile.h"
+#include "vpackfile_format.h"
+#include "vpackfile_index.h"
+#include "vpackfile_lookup_table.h"
+#include "vpackfile_ext_index.h"
+#include "vpackfile_verifier.h"
+#include "vpackfile_compressed.h"
+#include "vpackfile_prefetcher.h"
+#include "vpackfile_dedup.h"
 #include "../main/main.h"
 #include "../rf/file/file.h"
 #include "../rf/file/packfile.h"
 #include "../rf/crt.h"
 #include "../rf/multi.h"
+#include "../rf/os/os.h"
+#include "../rf/os/timer.h"
 #include "../os/console.h"
+#include "../os/mapped_file.h"
 
-#define CHECK_PACKFILE_CHECKSUM 0 // slow (1 second on SSD on first load after boot)
-
-#if CHECK_PACKFILE_CHECKSUM
-
+// Note: checksums are verified on a background thread because hashing is slow (1 second on SSD on first load
+// after boot)
 const std::map<std::string, unsigned> GameFileChecksums = {
     // Note: Multiplayer level checksum is checked when loading level
     //{ "levelsm.vpp", 0x17D0D38A },
@@ -34,14 +49,45 @@ const std::map<std::string, unsigned> GameFileChecksums = {
     {"meshes.vpp", 0xEBA19172}, {"motions.vpp", 0x17132D8E}, {"tables.vpp", 0x549DAABF},
 };
 
-#endif // CHECK_PACKFILE_CHECKSUM
-
 static unsigned g_num_files_in_packfiles = 0;
 static unsigned g_num_name_collisions = 0;
 static std::vector<std::unique_ptr<rf::VPackfile>> g_packfiles;
-static std::unordered_map<std::string, rf::VPackfileEntry*> g_loopup_table;
+static VPackfileLookupTable g_loopup_table;
+static std::unordered_map<const rf::VPackfile*, VPackfileExtIndex> g_packfile_ext_indices;
 static bool g_is_modded_game = false;
 static bool g_is_overriding_disabled = false;
+static bool g_use_mapped_packfiles = false;
+static std::unordered_map<const rf::VPackfile*, VPackfileStamp> g_packfile_stamps;
+static std::unordered_map<const rf::VPackfile*, std::unique_ptr<VPackfileCompressedData>> g_packfile_compressed_data;
+static bool g_use_packfile_dedup = false;
+static VPackfileDedup g_packfile_dedup;
+static std::unordered_map<const rf::VPackfile*, std::vector<uint64_t>> g_packfile_content_hashes;
+static std::vector<std::pair<std::string, std::string>> g_forced_files;
+static HANDLE g_user_maps_change_notification = INVALID_HANDLE_VALUE;
+// Packfiles removed from user_maps. Files opened by the level that was loaded when they were removed can still point
+// to their entries (or decompressed data) so they are released by the next reload when that level is gone.
+struct RetiredPackfile
+{
+    std::unique_ptr<rf::VPackfile> packfile;
+    std::unique_ptr<VPackfileCompressedData> compressed_data;
+};
+static std::vector<RetiredPackfile> g_retired_packfiles;
+static bool g_user_maps_rescan_pending = false;
+static VPackfilePrefetcher g_prefetcher;
+// Prefetch profile of the level that is being loaded (empty if no level is being loaded)
+static std::string g_prefetch_profile_path;
+static std::vector<std::string> g_prefetch_profile;
+static std::unordered_map<const rf::VPackfileEntry*, std::size_t> g_prefetch_range_indices;
+static std::vector<std::string> g_prefetch_recorded_names;
+static std::unordered_set<const rf::VPackfileEntry*> g_prefetch_recorded_entries;
+static unsigned g_num_prefetch_hits = 0;
+static unsigned g_num_prefetch_misses = 0;
+static VPackfileIndex g_packfile_index;
+static VPackfileVerifier g_packfile_verifier;
+static bool g_verification_results_applied = false;
+struct VPackfileScan;
+static std::vector<VPackfileScan>* g_pending_scans = nullptr;
+static bool g_is_user_maps_batch = false;
 
 #ifdef MOD_FILE_WHITELIST
 
@@ -61,30 +107,33 @@ static bool is_mod_file_in_whitelist(const char* Filename)
 
 #endif // MOD_FILE_WHITELIST
 
-#if CHECK_PACKFILE_CHECKSUM
-
-static unsigned hash_file(const char* Filename)
+static std::string vpackfile_get_index_path()
 {
-    FILE* File = fopen(Filename, "rb");
-    if (!File)
-        return 0;
+    return std::format("{}dashfaction_vfs.idx", rf::root_path);
+}
 
-    XXH32_state_t* state = XXH32_createState();
-    XXH32_reset(state, 0);
+static void vpackfile_check_checksum(const char* filename, uint32_t checksum, uint32_t expected_checksum)
+{
+    if (checksum != expected_checksum) {
+        xlog::info("VPackfile {} has invalid checksum 0x{:x}", filename, checksum);
+        g_is_modded_game = true;
+    }
+}
 
-    char Buffer[4096];
-    while (true) {
-        size_t len = fread(Buffer, 1, sizeof(Buffer), File);
-        if (!len)
-            break;
-        XXH32_update(state, Buffer, len);
+static void vpackfile_queue_verification(const char* filename, const char* path, const VPackfileStamp& stamp)
+{
+    auto it = GameFileChecksums.find(string_to_lower(filename));
+    if (it == GameFileChecksums.end()) {
+        return;
+    }
+    auto cached_checksum = g_packfile_index.get_checksum(path, stamp);
+    if (cached_checksum) {
+        vpackfile_check_checksum(filename, cached_checksum.value(), it->second);
+    }
+    else if (!g_packfile_verifier.is_started()) {
+        g_packfile_verifier.add_job(path, filename, stamp, it->second);
     }
-    fclose(File);
-    XXH32_hash_t hash = XXH32_digest(state);
-    XXH32_freeState(state);
-    return hash;
 }
-#endif // CHECK_PACKFILE_CHECKSUM
 
 static GameLang detect_installed_game_lang()
 {
@@ -124,108 +173,27 @@ bool is_modded_game()
     return g_is_modded_game;
 }
 
-static uint32_t vpackfile_process_header(rf::VPackfile* packfile, const void* raw_header)
+// Note: this must be called from DLL init function
+static rf::CmdLineParam& get_vpp_mmap_cmd_line_param()
 {
-    struct VppHeader
-    {
-        uint32_t sig;
-        uint32_t unk;
-        uint32_t num_files;
-        uint32_t total_size;
-    };
-    constexpr unsigned VPP_SIG = 0x51890ACE;
-    const auto& hdr = *static_cast<const VppHeader*>(raw_header);
-    packfile->num_files = hdr.num_files;
-    packfile->file_size = hdr.total_size;
-    if (hdr.sig != VPP_SIG || hdr.unk < 1u)
-        return 0;
-    return hdr.num_files;
+    static rf::CmdLineParam vpp_mmap_param{"-vpp-mmap", "", false};
+    return vpp_mmap_param;
 }
 
-static int vpackfile_add_new(const char* filename, const char* dir)
+static rf::CmdLineParam& get_vpp_dedup_cmd_line_param()
 {
-    xlog::trace("Load packfile {} {}", dir, filename);
-
-    std::string full_path;
-    if (dir && !PathIsRelativeA(dir))
-        full_path = std::format("{}{}", dir, filename); // absolute path
-    else
-        full_path = std::format("{}{}{}", rf::root_path, dir ? dir : "", filename);
-
-    if (!filename || strlen(filename) > 0x1F || full_path.size() > 0x7F) {
-        xlog::error("Packfile name or path too long: {}", full_path);
-        return 0;
-    }
-
-    for (auto& packfile : g_packfiles)
-        if (!stricmp(packfile->path, full_path.c_str()))
-            return 1;
-
-#if CHECK_PACKFILE_CHECKSUM
-    if (!Dir) {
-        auto it = GameFileChecksums.find(Filename);
-        if (it != GameFileChecksums.end()) {
-            unsigned Checksum = hash_file(FullPath);
-            if (Checksum != it->second) {
-                xlog::info("VPackfile {} has invalid checksum 0x{:x}", Filename, Checksum);
-                g_is_modded_game = true;
-            }
-        }
-    }
-#endif // CHECK_PACKFILE_CHECKSUM
-
-    std::ifstream file(full_path, std::ios_base::in | std::ios_base::binary);
-    if (!file) {
-        xlog::error("Failed to open packfile {}", full_path);
-        return 0;
-    }
-
-    auto packfile = std::make_unique<rf::VPackfile>();
-    std::strncpy(packfile->filename, filename, sizeof(packfile->filename) - 1);
-    packfile->filename[sizeof(packfile->filename) - 1] = '\0';
-    std::strncpy(packfile->path, full_path.c_str(), sizeof(packfile->path) - 1);
-    packfile->path[sizeof(packfile->path) - 1] = '\0';
-    packfile->field_a0 = 0;
-    packfile->num_files = 0;
-    // this is set to true for user_maps
-    packfile->is_user_maps = rf::vpackfile_loading_user_maps;
+    static rf::CmdLineParam vpp_dedup_param{"-vpp-dedup", "", false};
+    return vpp_dedup_param;
+}
 
-    // Process file header
-    char buf[0x800];
-    if (!file.read(buf, sizeof(buf))) {
-        xlog::error("Failed to read VPP header: {}", filename);
-        return 0;
-    }
-    // Note: VPackfileProcessHeader returns number of files in packfile - result 0 is not always a true error
-    if (!vpackfile_process_header(packfile.get(), buf)) {
+static uint32_t vpackfile_process_header(rf::VPackfile* packfile, const void* raw_header)
+{
+    const auto& hdr = *static_cast<const vpp::Header*>(raw_header);
+    packfile->num_files = hdr.num_files;
+    packfile->file_size = hdr.total_size;
+    if (hdr.sig != vpp::sig || hdr.version < 1u)
         return 0;
-    }
-
-    // Load all entries
-    unsigned current_block = 1;
-    packfile->files.resize(packfile->num_files);
-    unsigned num_added = 0;
-    for (unsigned i = 0; i < packfile->num_files; i += 32) {
-        if (!file.read(buf, sizeof(buf))) {
-            xlog::error("Failed to read vpp {}", full_path);
-            return 0;
-        }
-
-        unsigned num_files_in_block = std::min(packfile->num_files - i, 32u);
-        rf::vpackfile_add_entries(packfile.get(), buf, num_files_in_block, &num_added);
-        ++current_block;
-    }
-    packfile->files.resize(num_added);
-
-    // Set block in all entries
-    for (auto& entry : packfile->files) {
-        entry.block = current_block;
-        current_block += (entry.size + 2047) / 2048;
-    }
-
-    g_packfiles.push_back(std::move(packfile));
-
-    return 1;
+    return hdr.num_files;
 }
 
 static rf::VPackfile* vpackfile_find_packfile(const char* filename)
@@ -242,20 +210,13 @@ static rf::VPackfile* vpackfile_find_packfile(const char* filename)
 template<typename F>
 static void for_each_packfile_entry(const std::vector<std::string_view>& ext_filter, const char* packfile_filter, F fun)
 {
-    std::vector<std::string> ext_filter_lower;
-    ext_filter_lower.reserve(ext_filter.size());
-    std::transform(ext_filter.begin(), ext_filter.end(), std::back_inserter(ext_filter_lower), string_to_lower);
     for (auto& packfile : g_packfiles) {
         if (!packfile_filter || !stricmp(packfile_filter, packfile->filename)) {
-            for (auto& entry : packfile->files) {
-                const char* ext_ptr = rf::file_get_ext(entry.name);
-                if (ext_ptr[0]) {
-                    ++ext_ptr;
-                }
-                std::string ext_lower = string_to_lower(ext_ptr);
-                if (iterable_contains(ext_filter_lower, ext_lower)) {
-                    fun(entry);
-                }
+            auto it = g_packfile_ext_indices.find(packfile.get());
+            if (it != g_packfile_ext_indices.end()) {
+                it->second.for_each_matching(ext_filter, [&](uint32_t index) {
+                    fun(packfile->files[index]);
+                });
             }
         }
     }
@@ -289,17 +250,24 @@ static int vpackfile_build_file_list_new(const char* ext_filter, char*& filename
     return 1;
 }
 
+// Returns packfile the entry belongs to (entry parent can point to another packfile with identical data)
+static const rf::VPackfile* vpackfile_get_owner(const rf::VPackfileEntry* entry)
+{
+    const rf::VPackfile* owner = g_packfile_dedup.get_owner(*entry);
+    return owner ? owner : entry->parent;
+}
+
 static bool is_lookup_table_entry_override_allowed(rf::VPackfileEntry* old_entry, rf::VPackfileEntry* new_entry)
 {
-    if (g_is_overriding_disabled) {
+    if (vpackfile_get_owner(new_entry)->is_added_after_init) {
         // Don't allow overriding files after game is initialized because it can lead to crashes
         return false;
     }
-    if (!new_entry->parent->is_user_maps) {
+    if (!vpackfile_get_owner(new_entry)->is_user_maps) {
         // Allow overriding by packfiles from game root and from mods
         return true;
     }
-    if (!old_entry->parent->is_user_maps && !stricmp(rf::file_get_ext(new_entry->name), ".tbl")) {
+    if (!vpackfile_get_owner(old_entry)->is_user_maps && !stricmp(rf::file_get_ext(new_entry->name), ".tbl")) {
         // Always skip overriding tbl files from game by user_maps
         return false;
     }
@@ -316,42 +284,48 @@ static bool is_lookup_table_entry_override_allowed(rf::VPackfileEntry* old_entry
     return true;
 }
 
-static void vpackfile_add_to_lookup_table(rf::VPackfileEntry* entry)
+static void vpackfile_add_to_lookup_table(rf::VPackfileEntry* entry, uint32_t name_hash)
 {
-    std::string filename_str = string_to_lower(entry->name);
-    auto [it, inserted] = g_loopup_table.insert({filename_str, entry});
+    auto [slot, inserted] = g_loopup_table.insert(entry, name_hash);
     if (!inserted) {
         ++g_num_name_collisions;
-        if (is_lookup_table_entry_override_allowed(it->second, entry)) {
+        if (is_lookup_table_entry_override_allowed(slot->entry, entry)) {
             xlog::trace("Allowed overriding packfile file {} (old packfile {}, new packfile {})", entry->name,
-                it->second->parent->filename, entry->parent->filename);
-            it->second = entry;
+                slot->entry->parent->filename, entry->parent->filename);
+            slot->entry = entry;
         }
         else {
             xlog::trace("Denied overriding packfile file {} (old packfile {}, new packfile {})", entry->name,
-                it->second->parent->filename, entry->parent->filename);
+                slot->entry->parent->filename, entry->parent->filename);
         }
     }
 }
 
-static int vpackfile_add_entries_new(rf::VPackfile* packfile, const void* block, unsigned num_files,
-                                     unsigned& num_added_files)
+static void vpackfile_add_entries_internal(rf::VPackfile* packfile, const vpp::FileInfo* record, unsigned num_files,
+                                           unsigned& num_added_files, bool persistent_names,
+                                           const uint32_t* name_hashes = nullptr)
 {
-    struct VppFileInfo
-    {
-        char name[60];
-        uint32_t size;
-    };
-    const auto* record = static_cast<const VppFileInfo*>(block);
+    // Size the name pool exactly - there can be thousands of packfiles and most of them have only a few files
+    std::size_t name_pool_size = 0;
+    for (unsigned i = 0; i < num_files; ++i) {
+        if (!persistent_names || !vpp::is_name_terminated(record[i])) {
+            name_pool_size += strnlen(record[i].name, sizeof(record[i].name)) + 1;
+        }
+    }
+    packfile->name_pool.reserve(name_pool_size);
 
     for (unsigned i = 0; i < num_files; ++i) {
         const char* file_name = record->name;
         rf::VPackfileEntry& entry = packfile->files[num_added_files];
 
-        // Note: we can't use string pool from RF because it's too small
-        char* file_name_buf = new char[strlen(file_name) + 1];
-        std::strcpy(file_name_buf, file_name);
-        entry.name = file_name_buf;
+        if (persistent_names && vpp::is_name_terminated(*record)) {
+            // Name is stored in a buffer which lives as long as the packfile (mapping or index)
+            entry.name = file_name;
+        }
+        else {
+            // Note: we can't use string pool from RF because it's too small
+            entry.name = packfile->name_pool.add({file_name, strnlen(file_name, sizeof(record->name))});
+        }
         entry.name_checksum = rf::vpackfile_calc_file_name_checksum(entry.name);
         entry.size = record->size;
         entry.parent = packfile;
@@ -360,24 +334,463 @@ static int vpackfile_add_entries_new(rf::VPackfile* packfile, const void* block,
         ++record;
         ++num_added_files;
 
-        vpackfile_add_to_lookup_table(&entry);
+        uint32_t name_hash = name_hashes ? name_hashes[i] : vpackfile_hash_name(entry.name);
+        vpackfile_add_to_lookup_table(&entry, name_hash);
         ++g_num_files_in_packfiles;
     }
+}
+
+static int vpackfile_add_entries_new(rf::VPackfile* packfile, const void* block, unsigned num_files,
+                                     unsigned& num_added_files)
+{
+    const auto* records = static_cast<const vpp::FileInfo*>(block);
+    vpackfile_add_entries_internal(packfile, records, num_files, num_added_files, false);
+    return 1;
+}
+
+static void vpackfile_setup_entry_blocks(rf::VPackfile* packfile, unsigned first_data_block)
+{
+    unsigned current_block = first_data_block;
+    for (auto& entry : packfile->files) {
+        entry.block = current_block;
+        current_block += vpp::num_blocks(entry.size);
+    }
+}
+
+// Packfile loading is split into a scan stage that only touches the scanned packfile and can run on a worker
+// thread and a register stage that updates global state (lookup table, index) and must run in load order
+struct VPackfileScan
+{
+    std::unique_ptr<rf::VPackfile> packfile;
+    bool already_loaded = false;
+    std::optional<VPackfileStamp> stamp;
+    const VPackfileIndex::Directory* indexed_dir = nullptr;
+    MappedFile mapping;
+    std::vector<vpp::FileInfo> owned_files;
+    std::span<const vpp::FileInfo> files;
+    std::vector<uint32_t> name_hashes;
+    std::unique_ptr<VPackfileCompressedData> compressed_data;
+    std::vector<uint64_t> content_hashes;
+    bool content_hashes_computed = false;
+    bool persistent_names = false;
+    bool scanned = false;
+};
+
+static bool vpackfile_load_seek_table(VPackfileScan& scan, const vpp::CompressionHeader& hdr,
+    std::span<const std::byte> seek_table)
+{
+    auto compressed_data = std::make_unique<VPackfileCompressedData>();
+    uint64_t packfile_size = scan.stamp ? scan.stamp.value().file_size : scan.packfile->file_size;
+    if (!compressed_data->load(hdr, scan.files, packfile_size, seek_table)) {
+        xlog::error("Invalid seek table in compressed packfile {}", scan.packfile->path);
+        return false;
+    }
+    scan.compressed_data = std::move(compressed_data);
+    return true;
+}
+
+static bool vpackfile_scan_stream(VPackfileScan& scan)
+{
+    rf::VPackfile* packfile = scan.packfile.get();
+    std::ifstream file(packfile->path, std::ios_base::in | std::ios_base::binary);
+    if (!file) {
+        xlog::error("Failed to open packfile {}", packfile->path);
+        return false;
+    }
+
+    // Process file header
+    char buf[vpp::block_size];
+    if (!file.read(buf, sizeof(buf))) {
+        xlog::error("Failed to read VPP header: {}", packfile->filename);
+        return false;
+    }
+    // Note: VPackfileProcessHeader returns number of files in packfile - result 0 is not always a true error
+    if (!vpackfile_process_header(packfile, buf)) {
+        return false;
+    }
+
+    // Read all directory blocks at once
+    std::size_t num_dir_blocks = vpp::num_directory_blocks(packfile->num_files);
+    scan.owned_files.resize(num_dir_blocks * vpp::entries_per_block);
+    if (!file.read(reinterpret_cast<char*>(scan.owned_files.data()), num_dir_blocks * vpp::block_size)) {
+        xlog::error("Failed to read vpp {}", packfile->path);
+        return false;
+    }
+    scan.owned_files.resize(packfile->num_files);
+    scan.files = scan.owned_files;
+
+    // Seek table directly follows the directory
+    const auto* compression_hdr = vpp::get_compression_header(std::as_bytes(std::span{buf}));
+    if (compression_hdr) {
+        std::vector<char> seek_table(vpp::seek_table_size(packfile->num_files, compression_hdr->num_chunks));
+        if (!file.read(seek_table.data(), seek_table.size())) {
+            xlog::error("Failed to read seek table of vpp {}", packfile->path);
+            return false;
+        }
+        return vpackfile_load_seek_table(scan, *compression_hdr, std::as_bytes(std::span{seek_table}));
+    }
+    return true;
+}
+
+static bool vpackfile_scan_mapped(VPackfileScan& scan)
+{
+    rf::VPackfile* packfile = scan.packfile.get();
+    if (!scan.mapping.open(packfile->path)) {
+        return false;
+    }
+    auto data = scan.mapping.data();
+    const vpp::Header* hdr = vpp::parse_header(data);
+    if (!hdr) {
+        xlog::error("Invalid VPP header: {}", packfile->filename);
+        scan.mapping.close();
+        return false;
+    }
+    auto directory = vpp::get_directory(data, *hdr);
+    if (directory.size() != hdr->num_files) {
+        xlog::error("Truncated VPP directory: {}", packfile->path);
+        scan.mapping.close();
+        return false;
+    }
+    vpackfile_process_header(packfile, hdr);
+    // Directory records are parsed in place (they are copied when the mapping is released)
+    scan.files = directory;
+
+    const auto* compression_hdr = vpp::get_compression_header(data);
+    if (compression_hdr) {
+        std::size_t seek_table_offset = vpp::seek_table_offset(hdr->num_files);
+        std::size_t seek_table_size = vpp::seek_table_size(hdr->num_files, compression_hdr->num_chunks);
+        if (data.size() < seek_table_offset || data.size() - seek_table_offset < seek_table_size ||
+            !vpackfile_load_seek_table(scan, *compression_hdr, data.subspan(seek_table_offset, seek_table_size))) {
+            scan.mapping.close();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Hashes contents of all files in an uncompressed packfile
+static bool vpackfile_hash_contents(VPackfileScan& scan)
+{
+    rf::VPackfile* packfile = scan.packfile.get();
+    std::size_t block = 1 + vpp::num_directory_blocks(scan.files.size());
+    scan.content_hashes.reserve(scan.files.size());
+    if (scan.mapping.is_open()) {
+        for (const auto& record : scan.files) {
+            auto data = vpp::get_file_data(scan.mapping.data(), block, record.size);
+            if (data.size() != record.size) {
+                return false;
+            }
+            scan.content_hashes.push_back(XXH64(data.data(), data.size(), 0));
+            block += vpp::num_blocks(record.size);
+        }
+        return true;
+    }
+
+    std::ifstream file(packfile->path, std::ios_base::in | std::ios_base::binary);
+    std::vector<char> buf;
+    for (const auto& record : scan.files) {
+        buf.resize(record.size);
+        if (!file.seekg(block * vpp::block_size) || !file.read(buf.data(), buf.size())) {
+            return false;
+        }
+        scan.content_hashes.push_back(XXH64(buf.data(), buf.size(), 0));
+        block += vpp::num_blocks(record.size);
+    }
+    return true;
+}
+
+static void vpackfile_scan_directory(VPackfileScan& scan)
+{
+    if (!scan.packfile) {
+        return;
+    }
+    bool scanned = false;
+    if (scan.indexed_dir) {
+        scan.packfile->num_files = scan.indexed_dir->files.size();
+        scan.packfile->file_size = scan.indexed_dir->total_size;
+        scan.files = scan.indexed_dir->files;
+        scan.persistent_names = true;
+        scanned = true;
+        // Only the directory is taken from the index - in mmap mode file contents that still have to be read
+        // (hashed for deduplication) are read through the mapping
+        bool needs_contents = g_use_packfile_dedup && scan.indexed_dir->content_hashes.empty();
+        if (g_use_mapped_packfiles && needs_contents && !scan.mapping.open(scan.packfile->path)) {
+            xlog::warn("Cannot memory-map packfile {}, falling back to stream reading", scan.packfile->path);
+        }
+    }
+    else if (g_use_mapped_packfiles) {
+        scanned = vpackfile_scan_mapped(scan);
+        if (!scanned) {
+            // Mapping can fail because of address space fragmentation - fallback to stream reading
+            xlog::warn("Cannot memory-map packfile {}, falling back to stream reading", scan.packfile->path);
+            scanned = vpackfile_scan_stream(scan);
+        }
+    }
+    else {
+        scanned = vpackfile_scan_stream(scan);
+    }
+    if (!scanned) {
+        return;
+    }
+
+    scan.name_hashes.reserve(scan.files.size());
+    for (const auto& record : scan.files) {
+        scan.name_hashes.push_back(vpackfile_hash_name({record.name, strnlen(record.name, sizeof(record.name))}));
+    }
+
+    if (g_use_packfile_dedup && !scan.compressed_data) {
+        if (scan.indexed_dir && !scan.indexed_dir->content_hashes.empty()) {
+            scan.content_hashes.assign(scan.indexed_dir->content_hashes.begin(), scan.indexed_dir->content_hashes.end());
+        }
+        else if (vpackfile_hash_contents(scan)) {
+            scan.content_hashes_computed = true;
+        }
+        else {
+            xlog::warn("Failed to hash contents of packfile {}", scan.packfile->path);
+            scan.content_hashes.clear();
+        }
+    }
+
+    if (scan.mapping.is_open()) {
+        // Entry data is read by the stock code through its own file handle so the mapping is only needed during
+        // the scan. Releasing it keeps the address space of the 32-bit process free.
+        if (!scan.indexed_dir) {
+            scan.owned_files.assign(scan.files.begin(), scan.files.end());
+            scan.files = scan.owned_files;
+        }
+        scan.mapping.close();
+    }
+    scan.scanned = true;
+}
+
+static std::optional<VPackfileStamp> vpackfile_get_stamp(const char* path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attrs)) {
+        return {};
+    }
+    VPackfileStamp stamp;
+    stamp.file_size = (static_cast<uint64_t>(attrs.nFileSizeHigh) << 32) | attrs.nFileSizeLow;
+    stamp.mtime = (static_cast<uint64_t>(attrs.ftLastWriteTime.dwHighDateTime) << 32) |
+        attrs.ftLastWriteTime.dwLowDateTime;
+    return {stamp};
+}
+
+static void vpackfile_add_to_index(const rf::VPackfile* packfile, const VPackfileStamp& stamp)
+{
+    std::vector<vpp::FileInfo> files;
+    files.reserve(packfile->files.size());
+    for (const auto& entry : packfile->files) {
+        vpp::FileInfo& info = files.emplace_back();
+        std::strncpy(info.name, entry.name, sizeof(info.name) - 1);
+        info.name[sizeof(info.name) - 1] = '\0';
+        info.size = entry.size;
+    }
+    g_packfile_index.add(packfile->path, stamp, packfile->file_size, std::move(files));
+}
+
+static VPackfileScan vpackfile_prepare_scan(const char* filename, const char* dir)
+{
+    xlog::trace("Load packfile {} {}", dir, filename);
+    VPackfileScan scan;
+
+    std::string full_path;
+    if (dir && !PathIsRelativeA(dir))
+        full_path = std::format("{}{}", dir, filename); // absolute path
+    else
+        full_path = std::format("{}{}{}", rf::root_path, dir ? dir : "", filename);
+
+    if (!filename || strlen(filename) > 0x1F || full_path.size() > 0x7F) {
+        xlog::error("Packfile name or path too long: {}", full_path);
+        return scan;
+    }
+
+    for (auto& packfile : g_packfiles) {
+        if (!stricmp(packfile->path, full_path.c_str())) {
+            scan.already_loaded = true;
+            return scan;
+        }
+    }
+
+    auto packfile = std::make_unique<rf::VPackfile>();
+    std::strncpy(packfile->filename, filename, sizeof(packfile->filename) - 1);
+    packfile->filename[sizeof(packfile->filename) - 1] = '\0';
+    std::strncpy(packfile->path, full_path.c_str(), sizeof(packfile->path) - 1);
+    packfile->path[sizeof(packfile->path) - 1] = '\0';
+    packfile->field_a0 = 0;
+    packfile->num_files = 0;
+    // this is set to true for user_maps
+    packfile->is_user_maps = rf::vpackfile_loading_user_maps;
+    packfile->is_added_after_init = g_is_overriding_disabled;
+    packfile->is_compressed = false;
+
+    scan.stamp = vpackfile_get_stamp(packfile->path);
+    if (scan.stamp) {
+        if (!dir) {
+            vpackfile_queue_verification(filename, packfile->path, scan.stamp.value());
+        }
+        scan.indexed_dir = g_packfile_index.find(packfile->path, scan.stamp.value());
+    }
+    scan.packfile = std::move(packfile);
+    return scan;
+}
+
+static int vpackfile_register(VPackfileScan& scan)
+{
+    if (scan.already_loaded) {
+        return 1;
+    }
+    if (!scan.scanned) {
+        return 0;
+    }
+    rf::VPackfile* packfile = scan.packfile.get();
+    packfile->files.resize(scan.files.size());
+    unsigned num_added = 0;
+    vpackfile_add_entries_internal(packfile, scan.files.data(), scan.files.size(), num_added,
+        scan.persistent_names, scan.name_hashes.data());
+    packfile->files.resize(num_added);
+    packfile->is_compressed = scan.compressed_data != nullptr;
+    if (packfile->is_compressed) {
+        // Compressed files have no valid block until they are decompressed into the cache
+        for (std::size_t i = 0; i < packfile->files.size(); ++i) {
+            const auto& info = scan.compressed_data->get_file_info(i);
+            bool is_stored = info.compression == vpp::Compression::none;
+            packfile->files[i].block = is_stored ? info.offset / vpp::block_size : 0;
+        }
+        g_packfile_compressed_data.emplace(packfile, std::move(scan.compressed_data));
+    }
+    else {
+        vpackfile_setup_entry_blocks(packfile, 1 + vpp::num_directory_blocks(packfile->num_files));
+    }
+
+    // Note: index does not store seek tables so compressed packfiles are always scanned
+    if (!scan.indexed_dir && scan.stamp && !packfile->is_compressed) {
+        vpackfile_add_to_index(packfile, scan.stamp.value());
+    }
+    if (!scan.content_hashes.empty()) {
+        if (scan.content_hashes_computed && scan.stamp) {
+            g_packfile_index.set_content_hashes(packfile->path, scan.stamp.value(),
+                std::vector<uint64_t>{scan.content_hashes});
+        }
+        // Note: must be done after entries were added to the lookup table because override rules use entry parents
+        g_packfile_dedup.add(*packfile, scan.content_hashes);
+        g_packfile_content_hashes.emplace(packfile, std::move(scan.content_hashes));
+    }
+    if (scan.stamp) {
+        g_packfile_stamps.emplace(packfile, scan.stamp.value());
+    }
+    g_packfile_ext_indices[packfile].build(*packfile);
+    g_packfiles.push_back(std::move(scan.packfile));
     return 1;
 }
 
+static int vpackfile_add_new(const char* filename, const char* dir)
+{
+    VPackfileScan scan = vpackfile_prepare_scan(filename, dir);
+    if (g_pending_scans) {
+        // Make sure a packfile requested twice in one batch is only loaded once
+        for (auto& pending_scan : *g_pending_scans) {
+            if (scan.packfile && pending_scan.packfile &&
+                !stricmp(pending_scan.packfile->path, scan.packfile->path)) {
+                return 1;
+            }
+        }
+        // Note: errors are reported when the batch is processed
+        g_pending_scans->push_back(std::move(scan));
+        return 1;
+    }
+    vpackfile_scan_directory(scan);
+    return vpackfile_register(scan);
+}
+
+// Packfiles added between begin and end of a batch have their directories scanned in parallel
+// They are registered in the order they were added so the result is the same as with serial loading
+static void vpackfile_begin_batch()
+{
+    g_pending_scans = new std::vector<VPackfileScan>;
+}
+
+// Returns false if any packfile from the batch failed to load
+static bool vpackfile_end_batch()
+{
+    std::unique_ptr<std::vector<VPackfileScan>> scans{std::exchange(g_pending_scans, nullptr)};
+
+    std::atomic<std::size_t> next_scan{0};
+    auto worker = [&]() {
+        std::size_t i;
+        while ((i = next_scan++) < scans->size()) {
+            vpackfile_scan_directory((*scans)[i]);
+        }
+    };
+    unsigned num_threads = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < num_threads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    bool success = true;
+    for (auto& scan : *scans) {
+        if (!vpackfile_register(scan)) {
+            xlog::error("Failed to load packfile {}", scan.packfile ? scan.packfile->path : "");
+            success = false;
+        }
+    }
+    return success;
+}
+
+static void vpackfile_set_loading_user_maps_new(bool loading_user_maps)
+{
+    rf::vpackfile_loading_user_maps = loading_user_maps;
+    // Game initialization loads all packfiles from user_maps one by one - scan them in parallel too
+    // Note: packfiles added later are loaded immediately because callers use the result
+    if (loading_user_maps && !g_pending_scans && !g_is_overriding_disabled) {
+        vpackfile_begin_batch();
+        g_is_user_maps_batch = true;
+    }
+    else if (!loading_user_maps && g_is_user_maps_batch) {
+        g_is_user_maps_batch = false;
+        vpackfile_end_batch();
+    }
+}
+
+static void vpackfile_prefetch_record_access(const rf::VPackfileEntry* entry)
+{
+    if (!g_prefetch_recorded_entries.insert(entry).second) {
+        return;
+    }
+    g_prefetch_recorded_names.emplace_back(entry->name);
+
+    auto it = g_prefetch_range_indices.find(entry);
+    if (it != g_prefetch_range_indices.end() && g_prefetcher.is_prefetched(it->second)) {
+        ++g_num_prefetch_hits;
+    }
+    else {
+        ++g_num_prefetch_misses;
+    }
+}
+
 static rf::VPackfileEntry* vpackfile_find_new(const char* filename)
 {
-    std::string filename_str{filename};
-    std::transform(filename_str.begin(), filename_str.end(), filename_str.begin(), [](unsigned char ch) {
-        return std::tolower(ch);
-    });
-    auto it = g_loopup_table.find(filename_str);
-    if (it != g_loopup_table.end()) {
-        return it->second;
+    auto* entry = g_loopup_table.find(filename);
+    if (!entry) {
+        xlog::trace("Cannot find file {}", filename);
+        return nullptr;
     }
-    xlog::trace("Cannot find file {}", filename_str);
-    return nullptr;
+    if (!g_prefetch_profile_path.empty()) {
+        vpackfile_prefetch_record_access(entry);
+    }
+    if (entry->parent->is_compressed) {
+        // Stock code can only read uncompressed data so decompress the file before it is opened
+        auto& compressed_data = g_packfile_compressed_data.at(entry->parent);
+        if (!compressed_data->decompress_entry(*entry)) {
+            return nullptr;
+        }
+    }
+    return entry;
 }
 
 CodeInjection vpackfile_open_check_seek_result_injection{
@@ -407,9 +820,19 @@ static void load_dashfaction_vpp()
         }
     }
     xlog::info("Loading {} from directory: {}", df_vpp_base_name, df_vpp_dir);
-    if (!rf::vpackfile_add(df_vpp_base_name, df_vpp_dir.c_str())) {
-        xlog::error("Failed to load {}", df_vpp_base_name);
+    // Note: it is loaded in a batch so the result is checked in vpackfile_init_new
+    rf::vpackfile_add(df_vpp_base_name, df_vpp_dir.c_str());
+}
+
+// Returns the packfile that contains data of the entry (decompressed entries are redirected to a cache file)
+static const rf::VPackfile* vpackfile_get_data_packfile(const rf::VPackfileEntry& entry)
+{
+    for (const auto& [packfile, compressed_data] : g_packfile_compressed_data) {
+        if (compressed_data->get_cache_packfile() == entry.parent) {
+            return packfile;
+        }
     }
+    return entry.parent;
 }
 
 ConsoleCommand2 which_packfile_cmd{
@@ -417,7 +840,18 @@ ConsoleCommand2 which_packfile_cmd{
     [](std::string filename) {
         auto* entry = vpackfile_find_new(filename.c_str());
         if (entry) {
-            rf::console::print("{}", entry->parent->path);
+            const rf::VPackfile* owner = g_packfile_dedup.get_owner(*entry);
+            const rf::VPackfile* data_packfile = vpackfile_get_data_packfile(*entry);
+            if (owner) {
+                rf::console::print("{} (data shared with {})", owner->path, data_packfile->path);
+            }
+            else {
+                rf::console::print("{}", data_packfile->path);
+            }
+            if (g_use_packfile_dedup) {
+                rf::console::print("Deduplicated files: {} ({} KB)", g_packfile_dedup.get_num_shared_entries(),
+                    g_packfile_dedup.get_shared_bytes() / 1024);
+            }
         }
         else {
             rf::console::print("Cannot find {}!", filename);
@@ -426,23 +860,316 @@ ConsoleCommand2 which_packfile_cmd{
     "Prints packfile path that the provided file is included in",
 };
 
-void force_file_from_packfile(const char* name, const char* packfile_name)
+ConsoleCommand2 packfile_verify_status_cmd{
+    "packfile_verify_status",
+    []() {
+        if (!g_packfile_verifier.is_started()) {
+            rf::console::print("Packfile verification has not started");
+            return;
+        }
+        rf::console::print("Verified packfiles: {}/{} ({}/{} MB){}", g_packfile_verifier.get_num_finished_jobs(),
+            g_packfile_verifier.get_num_jobs(), g_packfile_verifier.get_bytes_processed() / (1024 * 1024),
+            g_packfile_verifier.get_bytes_total() / (1024 * 1024),
+            g_packfile_verifier.is_finished() ? "" : " - in progress");
+        if (g_packfile_verifier.is_finished()) {
+            rf::console::print("Modded game: {}", g_is_modded_game ? "yes" : "no");
+        }
+    },
+    "Prints progress of the background packfile checksum verification",
+};
+
+ConsoleCommand2 packfile_rescan_cmd{
+    "packfile_rescan",
+    []() {
+        g_user_maps_rescan_pending = true;
+        rf::console::print("User maps will be rescanned when the next level is loaded");
+    },
+    "Reloads packfiles from user_maps\\multi directory when the next level is loaded",
+};
+
+ConsoleCommand2 vpp_lookup_bench_cmd{
+    "d_vpp_lookup_bench",
+    [](std::optional<std::string> level_filename) {
+        // Compare the lookup table with std::unordered_map keyed by lowercase names (used before) on at least 10k
+        // entries. File-open sequence of a level load is taken from its prefetch profile.
+        constexpr std::size_t min_entries = 10000;
+        constexpr std::size_t min_lookups = 200000;
+        std::vector<rf::VPackfileEntry*> entries;
+        g_loopup_table.for_each([&](rf::VPackfileEntry* entry) {
+            entries.push_back(entry);
+        });
+        std::size_t num_synthetic = entries.size() < min_entries ? min_entries - entries.size() : 0;
+        std::vector<std::string> synthetic_names;
+        std::vector<rf::VPackfileEntry> synthetic_entries(num_synthetic);
+        // Note: no reallocation happens so entries can point to the names
+        synthetic_names.reserve(num_synthetic);
+        for (std::size_t i = 0; i < num_synthetic; ++i) {
+            synthetic_names.push_back(std::format("Bench_File{:05}.tga", i));
+            synthetic_entries[i].name = synthetic_names.back().c_str();
+            entries.push_back(&synthetic_entries[i]);
+        }
+
+        std::vector<std::string> sequence;
+        if (level_filename) {
+            sequence = VPackfilePrefetcher::load_profile(std::format("{}dashfaction_cache\\{}.prefetch",
+                rf::root_path, string_to_lower(level_filename.value())));
+            if (sequence.empty()) {
+                rf::console::print("No file-open profile for {} - load the level once first", level_filename.value());
+                return;
+            }
+        }
+        else {
+            // Every tenth name does not exist like optional files checked by the game
+            unsigned seed = 12345;
+            for (int i = 0; i < 2000; ++i) {
+                seed = seed * 1664525 + 1013904223;
+                const char* name = entries[seed % entries.size()]->name;
+                sequence.push_back(i % 10 ? name : std::format("missing_{}", name));
+            }
+        }
+
+        VPackfileLookupTable table;
+        std::unordered_map<std::string, rf::VPackfileEntry*> map;
+        auto start = std::chrono::steady_clock::now();
+        table.reserve(entries.size());
+        for (auto* entry : entries) {
+            table.insert(entry, vpackfile_hash_name(entry->name));
+        }
+        auto table_build_end = std::chrono::steady_clock::now();
+        map.reserve(entries.size());
+        for (auto* entry : entries) {
+            map.emplace(string_to_lower(entry->name), entry);
+        }
+        auto map_build_end = std::chrono::steady_clock::now();
+
+        std::size_t num_rounds = (min_lookups + sequence.size() - 1) / sequence.size();
+        int table_hits = 0;
+        for (std::size_t i = 0; i < num_rounds; ++i) {
+            for (const auto& name : sequence) {
+                table_hits += table.find(name) != nullptr;
+            }
+        }
+        auto table_lookup_end = std::chrono::steady_clock::now();
+        int map_hits = 0;
+        for (std::size_t i = 0; i < num_rounds; ++i) {
+            for (const auto& name : sequence) {
+                map_hits += map.find(string_to_lower(name)) != map.end();
+            }
+        }
+        auto map_lookup_end = std::chrono::steady_clock::now();
+
+        using us = std::chrono::microseconds;
+        rf::console::print("Lookup benchmark: {} entries ({} synthetic), build: table {} us, unordered_map {} us",
+            entries.size(), num_synthetic, std::chrono::duration_cast<us>(table_build_end - start).count(),
+            std::chrono::duration_cast<us>(map_build_end - table_build_end).count());
+        rf::console::print("{} x {} opens: table {} us ({} hits), unordered_map {} us ({} hits)", num_rounds,
+            sequence.size(), std::chrono::duration_cast<us>(table_lookup_end - map_build_end).count(), table_hits,
+            std::chrono::duration_cast<us>(map_lookup_end - table_lookup_end).count(), map_hits);
+    },
+    "Measures performance of packfile file lookups (optionally replaying file opens of a level load)",
+};
+
+ConsoleCommand2 vpp_ext_index_bench_cmd{
+    "d_vpp_ext_index_bench",
+    []() {
+        // Compare extension index queries with a scan of all entries (used before) on a 20k-file packfile
+        constexpr int num_files = 20000;
+        constexpr int num_rounds = 100;
+        // Extensions roughly in proportions of the stock packfiles
+        constexpr std::array<const char*, 10> file_exts{"tga", "TGA", "tga", "vbm", "v3d", "v3c", "wav", "wav",
+            "rfl", "tbl"};
+        const std::array<std::vector<std::string_view>, 4> queries{{
+            {"rfl"},
+            {"tga", "vbm"},
+            {"v3d", "v3c", "vfx"},
+            {"wav"},
+        }};
+        rf::VPackfile packfile{};
+        std::vector<std::string> names;
+        names.reserve(num_files);
+        unsigned seed = 12345;
+        for (int i = 0; i < num_files; ++i) {
+            seed = seed * 1664525 + 1013904223;
+            names.push_back(std::format("bench_file{:05}.{}", i, file_exts[(seed >> 16) % file_exts.size()]));
+            rf::VPackfileEntry entry{};
+            entry.name = names.back().c_str();
+            entry.parent = &packfile;
+            packfile.files.push_back(entry);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        VPackfileExtIndex index;
+        index.build(packfile);
+        auto build_end = std::chrono::steady_clock::now();
+        int index_matches = 0;
+        for (int i = 0; i < num_rounds; ++i) {
+            for (const auto& exts : queries) {
+                index.for_each_matching(exts, [&](uint32_t) {
+                    ++index_matches;
+                });
+            }
+        }
+        auto index_end = std::chrono::steady_clock::now();
+        int scan_matches = 0;
+        for (int i = 0; i < num_rounds; ++i) {
+            for (const auto& exts : queries) {
+                std::vector<std::string> exts_lower;
+                std::transform(exts.begin(), exts.end(), std::back_inserter(exts_lower), string_to_lower);
+                for (auto& entry : packfile.files) {
+                    const char* ext_ptr = rf::file_get_ext(entry.name);
+                    if (ext_ptr[0]) {
+                        ++ext_ptr;
+                    }
+                    if (iterable_contains(exts_lower, string_to_lower(ext_ptr))) {
+                        ++scan_matches;
+                    }
+                }
+            }
+        }
+        auto scan_end = std::chrono::steady_clock::now();
+
+        using us = std::chrono::microseconds;
+        rf::console::print("Extension index benchmark: {} files, index built in {} us, {} queries: index {} us "
+            "({} matches), scan {} us ({} matches)", num_files,
+            std::chrono::duration_cast<us>(build_end - start).count(), num_rounds * queries.size(),
+            std::chrono::duration_cast<us>(index_end - build_end).count(), index_matches,
+            std::chrono::duration_cast<us>(scan_end - index_end).count(), scan_matches);
+    },
+    "Measures performance of packfile file list queries",
+};
+
+static void vpackfile_force_file(const char* name, const char* packfile_name)
 {
     rf::VPackfile* packfile = vpackfile_find_packfile(packfile_name);
     if (packfile) {
         for (auto& entry : packfile->files) {
             if (string_equals_ignore_case(entry.name, name)) {
-                vpackfile_add_to_lookup_table(&entry);
+                vpackfile_add_to_lookup_table(&entry, vpackfile_hash_name(entry.name));
             }
         }
     }
 }
 
+void force_file_from_packfile(const char* name, const char* packfile_name)
+{
+    vpackfile_force_file(name, packfile_name);
+    // Remember forced files so they survive rebuilding of the lookup table
+    g_forced_files.emplace_back(name, packfile_name);
+}
+
+// Loads all packfiles again, serially and in a batch, and checks that every file name is resolved to the same packfile
+// as in the current state
+static bool vpackfile_test_batch_loading()
+{
+    struct Request
+    {
+        std::string filename;
+        std::string dir;
+        bool is_user_maps;
+        bool is_added_after_init;
+    };
+    std::vector<Request> requests;
+    for (auto& packfile : g_packfiles) {
+        std::string_view path{packfile->path};
+        std::string dir{path.substr(0, path.size() - std::strlen(packfile->filename))};
+        requests.push_back({packfile->filename, std::move(dir), packfile->is_user_maps, packfile->is_added_after_init});
+    }
+    if (!requests.empty()) {
+        // Packfile requested again must not change anything
+        requests.push_back(requests.front());
+    }
+
+    auto get_resolved_files = []() {
+        std::vector<std::string> result;
+        for (auto& packfile : g_packfiles) {
+            for (auto& entry : packfile->files) {
+                const rf::VPackfileEntry* found = g_loopup_table.find(entry.name);
+                const rf::VPackfile* owner = g_packfile_dedup.get_owner(*found);
+                result.push_back(std::format("{} {}", entry.name, owner ? owner->path : found->parent->path));
+            }
+        }
+        return result;
+    };
+    auto load = [&](bool batch) {
+        if (batch) {
+            vpackfile_begin_batch();
+        }
+        for (auto& req : requests) {
+            rf::vpackfile_loading_user_maps = req.is_user_maps;
+            g_is_overriding_disabled = req.is_added_after_init;
+            vpackfile_add_new(req.filename.c_str(), req.dir.c_str());
+        }
+        rf::vpackfile_loading_user_maps = false;
+        g_is_overriding_disabled = false;
+        if (batch) {
+            vpackfile_end_batch();
+        }
+        for (auto& [name, packfile_name] : g_forced_files) {
+            vpackfile_force_file(name.c_str(), packfile_name.c_str());
+        }
+        auto result = get_resolved_files();
+        g_packfiles.clear();
+        g_loopup_table.clear();
+        g_packfile_ext_indices.clear();
+        g_packfile_stamps.clear();
+        g_packfile_compressed_data.clear();
+        return result;
+    };
+
+    auto current_result = get_resolved_files();
+    // Load into empty state and restore the real one afterwards
+    // Note: deduplication is disabled so entries of the real packfiles are not touched
+    auto packfiles = std::exchange(g_packfiles, {});
+    auto lookup_table = std::exchange(g_loopup_table, {});
+    auto ext_indices = std::exchange(g_packfile_ext_indices, {});
+    auto stamps = std::exchange(g_packfile_stamps, {});
+    auto compressed_data = std::exchange(g_packfile_compressed_data, {});
+    bool use_dedup = std::exchange(g_use_packfile_dedup, false);
+    bool is_overriding_disabled = g_is_overriding_disabled;
+    unsigned num_files_in_packfiles = g_num_files_in_packfiles;
+    unsigned num_name_collisions = g_num_name_collisions;
+
+    auto serial_result = load(false);
+    auto batch_result = load(true);
+    bool success = serial_result == current_result && batch_result == serial_result;
+
+    g_packfiles = std::move(packfiles);
+    g_loopup_table = std::move(lookup_table);
+    g_packfile_ext_indices = std::move(ext_indices);
+    g_packfile_stamps = std::move(stamps);
+    g_packfile_compressed_data = std::move(compressed_data);
+    g_use_packfile_dedup = use_dedup;
+    g_num_files_in_packfiles = num_files_in_packfiles;
+    g_num_name_collisions = num_name_collisions;
+    g_is_overriding_disabled = is_overriding_disabled;
+    return success;
+}
+
+ConsoleCommand2 vpp_batch_test_cmd{
+    "d_vpp_batch_test",
+    []() {
+        auto start = std::chrono::steady_clock::now();
+        bool success = vpackfile_test_batch_loading();
+        auto end = std::chrono::steady_clock::now();
+        rf::console::print("Packfile batch loading test {} ({} ms)", success ? "passed" : "failed",
+            std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+    },
+    "Loads all packfiles again serially and in a batch and checks that files are resolved to the same packfiles",
+};
+
 static void vpackfile_init_new()
 {
     unsigned start_ticks = GetTickCount();
 
     g_loopup_table.reserve(10000);
+    g_packfile_index.load(vpackfile_get_index_path());
+    VPackfileCompressedData::remove_stale_cache_files();
+    g_use_mapped_packfiles = get_vpp_mmap_cmd_line_param().found();
+    if (g_use_mapped_packfiles) {
+        xlog::info("Using memory-mapped packfiles");
+    }
+    g_use_packfile_dedup = get_vpp_dedup_cmd_line_param().found();
+    vpackfile_begin_batch();
 
     if (get_installed_game_lang() == LANG_GR) {
         if (!rf::is_dedicated_server) {
@@ -488,6 +1215,11 @@ static void vpackfile_init_new()
         load_dashfaction_vpp();
     }
     rf::vpackfile_add("tables.vpp", nullptr);
+    vpackfile_end_batch();
+    if (!rf::is_dedicated_server && !vpackfile_find_packfile("dashfaction.vpp")) {
+        xlog::error("Failed to load dashfaction.vpp");
+    }
+    g_packfile_verifier.start();
     addr_as_ref<int>(0x01BDB218) = 1;          // VPackfilesLoaded
     addr_as_ref<uint32_t>(0x01BDB210) = 10000; // NumFilesInVfs
     addr_as_ref<uint32_t>(0x01BDB214) = 100;   // NumPackfiles
@@ -514,19 +1246,41 @@ static void vpackfile_init_new()
         force_file_from_packfile("strings.tbl", "ui.vpp");
     }
 
-    xlog::info("Packfiles initialization took {}ms", GetTickCount() - start_ticks);
+    xlog::info("Packfiles initialization took {}ms (deduplicated files: {}, {} KB)", GetTickCount() - start_ticks,
+        g_packfile_dedup.get_num_shared_entries(), g_packfile_dedup.get_shared_bytes() / 1024);
     xlog::info("Packfile name collisions: {}", g_num_name_collisions);
+    xlog::info("Packfiles loaded from index: {}/{}", g_packfile_index.num_hits(), g_packfiles.size());
 
     if (g_is_modded_game)
         xlog::info("Modded game detected!");
 
     // Commands
     which_packfile_cmd.register_cmd();
+    packfile_verify_status_cmd.register_cmd();
+    packfile_rescan_cmd.register_cmd();
+    vpp_lookup_bench_cmd.register_cmd();
+    vpp_ext_index_bench_cmd.register_cmd();
+    vpp_batch_test_cmd.register_cmd();
 }
 
 static void vpackfile_cleanup_new()
 {
+    g_packfile_verifier.stop();
+    g_prefetcher.stop();
+    g_packfile_dedup.undo_all();
+    g_packfile_content_hashes.clear();
+    g_loopup_table.clear();
+    g_packfile_ext_indices.clear();
     g_packfiles.clear();
+    g_retired_packfiles.clear();
+    g_packfile_stamps.clear();
+    g_packfile_compressed_data.clear();
+    g_forced_files.clear();
+    g_packfile_index.clear();
+    if (g_user_maps_change_notification != INVALID_HANDLE_VALUE) {
+        FindCloseChangeNotification(g_user_maps_change_notification);
+        g_user_maps_change_notification = INVALID_HANDLE_VALUE;
+    }
 }
 
 void vpackfile_apply_patches()
@@ -539,10 +1293,15 @@ void vpackfile_apply_patches()
     AsmWriter(0x0052C220).jmp(vpackfile_find_new);
     AsmWriter(0x0052BB60).jmp(vpackfile_init_new);
     AsmWriter(0x0052BC80).jmp(vpackfile_cleanup_new);
+    AsmWriter(0x0052BB50).jmp(vpackfile_set_loading_user_maps_new);
 
     // Don't return success from vpackfile_open if offset points out of file contents
     vpackfile_open_check_seek_result_injection.install();
 
+    // Register command line params
+    get_vpp_mmap_cmd_line_param();
+    get_vpp_dedup_cmd_line_param();
+
 #ifdef DEBUG
     write_mem<u8>(0x0052BEF0, asm_opcodes::int3); // vpackfile_init_file_list
     write_mem<u8>(0x0052BF50, asm_opcodes::int3); // vpackfile_load_internal
@@ -554,16 +1313,285 @@ void vpackfile_apply_patches()
 #endif
 }
 
-void vpackfile_find_matching_files(const StringMatcher& query, std::function<void(const char*)> result_consumer)
+void vpackfile_find_matching_files(std::string_view ext, const StringMatcher& query,
+    std::function<void(const char*)> result_consumer)
 {
-    for (auto& p : g_loopup_table) {
-        if (query(p.first.c_str())) {
-            result_consumer(p.first.c_str());
+    std::array<std::string_view, 1> exts{ext};
+    char name_lower[64];
+    for (auto& packfile : g_packfiles) {
+        auto it = g_packfile_ext_indices.find(packfile.get());
+        if (it == g_packfile_ext_indices.end()) {
+            continue;
         }
+        it->second.for_each_matching(exts, [&](uint32_t index) {
+            auto& entry = packfile->files[index];
+            // Skip entries that are overriden by other packfiles so every name is reported once
+            if (g_loopup_table.find(entry.name) != &entry) {
+                return;
+            }
+            std::size_t len = 0;
+            for (; entry.name[len] && len + 1 < std::size(name_lower); ++len) {
+                name_lower[len] = vpackfile_name_char_to_lower(entry.name[len]);
+            }
+            name_lower[len] = '\0';
+            if (query(name_lower)) {
+                result_consumer(name_lower);
+            }
+        });
     }
 }
 
+void vpackfile_find_matching_files(const StringMatcher& query, std::function<void(const char*)> result_consumer)
+{
+    g_loopup_table.for_each([&](rf::VPackfileEntry* entry) {
+        std::string name_lower = string_to_lower(entry->name);
+        if (query(name_lower)) {
+            result_consumer(name_lower.c_str());
+        }
+    });
+}
+
 void vpackfile_disable_overriding()
 {
     g_is_overriding_disabled = true;
+
+    // All startup packfiles (including user_maps) are loaded at this point
+    if (g_packfile_index.needs_save()) {
+        g_packfile_index.save(vpackfile_get_index_path());
+    }
+
+    // Watch user_maps so new levels can be used without restarting the game
+    auto user_maps_dir = std::format("{}user_maps\\multi", rf::root_path);
+    g_user_maps_change_notification = FindFirstChangeNotificationA(user_maps_dir.c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (g_user_maps_change_notification == INVALID_HANDLE_VALUE) {
+        xlog::warn("Cannot watch {} for changes (error {})", user_maps_dir, GetLastError());
+    }
+}
+
+static bool vpackfile_is_file_complete(const char* path)
+{
+    // Opening fails with a sharing violation if the file is still being written (e.g. copied or extracted)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    CloseHandle(file);
+    return true;
+}
+
+static void vpackfile_rebuild_lookup_table()
+{
+    // Override rules only depend on the packfiles themselves so replaying them in load order gives the same result
+    // as the original loading
+    std::size_t capacity = g_loopup_table.size();
+    g_loopup_table.clear();
+    g_loopup_table.reserve(capacity);
+    g_num_files_in_packfiles = 0;
+    g_num_name_collisions = 0;
+    for (auto& packfile : g_packfiles) {
+        for (auto& entry : packfile->files) {
+            vpackfile_add_to_lookup_table(&entry, vpackfile_hash_name(entry.name));
+            ++g_num_files_in_packfiles;
+        }
+    }
+    for (auto& [name, packfile_name] : g_forced_files) {
+        vpackfile_force_file(name.c_str(), packfile_name.c_str());
+    }
+}
+
+void vpackfile_reload_user_maps()
+{
+    if (!g_user_maps_rescan_pending) {
+        return;
+    }
+    g_user_maps_rescan_pending = false;
+    unsigned start_ticks = GetTickCount();
+    g_retired_packfiles.clear();
+
+    struct UserMapsFile
+    {
+        std::string filename;
+        VPackfileStamp stamp;
+    };
+    // Note: ordered by lowercased name so packfiles are always added in the same order
+    std::map<std::string, UserMapsFile> found_files;
+    auto user_maps_dir = std::format("{}user_maps\\multi\\", rf::root_path);
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA((user_maps_dir + "*.vpp").c_str(), &find_data);
+    if (find_handle != INVALID_HANDLE_VALUE) {
+        do {
+            if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+                string_ends_with_ignore_case(find_data.cFileName, ".vpp")) {
+                UserMapsFile file;
+                file.filename = find_data.cFileName;
+                file.stamp.file_size = (static_cast<uint64_t>(find_data.nFileSizeHigh) << 32) |
+                    find_data.nFileSizeLow;
+                file.stamp.mtime = (static_cast<uint64_t>(find_data.ftLastWriteTime.dwHighDateTime) << 32) |
+                    find_data.ftLastWriteTime.dwLowDateTime;
+                found_files.emplace(string_to_lower(file.filename), std::move(file));
+            }
+        } while (FindNextFileA(find_handle, &find_data));
+        FindClose(find_handle);
+    }
+
+    // Remove packfiles that were deleted or modified
+    // Note: deduplicated entries may point into removed packfiles so redirections are undone first
+    g_packfile_dedup.undo_all();
+    unsigned num_removed = 0;
+    for (auto it = g_packfiles.begin(); it != g_packfiles.end();) {
+        rf::VPackfile* packfile = it->get();
+        if (!packfile->is_user_maps || !string_starts_with_ignore_case(packfile->path, user_maps_dir)) {
+            ++it;
+            continue;
+        }
+        auto found_it = found_files.find(string_to_lower(packfile->filename));
+        if (found_it != found_files.end()) {
+            auto stamp_it = g_packfile_stamps.find(packfile);
+            bool is_modified = stamp_it != g_packfile_stamps.end() && stamp_it->second != found_it->second.stamp;
+            if (!is_modified) {
+                found_files.erase(found_it);
+                ++it;
+                continue;
+            }
+            if (!vpackfile_is_file_complete(packfile->path)) {
+                // Keep the old version until writing is finished
+                g_user_maps_rescan_pending = true;
+                found_files.erase(found_it);
+                ++it;
+                continue;
+            }
+        }
+        xlog::info("Removing packfile {}", packfile->path);
+        g_packfile_ext_indices.erase(packfile);
+        g_packfile_stamps.erase(packfile);
+        g_packfile_content_hashes.erase(packfile);
+        RetiredPackfile retired{std::move(*it), nullptr};
+        auto compressed_data_it = g_packfile_compressed_data.find(packfile);
+        if (compressed_data_it != g_packfile_compressed_data.end()) {
+            retired.compressed_data = std::move(compressed_data_it->second);
+            g_packfile_compressed_data.erase(compressed_data_it);
+        }
+        g_retired_packfiles.push_back(std::move(retired));
+        it = g_packfiles.erase(it);
+        ++num_removed;
+    }
+    if (num_removed > 0) {
+        vpackfile_rebuild_lookup_table();
+    }
+    for (auto& packfile : g_packfiles) {
+        auto hashes_it = g_packfile_content_hashes.find(packfile.get());
+        if (hashes_it != g_packfile_content_hashes.end()) {
+            g_packfile_dedup.add(*packfile, hashes_it->second);
+        }
+    }
+
+    // Add new and modified packfiles
+    // Note: they are marked as added after init so they can never override files from other packfiles
+    std::size_t old_num_packfiles = g_packfiles.size();
+    vpackfile_begin_batch();
+    rf::vpackfile_set_loading_user_maps(true);
+    for (auto& [name_lower, file] : found_files) {
+        if (!vpackfile_is_file_complete((user_maps_dir + file.filename).c_str())) {
+            g_user_maps_rescan_pending = true;
+            continue;
+        }
+        vpackfile_add_new(file.filename.c_str(), "user_maps\\multi\\");
+    }
+    rf::vpackfile_set_loading_user_maps(false);
+    vpackfile_end_batch();
+    std::size_t num_added = g_packfiles.size() - old_num_packfiles;
+
+    if (g_packfile_index.needs_save()) {
+        g_packfile_index.save(vpackfile_get_index_path());
+    }
+    if (num_added > 0 || num_removed > 0) {
+        xlog::info("User maps reloaded in {}ms: {} packfiles added, {} removed", GetTickCount() - start_ticks,
+            num_added, num_removed);
+    }
+}
+
+static void vpackfile_apply_verification_results()
+{
+    for (const auto& job : g_packfile_verifier.get_jobs()) {
+        if (job.checksum) {
+            g_packfile_index.set_checksum(job.path, job.stamp, job.checksum.value());
+            vpackfile_check_checksum(job.filename.c_str(), job.checksum.value(), job.expected_checksum);
+        }
+    }
+    xlog::info("Packfile verification finished{}", g_is_modded_game ? " (modded game detected)" : "");
+    if (g_packfile_index.needs_save()) {
+        g_packfile_index.save(vpackfile_get_index_path());
+    }
+}
+
+void vpackfile_do_frame()
+{
+    if (g_user_maps_change_notification != INVALID_HANDLE_VALUE &&
+        WaitForSingleObject(g_user_maps_change_notification, 0) == WAIT_OBJECT_0) {
+        // Packfiles are only replaced between levels, see vpackfile_reload_user_maps
+        g_user_maps_rescan_pending = true;
+        FindNextChangeNotification(g_user_maps_change_notification);
+    }
+    if (!g_verification_results_applied && g_packfile_verifier.is_started() && g_packfile_verifier.is_finished()) {
+        g_verification_results_applied = true;
+        vpackfile_apply_verification_results();
+    }
+}
+
+// Returns byte range that has to be read from disk to open the entry
+static VPackfilePrefetcher::Range vpackfile_get_entry_range(const rf::VPackfileEntry& entry)
+{
+    const rf::VPackfile* packfile = entry.parent;
+    if (packfile->is_compressed) {
+        std::size_t index = &entry - packfile->files.data();
+        const auto& info = g_packfile_compressed_data.at(packfile)->get_file_info(index);
+        if (info.compression != vpp::Compression::none) {
+            // File has not been decompressed yet so its compressed data is read from the packfile
+            return {packfile->path, info.offset, info.compressed_size};
+        }
+    }
+    return {packfile->path, static_cast<uint32_t>(entry.block * vpp::block_size), entry.size};
+}
+
+void vpackfile_level_load_begin(const char* level_filename)
+{
+    g_prefetch_profile_path = std::format("{}dashfaction_cache\\{}.prefetch", rf::root_path,
+        string_to_lower(level_filename));
+    g_prefetch_profile = VPackfilePrefetcher::load_profile(g_prefetch_profile_path);
+
+    // Files are prefetched in the order they were opened last time so the prefetcher stays ahead of the game
+    std::vector<VPackfilePrefetcher::Range> ranges;
+    ranges.reserve(g_prefetch_profile.size());
+    for (const auto& name : g_prefetch_profile) {
+        auto* entry = g_loopup_table.find(name);
+        if (entry && g_prefetch_range_indices.emplace(entry, ranges.size()).second) {
+            ranges.push_back(vpackfile_get_entry_range(*entry));
+        }
+    }
+    g_prefetcher.start(std::move(ranges));
+}
+
+void vpackfile_level_load_end(bool success)
+{
+    if (g_prefetch_profile_path.empty()) {
+        return;
+    }
+    g_prefetcher.stop();
+    xlog::info("Level files prefetched: {} hits, {} misses", g_num_prefetch_hits, g_num_prefetch_misses);
+
+    // Only a complete load gives a useful profile
+    if (success && !g_prefetch_recorded_names.empty() && g_prefetch_recorded_names != g_prefetch_profile) {
+        CreateDirectoryA(std::format("{}dashfaction_cache", rf::root_path).c_str(), nullptr);
+        VPackfilePrefetcher::save_profile(g_prefetch_profile_path, g_prefetch_recorded_names);
+    }
+
+    g_prefetch_profile_path.clear();
+    g_prefetch_profile.clear();
+    g_prefetch_range_indices.clear();
+    g_prefetch_recorded_names.clear();
+    g_prefetch_recorded_entries.clear();
+    g_num_prefetch_hits = 0;
+    g_num_prefetch_misses = 0;
 }
@@ -14,4 +14,10 @@ void vpackfile_apply_patches();
 GameLang get_installed_game_lang();
 bool is_modded_game();
 void vpackfile_find_matching_files(const StringMatcher& query, std::function<void(const char*)> result_consumer);
+void vpackfile_find_matching_files(std::string_view ext, const StringMatcher& query,
+    std::function<void(const char*)> result_consumer);
 void vpackfile_disable_overriding();
+void vpackfile_do_frame();
+void vpackfile_reload_user_maps();
+void vpackfile_level_load_begin(const char* level_filename);
+void vpackfile_level_load_end(bool success);
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <zlib.h>
+#include <xlog/xlog.h>
+#include "vpackfile_compressed.h"
+#include "../rf/file/file.h"
+
+VPackfileCompressedData::~VPackfileCompressedData()
+{
+    if (m_cache_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_cache_file);
+        // Note: deleting fails if the game still has the file opened - it is overwritten on next use anyway
+        DeleteFileA(m_cache_packfile->path);
+    }
+}
+
+void VPackfileCompressedData::remove_stale_cache_files()
+{
+    // Cache files of running processes are opened without delete sharing so deleting them fails
+    auto cache_dir = std::format("{}dashfaction_cache\\", rf::root_path);
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA((cache_dir + "*.vpp.*.tmp").c_str(), &find_data);
+    if (find_handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    unsigned num_removed = 0;
+    do {
+        if (DeleteFileA((cache_dir + find_data.cFileName).c_str())) {
+            ++num_removed;
+        }
+    } while (FindNextFileA(find_handle, &find_data));
+    FindClose(find_handle);
+    if (num_removed > 0) {
+        xlog::info("Removed {} stale packfile cache files", num_removed);
+    }
+}
+
+bool VPackfileCompressedData::load(const vpp::CompressionHeader& hdr, std::span<const vpp::FileInfo> files,
+    uint64_t packfile_size, std::span<const std::byte> seek_table)
+{
+    if (hdr.chunk_size == 0 || seek_table.size() < vpp::seek_table_size(files.size(), hdr.num_chunks)) {
+        return false;
+    }
+    m_chunk_size = hdr.chunk_size;
+    m_files.resize(files.size());
+    std::memcpy(m_files.data(), seek_table.data(), files.size() * sizeof(vpp::CompressedFileInfo));
+    m_chunk_ends.resize(hdr.num_chunks);
+    std::memcpy(m_chunk_ends.data(), seek_table.data() + files.size() * sizeof(vpp::CompressedFileInfo),
+        hdr.num_chunks * sizeof(uint32_t));
+
+    // Validate everything here so decompression does not need any bounds checks
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        const auto& info = m_files[i];
+        if (static_cast<uint64_t>(info.offset) + info.compressed_size > packfile_size) {
+            return false;
+        }
+        if (info.compression == vpp::Compression::none) {
+            if (info.compressed_size != files[i].size || info.offset % vpp::block_size != 0) {
+                return false;
+            }
+        }
+        else if (info.compression == vpp::Compression::zlib) {
+            std::size_t num_chunks = vpp::num_chunks(files[i].size, m_chunk_size);
+            if (info.first_chunk > m_chunk_ends.size() || m_chunk_ends.size() - info.first_chunk < num_chunks) {
+                return false;
+            }
+            uint32_t chunk_begin = 0;
+            for (std::size_t j = 0; j < num_chunks; ++j) {
+                uint32_t chunk_end = m_chunk_ends[info.first_chunk + j];
+                if (chunk_end < chunk_begin) {
+                    return false;
+                }
+                chunk_begin = chunk_end;
+            }
+            if (chunk_begin != info.compressed_size) {
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool VPackfileCompressedData::open_cache_file(const rf::VPackfile& packfile)
+{
+    auto cache_dir = std::format("{}dashfaction_cache", rf::root_path);
+    CreateDirectoryA(cache_dir.c_str(), nullptr);
+    // Process ID makes sure that a client and a server running from the same directory do not share the file
+    auto cache_path = std::format("{}\\{}.{}.tmp", cache_dir, packfile.filename, GetCurrentProcessId());
+    if (cache_path.size() >= sizeof(packfile.path)) {
+        xlog::error("Packfile cache path too long: {}", cache_path);
+        return false;
+    }
+    m_cache_file = CreateFileA(cache_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_ATTRIBUTE_TEMPORARY, nullptr);
+    if (m_cache_file == INVALID_HANDLE_VALUE) {
+        xlog::error("Failed to create packfile cache {} (error {})", cache_path, GetLastError());
+        return false;
+    }
+
+    // Entries redirected to the cache must behave like entries of the original packfile
+    m_cache_packfile = std::make_unique<rf::VPackfile>();
+    std::strcpy(m_cache_packfile->filename, packfile.filename);
+    std::strcpy(m_cache_packfile->path, cache_path.c_str());
+    m_cache_packfile->field_a0 = 0;
+    m_cache_packfile->num_files = 0;
+    m_cache_packfile->file_size = 0;
+    m_cache_packfile->is_user_maps = packfile.is_user_maps;
+    m_cache_packfile->is_added_after_init = packfile.is_added_after_init;
+    m_cache_packfile->is_compressed = false;
+    return true;
+}
+
+bool VPackfileCompressedData::decompress(std::size_t index, std::span<const std::byte> src,
+    std::span<std::byte> dst) const
+{
+    const auto& info = m_files[index];
+    std::size_t num_chunks = vpp::num_chunks(dst.size(), m_chunk_size);
+    uint32_t chunk_begin = 0;
+    for (std::size_t i = 0; i < num_chunks; ++i) {
+        uint32_t chunk_end = m_chunk_ends[info.first_chunk + i];
+        std::size_t dst_offset = i * m_chunk_size;
+        uLongf chunk_size = std::min<std::size_t>(m_chunk_size, dst.size() - dst_offset);
+        uLongf expected_chunk_size = chunk_size;
+        int ret = uncompress(reinterpret_cast<Bytef*>(dst.data() + dst_offset), &chunk_size,
+            reinterpret_cast<const Bytef*>(src.data() + chunk_begin), chunk_end - chunk_begin);
+        if (ret != Z_OK || chunk_size != expected_chunk_size) {
+            return false;
+        }
+        chunk_begin = chunk_end;
+    }
+    return true;
+}
+
+bool VPackfileCompressedData::decompress_entry(rf::VPackfileEntry& entry)
+{
+    const rf::VPackfile& packfile = *entry.parent;
+    std::size_t index = &entry - packfile.files.data();
+    const auto& info = m_files[index];
+    if (info.compression == vpp::Compression::none) {
+        // Uncompressed files are read from the packfile directly
+        return true;
+    }
+
+    if (m_cache_file == INVALID_HANDLE_VALUE && !open_cache_file(packfile)) {
+        return false;
+    }
+
+    std::ifstream file(packfile.path, std::ios_base::in | std::ios_base::binary);
+    std::vector<std::byte> src(info.compressed_size);
+    if (!file.seekg(info.offset) || !file.read(reinterpret_cast<char*>(src.data()), src.size())) {
+        xlog::error("Failed to read {} from packfile {}", entry.name, packfile.path);
+        return false;
+    }
+
+    // Pad data to a whole number of blocks so the next file starts at a block boundary
+    std::size_t num_blocks = vpp::num_blocks(entry.size);
+    std::vector<std::byte> dst(num_blocks * vpp::block_size);
+    if (!decompress(index, src, {dst.data(), entry.size})) {
+        xlog::error("Failed to decompress {} from packfile {}", entry.name, packfile.path);
+        return false;
+    }
+
+    DWORD bytes_written = 0;
+    if (!WriteFile(m_cache_file, dst.data(), dst.size(), &bytes_written, nullptr) || bytes_written != dst.size()) {
+        xlog::error("Failed to write packfile cache {} (error {})", m_cache_packfile->path, GetLastError());
+        // Make sure file position stays block aligned
+        SetFilePointer(m_cache_file, m_cache_num_blocks * vpp::block_size, nullptr, FILE_BEGIN);
+        SetEndOfFile(m_cache_file);
+        return false;
+    }
+
+    xlog::trace("Decompressed {} from packfile {}", entry.name, packfile.path);
+    entry.block = m_cache_num_blocks;
+    entry.parent = m_cache_packfile.get();
+    m_cache_num_blocks += num_blocks;
+    ++m_num_decompressed_files;
+    return true;
+}
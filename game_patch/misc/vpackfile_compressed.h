@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+#include <windows.h>
+#include "vpackfile_format.h"
+#include "../rf/file/packfile.h"
+
+// Seek table of a compressed (version 2) packfile
+// Stock file reading code only understands uncompressed data so compressed files are decompressed into a cache file
+// when they are opened for the first time and their entries are redirected to it
+class VPackfileCompressedData
+{
+public:
+    VPackfileCompressedData() = default;
+    VPackfileCompressedData(const VPackfileCompressedData&) = delete;
+    VPackfileCompressedData& operator=(const VPackfileCompressedData&) = delete;
+    ~VPackfileCompressedData();
+
+    // Removes cache files left by processes that did not exit cleanly
+    static void remove_stale_cache_files();
+
+    bool load(const vpp::CompressionHeader& hdr, std::span<const vpp::FileInfo> files, uint64_t packfile_size,
+        std::span<const std::byte> seek_table);
+    // Note: entry must belong to the packfile this seek table was loaded from
+    bool decompress_entry(rf::VPackfileEntry& entry);
+
+    [[nodiscard]] const vpp::CompressedFileInfo& get_file_info(std::size_t index) const
+    {
+        return m_files[index];
+    }
+
+    // Returns packfile that decompressed entries are redirected to (null if nothing was decompressed yet)
+    [[nodiscard]] const rf::VPackfile* get_cache_packfile() const
+    {
+        return m_cache_packfile.get();
+    }
+
+    [[nodiscard]] unsigned get_num_decompressed_files() const
+    {
+        return m_num_decompressed_files;
+    }
+
+private:
+    uint32_t m_chunk_size = 0;
+    std::vector<vpp::CompressedFileInfo> m_files;
+    std::vector<uint32_t> m_chunk_ends;
+    std::unique_ptr<rf::VPackfile> m_cache_packfile;
+    HANDLE m_cache_file = INVALID_HANDLE_VALUE;
+    uint32_t m_cache_num_blocks = 0;
+    unsigned m_num_decompressed_files = 0;
+
+    bool open_cache_file(const rf::VPackfile& packfile);
+    bool decompress(std::size_t index, std::span<const std::byte> src, std::span<std::byte> dst) const;
+};
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <xlog/xlog.h>
+#include "vpackfile_dedup.h"
+#include "vpackfile_format.h"
+#include "../rf/file/packfile.h"
+
+static bool vpackfile_entries_equal(const rf::VPackfileEntry& entry1, const rf::VPackfileEntry& entry2)
+{
+    std::ifstream file1(entry1.parent->path, std::ios_base::in | std::ios_base::binary);
+    std::ifstream file2(entry2.parent->path, std::ios_base::in | std::ios_base::binary);
+    file1.seekg(static_cast<std::streamoff>(entry1.block) * vpp::block_size);
+    file2.seekg(static_cast<std::streamoff>(entry2.block) * vpp::block_size);
+    std::array<char, 0x10000> buf1;
+    std::array<char, 0x10000> buf2;
+    std::size_t left = entry1.size;
+    while (left > 0) {
+        std::size_t n = std::min(left, buf1.size());
+        if (!file1.read(buf1.data(), n) || !file2.read(buf2.data(), n)) {
+            return false;
+        }
+        if (std::memcmp(buf1.data(), buf2.data(), n) != 0) {
+            return false;
+        }
+        left -= n;
+    }
+    return true;
+}
+
+void VPackfileDedup::add(rf::VPackfile& packfile, std::span<const uint64_t> content_hashes)
+{
+    if (packfile.is_compressed || content_hashes.size() != packfile.files.size()) {
+        return;
+    }
+    for (std::size_t i = 0; i < packfile.files.size(); ++i) {
+        rf::VPackfileEntry& entry = packfile.files[i];
+        // Empty files have nothing to share
+        if (entry.size == 0) {
+            continue;
+        }
+        auto [it, inserted] = m_unique_entries.try_emplace({content_hashes[i], entry.size}, &entry);
+        if (!inserted) {
+            const rf::VPackfileEntry& unique_entry = *it->second;
+            // Hash and size only make a match likely - make sure a different file is never served instead
+            if (!vpackfile_entries_equal(entry, unique_entry)) {
+                xlog::warn("Files {} and {} have the same content hash but different contents", entry.name,
+                    unique_entry.name);
+                continue;
+            }
+            m_redirects.emplace(&entry, Redirect{entry.parent, entry.block});
+            entry.parent = unique_entry.parent;
+            entry.block = unique_entry.block;
+            m_shared_bytes += entry.size;
+        }
+    }
+}
+
+void VPackfileDedup::undo_all()
+{
+    for (auto& [entry, redirect] : m_redirects) {
+        entry->parent = redirect.owner;
+        entry->block = redirect.block;
+    }
+    m_redirects.clear();
+    m_unique_entries.clear();
+    m_shared_bytes = 0;
+}
+
+const rf::VPackfile* VPackfileDedup::get_owner(const rf::VPackfileEntry& entry) const
+{
+    auto it = m_redirects.find(const_cast<rf::VPackfileEntry*>(&entry));
+    if (it == m_redirects.end()) {
+        return nullptr;
+    }
+    return it->second.owner;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+
+namespace rf
+{
+    struct VPackfile;
+    struct VPackfileEntry;
+}
+
+// Points packfile entries with identical contents to a single copy so it is read from disk and kept in the OS page
+// cache only once
+// Note: only entries of uncompressed packfiles can be redirected because stock code reads them by block number
+class VPackfileDedup
+{
+public:
+    // Redirects entries of the packfile to identical entries of packfiles added earlier
+    void add(rf::VPackfile& packfile, std::span<const uint64_t> content_hashes);
+    // Points all redirected entries back to their own packfiles
+    void undo_all();
+
+    // Returns packfile that entry belongs to if it was redirected to data in another packfile
+    [[nodiscard]] const rf::VPackfile* get_owner(const rf::VPackfileEntry& entry) const;
+
+    [[nodiscard]] unsigned get_num_shared_entries() const
+    {
+        return m_redirects.size();
+    }
+
+    [[nodiscard]] uint64_t get_shared_bytes() const
+    {
+        return m_shared_bytes;
+    }
+
+private:
+    struct ContentKey
+    {
+        uint64_t hash;
+        uint32_t size;
+
+        bool operator==(const ContentKey& other) const = default;
+    };
+
+    struct ContentKeyHash
+    {
+        std::size_t operator()(const ContentKey& key) const
+        {
+            return static_cast<std::size_t>(key.hash ^ (key.hash >> 32));
+        }
+    };
+
+    struct Redirect
+    {
+        rf::VPackfile* owner;
+        uint32_t block;
+    };
+
+    std::unordered_map<ContentKey, const rf::VPackfileEntry*, ContentKeyHash> m_unique_entries;
+    std::unordered_map<rf::VPackfileEntry*, Redirect> m_redirects;
+    uint64_t m_shared_bytes = 0;
+};
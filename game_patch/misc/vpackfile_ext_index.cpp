@@ -0,0 +1,27 @@
+#include <algorithm>
+#include <patch_common/MemUtils.h>
+#include "vpackfile_ext_index.h"
+#include "../rf/file/packfile.h"
+
+void VPackfileExtIndex::build(const rf::VPackfile& packfile)
+{
+    std::vector<std::string> exts;
+    exts.reserve(packfile.files.size());
+    m_entries.resize(packfile.files.size());
+    for (uint32_t i = 0; i < m_entries.size(); ++i) {
+        exts.push_back(string_to_lower(get_ext_from_filename(packfile.files[i].name)));
+        m_entries[i] = i;
+    }
+    std::sort(m_entries.begin(), m_entries.end(), [&](uint32_t a, uint32_t b) {
+        return exts[a] != exts[b] ? exts[a] < exts[b] : a < b;
+    });
+
+    m_groups.clear();
+    for (uint32_t i = 0; i < m_entries.size(); ++i) {
+        const auto& ext = exts[m_entries[i]];
+        if (m_groups.empty() || m_groups.back().ext != ext) {
+            m_groups.push_back({ext, i, i});
+        }
+        m_groups.back().end = i + 1;
+    }
+}
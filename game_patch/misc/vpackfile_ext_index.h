@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <common/utils/string-utils.h>
+
+namespace rf
+{
+    struct VPackfile;
+}
+
+// Secondary index of packfile entries grouped by lowercase extension
+// Queries do not allocate memory and return entries in packfile directory order
+class VPackfileExtIndex
+{
+public:
+    static constexpr std::size_t max_query_exts = 16;
+
+    void build(const rf::VPackfile& packfile);
+
+    // Calls fun with index of each entry that has one of provided extensions (case-insensitive)
+    template<typename F>
+    void for_each_matching(std::span<const std::string_view> exts, F fun) const
+    {
+        std::array<std::span<const uint32_t>, max_query_exts> ranges;
+        std::size_t num_ranges = 0;
+        for (auto ext : exts) {
+            auto range = find_ext(ext);
+            if (range.empty()) {
+                continue;
+            }
+            bool duplicate = std::find_if(ranges.begin(), ranges.begin() + num_ranges, [&](auto& r) {
+                return r.data() == range.data();
+            }) != ranges.begin() + num_ranges;
+            if (!duplicate) {
+                if (num_ranges == max_query_exts) {
+                    // Too many extensions to merge at once - process remaining ranges separately
+                    merge_ranges({ranges.data(), num_ranges}, fun);
+                    num_ranges = 0;
+                }
+                ranges[num_ranges++] = range;
+            }
+        }
+        merge_ranges({ranges.data(), num_ranges}, fun);
+    }
+
+private:
+    struct ExtGroup
+    {
+        std::string ext;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    // Entry indices sorted by extension and then by index
+    std::vector<uint32_t> m_entries;
+    std::vector<ExtGroup> m_groups;
+
+    [[nodiscard]] std::span<const uint32_t> find_ext(std::string_view ext) const
+    {
+        for (const auto& group : m_groups) {
+            if (string_equals_ignore_case(group.ext, ext)) {
+                return {m_entries.data() + group.begin, m_entries.data() + group.end};
+            }
+        }
+        return {};
+    }
+
+    // Merges sorted index ranges so entries are visited in directory order
+    template<typename F>
+    static void merge_ranges(std::span<std::span<const uint32_t>> ranges, F& fun)
+    {
+        while (true) {
+            std::span<const uint32_t>* min_range = nullptr;
+            for (auto& range : ranges) {
+                if (!range.empty() && (!min_range || range.front() < min_range->front())) {
+                    min_range = &range;
+                }
+            }
+            if (!min_range) {
+                break;
+            }
+            fun(min_range->front());
+            *min_range = min_range->subspan(1);
+        }
+    }
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// VPP packfile on-disk format
+// Note: this header must not depend on Win32 or RF code so it can be reused outside of the game process
+namespace vpp
+{
+    constexpr uint32_t sig = 0x51890ACE;
+    constexpr std::size_t block_size = 0x800;
+    constexpr std::size_t entries_per_block = 32;
+    // Version 2 packfiles store files compressed in independent chunks described by a seek table
+    constexpr uint32_t compressed_version = 2;
+    constexpr uint32_t default_chunk_size = 0x10000;
+
+    struct Header
+    {
+        uint32_t sig;
+        uint32_t version;
+        uint32_t num_files;
+        uint32_t total_size;
+    };
+
+    struct FileInfo
+    {
+        char name[60];
+        uint32_t size;
+    };
+    static_assert(sizeof(FileInfo) * entries_per_block == block_size);
+
+    // Follows Header in the first block of version 2 packfiles
+    // Note: FileInfo::size in the directory is always the uncompressed size
+    struct CompressionHeader
+    {
+        uint32_t chunk_size;
+        uint32_t num_chunks;
+    };
+
+    enum class Compression : uint32_t
+    {
+        none = 0,
+        zlib = 1,
+    };
+
+    // Seek table starts in the block after the directory and contains CompressedFileInfo for every file followed by
+    // uint32_t end offset (relative to the file offset) of every chunk
+    struct CompressedFileInfo
+    {
+        // offset of file data from the beginning of the packfile (block aligned for uncompressed files)
+        uint32_t offset;
+        uint32_t compressed_size;
+        Compression compression;
+        // index of the first chunk of this file in the seek table (unused for uncompressed files)
+        uint32_t first_chunk;
+    };
+
+    inline std::size_t num_blocks(std::size_t num_bytes)
+    {
+        return (num_bytes + block_size - 1) / block_size;
+    }
+
+    inline std::size_t num_directory_blocks(std::size_t num_files)
+    {
+        return (num_files + entries_per_block - 1) / entries_per_block;
+    }
+
+    // Returns pointer to the header if buffer contains a valid VPP header
+    inline const Header* parse_header(std::span<const std::byte> data)
+    {
+        if (data.size() < block_size) {
+            return nullptr;
+        }
+        const auto* hdr = reinterpret_cast<const Header*>(data.data());
+        if (hdr->sig != sig || hdr->version < 1) {
+            return nullptr;
+        }
+        return hdr;
+    }
+
+    // Returns directory records stored in the provided buffer (empty span if buffer is truncated)
+    inline std::span<const FileInfo> get_directory(std::span<const std::byte> data, const Header& hdr)
+    {
+        std::size_t dir_end = (1 + num_directory_blocks(hdr.num_files)) * block_size;
+        if (data.size() < dir_end) {
+            return {};
+        }
+        const auto* records = reinterpret_cast<const FileInfo*>(data.data() + block_size);
+        return {records, hdr.num_files};
+    }
+
+    inline std::size_t num_chunks(std::size_t file_size, std::size_t chunk_size)
+    {
+        return (file_size + chunk_size - 1) / chunk_size;
+    }
+
+    inline std::size_t seek_table_offset(std::size_t num_files)
+    {
+        return (1 + num_directory_blocks(num_files)) * block_size;
+    }
+
+    inline std::size_t seek_table_size(std::size_t num_files, std::size_t num_chunks)
+    {
+        return num_files * sizeof(CompressedFileInfo) + num_chunks * sizeof(uint32_t);
+    }
+
+    // Returns compression header if the provided header block belongs to a version 2 packfile
+    inline const CompressionHeader* get_compression_header(std::span<const std::byte> header_block)
+    {
+        if (header_block.size() < sizeof(Header) + sizeof(CompressionHeader)) {
+            return nullptr;
+        }
+        const auto* hdr = reinterpret_cast<const Header*>(header_block.data());
+        if (hdr->version != compressed_version) {
+            return nullptr;
+        }
+        return reinterpret_cast<const CompressionHeader*>(header_block.data() + sizeof(Header));
+    }
+
+    // Names are stored in fixed size fields and are not guaranteed to be zero terminated
+    inline bool is_name_terminated(const FileInfo& info)
+    {
+        return std::memchr(info.name, 0, sizeof(info.name)) != nullptr;
+    }
+
+    // Returns view of file contents that starts at the given block (empty span if it is out of bounds)
+    inline std::span<const std::byte> get_file_data(std::span<const std::byte> data, std::size_t block, std::size_t size)
+    {
+        std::size_t offset = block * block_size;
+        if (offset > data.size() || data.size() - offset < size) {
+            return {};
+        }
+        return data.subspan(offset, size);
+    }
+}
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <xlog/xlog.h>
+#include <xxhash.h>
+#include <common/utils/string-utils.h>
+#include "vpackfile_index.h"
+
+namespace
+{
+    constexpr uint32_t index_sig = 0x49564644; // DFVI
+    constexpr uint32_t index_version = 3;
+
+    struct IndexHeader
+    {
+        uint32_t sig;
+        uint32_t version;
+        uint32_t num_packfiles;
+        uint32_t body_checksum;
+    };
+
+    // Followed by padded path, num_files records and num_files content hashes (if index_flag_has_content_hashes
+    // is set)
+    struct IndexPackfileHeader
+    {
+        uint64_t file_size;
+        uint64_t mtime;
+        uint32_t total_size;
+        uint32_t num_files;
+        uint32_t path_len;
+        uint32_t flags;
+        uint32_t checksum;
+        uint32_t padding;
+    };
+
+    constexpr uint32_t index_flag_has_checksum = 1;
+    constexpr uint32_t index_flag_has_content_hashes = 2;
+
+    uint32_t align_path_len(uint32_t len)
+    {
+        return (len + 7) & ~7u;
+    }
+}
+
+bool VPackfileIndex::load(const std::string& filename)
+{
+    clear();
+
+    std::ifstream file(filename, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+    if (!file) {
+        // Missing index is not an error - it will be created
+        m_dirty = true;
+        return false;
+    }
+    auto file_size = static_cast<std::size_t>(file.tellg());
+    file.seekg(0);
+    m_data.resize(file_size);
+    if (file_size < sizeof(IndexHeader) || !file.read(reinterpret_cast<char*>(m_data.data()), file_size)) {
+        xlog::warn("Failed to read packfile index {}", filename);
+        clear();
+        return false;
+    }
+
+    IndexHeader hdr;
+    std::memcpy(&hdr, m_data.data(), sizeof(hdr));
+    const std::byte* body = m_data.data() + sizeof(hdr);
+    std::size_t body_size = file_size - sizeof(hdr);
+    if (hdr.sig != index_sig || hdr.version != index_version ||
+        XXH32(body, body_size, 0) != hdr.body_checksum) {
+        xlog::warn("Packfile index {} is invalid or outdated", filename);
+        clear();
+        return false;
+    }
+
+    std::size_t offset = 0;
+    for (unsigned i = 0; i < hdr.num_packfiles; ++i) {
+        IndexPackfileHeader pf_hdr;
+        if (body_size - offset < sizeof(pf_hdr)) {
+            break;
+        }
+        std::memcpy(&pf_hdr, body + offset, sizeof(pf_hdr));
+        offset += sizeof(pf_hdr);
+        std::size_t records_size = pf_hdr.num_files * sizeof(vpp::FileInfo);
+        if (pf_hdr.flags & index_flag_has_content_hashes) {
+            records_size += pf_hdr.num_files * sizeof(uint64_t);
+        }
+        if (body_size - offset < align_path_len(pf_hdr.path_len) + records_size) {
+            break;
+        }
+        std::string path{reinterpret_cast<const char*>(body + offset), pf_hdr.path_len};
+        offset += align_path_len(pf_hdr.path_len);
+        Entry& entry = m_entries[path];
+        entry.stamp = {pf_hdr.file_size, pf_hdr.mtime};
+        entry.dir.total_size = pf_hdr.total_size;
+        entry.dir.files = {reinterpret_cast<const vpp::FileInfo*>(body + offset), pf_hdr.num_files};
+        if (pf_hdr.flags & index_flag_has_checksum) {
+            entry.checksum = {pf_hdr.checksum};
+        }
+        if (pf_hdr.flags & index_flag_has_content_hashes) {
+            const std::byte* hashes = body + offset + pf_hdr.num_files * sizeof(vpp::FileInfo);
+            entry.dir.content_hashes = {reinterpret_cast<const uint64_t*>(hashes), pf_hdr.num_files};
+        }
+        offset += records_size;
+    }
+    if (m_entries.size() != hdr.num_packfiles) {
+        xlog::warn("Packfile index {} is truncated", filename);
+        clear();
+        return false;
+    }
+    xlog::info("Loaded packfile index: {} packfiles", m_entries.size());
+    return true;
+}
+
+bool VPackfileIndex::save(const std::string& filename)
+{
+    std::vector<std::byte> body;
+    uint32_t num_packfiles = 0;
+    auto append = [&body](const void* data, std::size_t size) {
+        const auto* bytes = static_cast<const std::byte*>(data);
+        body.insert(body.end(), bytes, bytes + size);
+    };
+    for (const auto& [path, entry] : m_entries) {
+        // Skip packfiles that were not loaded in this session - they were probably deleted
+        if (!entry.used) {
+            continue;
+        }
+        IndexPackfileHeader pf_hdr{};
+        pf_hdr.file_size = entry.stamp.file_size;
+        pf_hdr.mtime = entry.stamp.mtime;
+        pf_hdr.total_size = entry.dir.total_size;
+        pf_hdr.num_files = entry.dir.files.size();
+        pf_hdr.path_len = path.size();
+        if (entry.checksum) {
+            pf_hdr.flags |= index_flag_has_checksum;
+            pf_hdr.checksum = entry.checksum.value();
+        }
+        if (!entry.dir.content_hashes.empty()) {
+            pf_hdr.flags |= index_flag_has_content_hashes;
+        }
+        append(&pf_hdr, sizeof(pf_hdr));
+        append(path.data(), path.size());
+        body.resize(body.size() + align_path_len(pf_hdr.path_len) - pf_hdr.path_len);
+        append(entry.dir.files.data(), entry.dir.files.size_bytes());
+        append(entry.dir.content_hashes.data(), entry.dir.content_hashes.size_bytes());
+        ++num_packfiles;
+    }
+
+    IndexHeader hdr{};
+    hdr.sig = index_sig;
+    hdr.version = index_version;
+    hdr.num_packfiles = num_packfiles;
+    hdr.body_checksum = XXH32(body.data(), body.size(), 0);
+
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    file.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    file.write(reinterpret_cast<const char*>(body.data()), body.size());
+    if (!file) {
+        xlog::warn("Failed to write packfile index {}", filename);
+        return false;
+    }
+    xlog::info("Saved packfile index: {} packfiles", num_packfiles);
+    m_dirty = false;
+    return true;
+}
+
+const VPackfileIndex::Directory* VPackfileIndex::find(std::string_view path, const VPackfileStamp& stamp)
+{
+    auto it = m_entries.find(string_to_lower(path));
+    if (it == m_entries.end() || it->second.stamp != stamp) {
+        return nullptr;
+    }
+    it->second.used = true;
+    ++m_num_hits;
+    return &it->second.dir;
+}
+
+void VPackfileIndex::add(std::string_view path, const VPackfileStamp& stamp, uint32_t total_size,
+    std::vector<vpp::FileInfo>&& files)
+{
+    auto& owned_files = m_owned_files.emplace_back(std::move(files));
+    Entry& entry = m_entries[string_to_lower(path)];
+    entry.stamp = stamp;
+    entry.dir.total_size = total_size;
+    entry.dir.files = owned_files;
+    entry.dir.content_hashes = {};
+    entry.checksum.reset();
+    entry.used = true;
+    m_dirty = true;
+}
+
+std::optional<uint32_t> VPackfileIndex::get_checksum(std::string_view path, const VPackfileStamp& stamp) const
+{
+    auto it = m_entries.find(string_to_lower(path));
+    if (it == m_entries.end() || it->second.stamp != stamp) {
+        return {};
+    }
+    return it->second.checksum;
+}
+
+void VPackfileIndex::set_checksum(std::string_view path, const VPackfileStamp& stamp, uint32_t checksum)
+{
+    auto it = m_entries.find(string_to_lower(path));
+    if (it != m_entries.end() && it->second.stamp == stamp) {
+        it->second.checksum = {checksum};
+        m_dirty = true;
+    }
+}
+
+void VPackfileIndex::set_content_hashes(std::string_view path, const VPackfileStamp& stamp,
+    std::vector<uint64_t>&& hashes)
+{
+    auto it = m_entries.find(string_to_lower(path));
+    if (it != m_entries.end() && it->second.stamp == stamp && hashes.size() == it->second.dir.files.size()) {
+        it->second.dir.content_hashes = m_owned_content_hashes.emplace_back(std::move(hashes));
+        m_dirty = true;
+    }
+}
+
+bool VPackfileIndex::needs_save() const
+{
+    if (m_dirty) {
+        return true;
+    }
+    return std::any_of(m_entries.begin(), m_entries.end(), [](const auto& p) { return !p.second.used; });
+}
+
+void VPackfileIndex::clear()
+{
+    m_entries.clear();
+    m_owned_files.clear();
+    m_owned_content_hashes.clear();
+    m_data.clear();
+    m_data.shrink_to_fit();
+    m_num_hits = 0;
+    m_dirty = false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "vpackfile_format.h"
+
+// Identifies packfile contents without reading it
+struct VPackfileStamp
+{
+    uint64_t file_size = 0;
+    uint64_t mtime = 0;
+
+    bool operator==(const VPackfileStamp& other) const = default;
+};
+
+// Persistent cache of packfile directories used to skip parsing of unchanged packfiles at startup
+class VPackfileIndex
+{
+public:
+    struct Directory
+    {
+        uint32_t total_size = 0;
+        std::span<const vpp::FileInfo> files;
+        // hashes of file contents (empty if they were never computed)
+        std::span<const uint64_t> content_hashes;
+    };
+
+    bool load(const std::string& filename);
+    bool save(const std::string& filename);
+
+    // Returns directory of packfile if it has not changed since it was indexed
+    // Note: returned records stay valid until index is cleared
+    const Directory* find(std::string_view path, const VPackfileStamp& stamp);
+    void add(std::string_view path, const VPackfileStamp& stamp, uint32_t total_size,
+        std::vector<vpp::FileInfo>&& files);
+    void clear();
+
+    // Checksums of whole packfiles are cached together with directories
+    [[nodiscard]] std::optional<uint32_t> get_checksum(std::string_view path, const VPackfileStamp& stamp) const;
+    void set_checksum(std::string_view path, const VPackfileStamp& stamp, uint32_t checksum);
+    void set_content_hashes(std::string_view path, const VPackfileStamp& stamp, std::vector<uint64_t>&& hashes);
+
+    [[nodiscard]] bool needs_save() const;
+
+    [[nodiscard]] unsigned num_hits() const
+    {
+        return m_num_hits;
+    }
+
+private:
+    struct Entry
+    {
+        VPackfileStamp stamp;
+        Directory dir;
+        std::optional<uint32_t> checksum;
+        bool used = false;
+    };
+
+    std::vector<std::byte> m_data;
+    std::deque<std::vector<vpp::FileInfo>> m_owned_files;
+    std::deque<std::vector<uint64_t>> m_owned_content_hashes;
+    std::unordered_map<std::string, Entry> m_entries;
+    unsigned m_num_hits = 0;
+    bool m_dirty = false;
+};
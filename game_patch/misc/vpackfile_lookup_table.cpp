@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <bit>
+#include <patch_common/MemUtils.h>
+#include "vpackfile_lookup_table.h"
+#include "../rf/file/packfile.h"
+
+static bool vpackfile_name_equals(const char* entry_name, std::string_view name)
+{
+    for (char ch : name) {
+        if (*entry_name == '\0' || vpackfile_name_char_to_lower(*entry_name) != vpackfile_name_char_to_lower(ch)) {
+            return false;
+        }
+        ++entry_name;
+    }
+    return *entry_name == '\0';
+}
+
+void VPackfileLookupTable::reserve(std::size_t num_entries)
+{
+    // Keep load factor below 0.5 so probe sequences stay short
+    std::size_t capacity = std::bit_ceil(num_entries * 2);
+    if (capacity > m_slots.size()) {
+        rehash(capacity);
+    }
+}
+
+std::pair<VPackfileLookupTable::Slot*, bool> VPackfileLookupTable::insert(rf::VPackfileEntry* entry, uint32_t name_hash)
+{
+    if ((m_size + 1) * 2 > m_slots.size()) {
+        rehash(std::max<std::size_t>(m_slots.size() * 2, 64));
+    }
+    Slot& slot = m_slots[find_slot(name_hash, entry->name)];
+    if (slot.entry) {
+        return {&slot, false};
+    }
+    slot.hash = name_hash;
+    slot.entry = entry;
+    ++m_size;
+    return {&slot, true};
+}
+
+rf::VPackfileEntry* VPackfileLookupTable::find(std::string_view name) const
+{
+    if (m_slots.empty()) {
+        return nullptr;
+    }
+    return m_slots[find_slot(vpackfile_hash_name(name), name)].entry;
+}
+
+void VPackfileLookupTable::clear()
+{
+    m_slots.clear();
+    m_size = 0;
+}
+
+std::size_t VPackfileLookupTable::find_slot(uint32_t hash, std::string_view name) const
+{
+    std::size_t mask = m_slots.size() - 1;
+    std::size_t index = hash & mask;
+    while (true) {
+        const Slot& slot = m_slots[index];
+        if (!slot.entry || (slot.hash == hash && vpackfile_name_equals(slot.entry->name, name))) {
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+void VPackfileLookupTable::rehash(std::size_t new_capacity)
+{
+    std::vector<Slot> old_slots = std::move(m_slots);
+    m_slots.assign(new_capacity, Slot{0, nullptr});
+    std::size_t mask = new_capacity - 1;
+    for (const Slot& slot : old_slots) {
+        if (slot.entry) {
+            std::size_t index = slot.hash & mask;
+            while (m_slots[index].entry) {
+                index = (index + 1) & mask;
+            }
+            m_slots[index] = slot;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rf
+{
+    struct VPackfileEntry;
+}
+
+inline char vpackfile_name_char_to_lower(char ch)
+{
+    return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+// Case-insensitive FNV-1a hash of a file name
+inline uint32_t vpackfile_hash_name(std::string_view name)
+{
+    uint32_t hash = 2166136261u;
+    for (char ch : name) {
+        hash ^= static_cast<unsigned char>(vpackfile_name_char_to_lower(ch));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Open-addressing (linear probing) hash table mapping file names to packfile entries
+// Lookups do not allocate memory. Entry names are not copied so they must outlive the table.
+class VPackfileLookupTable
+{
+public:
+    struct Slot
+    {
+        uint32_t hash;
+        rf::VPackfileEntry* entry;
+    };
+
+    void reserve(std::size_t num_entries);
+    // Returns slot with entry of the same name (inserted = false) or slot of newly inserted entry (inserted = true)
+    std::pair<Slot*, bool> insert(rf::VPackfileEntry* entry, uint32_t name_hash);
+    [[nodiscard]] rf::VPackfileEntry* find(std::string_view name) const;
+    void clear();
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return m_size;
+    }
+
+    template<typename F>
+    void for_each(F fun) const
+    {
+        for (const auto& slot : m_slots) {
+            if (slot.entry) {
+                fun(slot.entry);
+            }
+        }
+    }
+
+private:
+    std::vector<Slot> m_slots;
+    std::size_t m_size = 0;
+
+    [[nodiscard]] std::size_t find_slot(uint32_t hash, std::string_view name) const;
+    void rehash(std::size_t new_capacity);
+};
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <windows.h>
+#include <xlog/xlog.h>
+#include "vpackfile_prefetcher.h"
+
+// Only used to pull data into the page cache so it can be small
+constexpr std::size_t prefetch_buffer_size = 256 * 1024;
+
+VPackfilePrefetcher::~VPackfilePrefetcher()
+{
+    stop();
+}
+
+void VPackfilePrefetcher::start(std::vector<Range>&& ranges)
+{
+    stop();
+    m_ranges = std::move(ranges);
+    m_num_finished_ranges = 0;
+    m_abort = false;
+    if (!m_ranges.empty()) {
+        m_thread = std::thread{&VPackfilePrefetcher::thread_proc, this};
+    }
+}
+
+void VPackfilePrefetcher::stop()
+{
+    if (m_thread.joinable()) {
+        m_abort = true;
+        m_thread.join();
+    }
+    m_ranges.clear();
+    m_num_finished_ranges = 0;
+}
+
+void VPackfilePrefetcher::thread_proc()
+{
+    auto buf = std::make_unique<std::byte[]>(prefetch_buffer_size);
+    HANDLE file = INVALID_HANDLE_VALUE;
+    const std::string* file_path = nullptr;
+    for (const auto& range : m_ranges) {
+        if (m_abort) {
+            break;
+        }
+        // Ranges from one packfile are usually next to each other so keep the last file opened
+        if (!file_path || *file_path != range.path) {
+            if (file != INVALID_HANDLE_VALUE) {
+                CloseHandle(file);
+            }
+            file = CreateFileA(range.path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            file_path = &range.path;
+        }
+        if (file != INVALID_HANDLE_VALUE && SetFilePointer(file, range.offset, nullptr, FILE_BEGIN) == range.offset) {
+            std::size_t remaining = range.size;
+            while (remaining > 0 && !m_abort) {
+                DWORD num_read = 0;
+                DWORD num_to_read = std::min(remaining, prefetch_buffer_size);
+                if (!ReadFile(file, buf.get(), num_to_read, &num_read, nullptr) || num_read == 0) {
+                    break;
+                }
+                remaining -= num_read;
+            }
+        }
+        m_num_finished_ranges.fetch_add(1, std::memory_order_release);
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+}
+
+std::vector<std::string> VPackfilePrefetcher::load_profile(const std::string& filename)
+{
+    std::vector<std::string> names;
+    std::ifstream file(filename);
+    std::string name;
+    while (std::getline(file, name)) {
+        if (!name.empty()) {
+            names.push_back(std::move(name));
+        }
+    }
+    return names;
+}
+
+void VPackfilePrefetcher::save_profile(const std::string& filename, const std::vector<std::string>& names)
+{
+    std::ofstream file(filename);
+    for (const auto& name : names) {
+        file << name << '\n';
+    }
+    if (!file) {
+        xlog::warn("Failed to save packfile prefetch profile {}", filename);
+    }
+}
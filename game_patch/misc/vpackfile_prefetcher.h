@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads byte ranges of packfiles on a background thread so they are already in the OS page cache when the game
+// opens them during level loading
+class VPackfilePrefetcher
+{
+public:
+    struct Range
+    {
+        std::string path;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    VPackfilePrefetcher() = default;
+    VPackfilePrefetcher(const VPackfilePrefetcher&) = delete;
+    VPackfilePrefetcher& operator=(const VPackfilePrefetcher&) = delete;
+    ~VPackfilePrefetcher();
+
+    void start(std::vector<Range>&& ranges);
+    void stop();
+
+    // Returns true if range with the provided index has already been read
+    [[nodiscard]] bool is_prefetched(std::size_t index) const
+    {
+        return index < m_num_finished_ranges.load(std::memory_order_acquire);
+    }
+
+    // Profile is a list of file names in the order they were opened when the level was loaded last time
+    static std::vector<std::string> load_profile(const std::string& filename);
+    static void save_profile(const std::string& filename, const std::vector<std::string>& names);
+
+private:
+    std::vector<Range> m_ranges;
+    std::thread m_thread;
+    std::atomic<std::size_t> m_num_finished_ranges{0};
+    std::atomic<bool> m_abort{false};
+
+    void thread_proc();
+};
@@ -0,0 +1,84 @@
+#include <memory>
+#include <windows.h>
+#include <xlog/xlog.h>
+#include <xxhash.h>
+#include "vpackfile_verifier.h"
+
+// Big reads keep the number of syscalls low and let the OS read ahead
+constexpr std::size_t hash_buffer_size = 1024 * 1024;
+
+VPackfileVerifier::~VPackfileVerifier()
+{
+    stop();
+}
+
+void VPackfileVerifier::add_job(std::string path, std::string filename, const VPackfileStamp& stamp,
+    uint32_t expected_checksum)
+{
+    m_bytes_total += stamp.file_size;
+    m_jobs.push_back({std::move(path), std::move(filename), stamp, expected_checksum, {}});
+}
+
+void VPackfileVerifier::start()
+{
+    m_started = true;
+    if (!m_jobs.empty() && !m_thread.joinable()) {
+        m_thread = std::thread{&VPackfileVerifier::thread_proc, this};
+    }
+}
+
+void VPackfileVerifier::stop()
+{
+    if (m_thread.joinable()) {
+        m_abort = true;
+        m_thread.join();
+    }
+}
+
+void VPackfileVerifier::thread_proc()
+{
+    // Verification must never slow down the game
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+    for (auto& job : m_jobs) {
+        if (m_abort) {
+            break;
+        }
+        job.checksum = hash_file(job.path.c_str());
+        m_num_finished_jobs.fetch_add(1, std::memory_order_release);
+    }
+}
+
+std::optional<uint32_t> VPackfileVerifier::hash_file(const char* path)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        xlog::warn("Failed to open {} for verification (error {})", path, GetLastError());
+        return {};
+    }
+
+    auto buf = std::make_unique<std::byte[]>(hash_buffer_size);
+    XXH32_state_t* state = XXH32_createState();
+    XXH32_reset(state, 0);
+    bool success = true;
+    while (!m_abort) {
+        DWORD num_read = 0;
+        if (!ReadFile(file, buf.get(), hash_buffer_size, &num_read, nullptr)) {
+            xlog::warn("Failed to read {} for verification (error {})", path, GetLastError());
+            success = false;
+            break;
+        }
+        if (num_read == 0) {
+            break;
+        }
+        XXH32_update(state, buf.get(), num_read);
+        m_bytes_processed.fetch_add(num_read, std::memory_order_relaxed);
+    }
+    CloseHandle(file);
+    XXH32_hash_t hash = XXH32_digest(state);
+    XXH32_freeState(state);
+    if (!success || m_abort) {
+        return {};
+    }
+    return {hash};
+}
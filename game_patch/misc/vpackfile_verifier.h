@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "vpackfile_index.h"
+
+// Computes checksums of packfiles on a low priority background thread
+class VPackfileVerifier
+{
+public:
+    struct Job
+    {
+        std::string path;
+        std::string filename;
+        VPackfileStamp stamp;
+        uint32_t expected_checksum;
+        std::optional<uint32_t> checksum;
+    };
+
+    VPackfileVerifier() = default;
+    VPackfileVerifier(const VPackfileVerifier&) = delete;
+    VPackfileVerifier& operator=(const VPackfileVerifier&) = delete;
+    ~VPackfileVerifier();
+
+    // Note: jobs cannot be added after verification is started
+    void add_job(std::string path, std::string filename, const VPackfileStamp& stamp, uint32_t expected_checksum);
+    void start();
+    void stop();
+
+    [[nodiscard]] bool is_started() const
+    {
+        return m_started;
+    }
+
+    [[nodiscard]] bool is_finished() const
+    {
+        return m_num_finished_jobs.load(std::memory_order_acquire) == m_jobs.size();
+    }
+
+    // Note: results are only accessible after verification is finished
+    [[nodiscard]] const std::vector<Job>& get_jobs() const
+    {
+        return m_jobs;
+    }
+
+    [[nodiscard]] unsigned get_num_finished_jobs() const
+    {
+        return m_num_finished_jobs.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] unsigned get_num_jobs() const
+    {
+        return m_jobs.size();
+    }
+
+    [[nodiscard]] uint64_t get_bytes_processed() const
+    {
+        return m_bytes_processed.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t get_bytes_total() const
+    {
+        return m_bytes_total;
+    }
+
+private:
+    std::vector<Job> m_jobs;
+    std::thread m_thread;
+    std::atomic<unsigned> m_num_finished_jobs{0};
+    std::atomic<uint64_t> m_bytes_processed{0};
+    std::atomic<bool> m_abort{false};
+    uint64_t m_bytes_total = 0;
+    bool m_started = false;
+
+    void thread_proc();
+    std::optional<uint32_t> hash_file(const char* path);
+};
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <common/utils/list-utils.h>
+#include <xlog/xlog.h>
+#include "lag_comp.h"
+#include "server_internal.h"
+#include "../os/console.h"
+#include "../rf/entity.h"
+#include "../rf/multi.h"
+#include "../rf/player/player.h"
+#include "../rf/os/timer.h"
+
+// Minimal time between two recorded samples of an entity
+constexpr int lag_comp_tick_ms = 10;
+
+LagCompHistory g_lag_comp_history;
+
+// Real states of entities moved by lag_comp_rewind_players
+struct LagCompSavedEntity
+{
+    int entity_handle;
+    LagCompState state;
+    rf::Vector3 phys_pos;
+    rf::Matrix3 phys_orient;
+};
+static std::array<LagCompSavedEntity, LagCompHistory::max_entities> g_lag_comp_saved_entities;
+static std::size_t g_num_lag_comp_saved_entities = 0;
+
+void LagCompHistory::init(int depth_ms, int tick_ms)
+{
+    m_tick_ms = std::max(tick_ms, 1);
+    // One additional sample is needed to interpolate at the end of the window
+    m_capacity = depth_ms > 0 ? static_cast<std::size_t>(depth_ms / m_tick_ms + 2) : 0;
+    m_samples.clear();
+    m_samples.shrink_to_fit();
+    m_samples.resize(m_capacity * max_entities);
+    clear();
+}
+
+void LagCompHistory::clear()
+{
+    m_tracks.fill({});
+}
+
+const LagCompHistory::Track* LagCompHistory::find_track(int entity_handle) const
+{
+    for (const auto& track : m_tracks) {
+        if (track.entity_handle == entity_handle) {
+            return &track;
+        }
+    }
+    return nullptr;
+}
+
+const LagCompHistory::Sample& LagCompHistory::get_sample(std::size_t track_index, const Track& track,
+    std::size_t i) const
+{
+    // i = 0 is the oldest sample
+    std::size_t ring_index = (track.next_index + m_capacity - track.num_samples + i) % m_capacity;
+    return m_samples[track_index * m_capacity + ring_index];
+}
+
+void LagCompHistory::record(int entity_handle, int time_ms, const LagCompState& state)
+{
+    if (!enabled()) {
+        return;
+    }
+    auto track_it = std::find_if(m_tracks.begin(), m_tracks.end(),
+        [=](const Track& track) { return track.entity_handle == entity_handle; });
+    if (track_it == m_tracks.end()) {
+        // Reuse the track that was not updated for the longest time (entities are not removed explicitly)
+        auto get_age = [=](const Track& track) {
+            return track.entity_handle == -1 ? std::numeric_limits<int>::max() : time_ms - track.last_record_time_ms;
+        };
+        track_it = std::max_element(m_tracks.begin(), m_tracks.end(),
+            [&](const Track& a, const Track& b) { return get_age(a) < get_age(b); });
+        *track_it = {};
+        track_it->entity_handle = entity_handle;
+    }
+    else if (time_ms - track_it->last_record_time_ms < m_tick_ms) {
+        return;
+    }
+    auto track_index = static_cast<std::size_t>(track_it - m_tracks.begin());
+    m_samples[track_index * m_capacity + track_it->next_index] = {time_ms, state};
+    track_it->next_index = (track_it->next_index + 1) % m_capacity;
+    track_it->num_samples = std::min(track_it->num_samples + 1, m_capacity);
+    track_it->last_record_time_ms = time_ms;
+}
+
+std::optional<LagCompState> LagCompHistory::rewind(int entity_handle, int time_ms) const
+{
+    const Track* track = find_track(entity_handle);
+    if (!track || track->num_samples == 0) {
+        return {};
+    }
+    auto track_index = static_cast<std::size_t>(track - m_tracks.data());
+    // Find the first sample newer than the requested time
+    std::size_t lo = 0;
+    std::size_t hi = track->num_samples;
+    while (lo < hi) {
+        std::size_t mid = (lo + hi) / 2;
+        if (get_sample(track_index, *track, mid).time_ms - time_ms <= 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return get_sample(track_index, *track, 0).state;
+    }
+    if (lo == track->num_samples) {
+        return get_sample(track_index, *track, lo - 1).state;
+    }
+    const auto& prev = get_sample(track_index, *track, lo - 1);
+    const auto& next = get_sample(track_index, *track, lo);
+    float t = static_cast<float>(time_ms - prev.time_ms) / static_cast<float>(next.time_ms - prev.time_ms);
+    LagCompState result;
+    result.pos = prev.state.pos + (next.state.pos - prev.state.pos) * t;
+    result.bbox_min = prev.state.bbox_min + (next.state.bbox_min - prev.state.bbox_min) * t;
+    result.bbox_max = prev.state.bbox_max + (next.state.bbox_max - prev.state.bbox_max) * t;
+    result.orient = t < 0.5f ? prev.state.orient : next.state.orient;
+    return result;
+}
+
+void lag_comp_configure(int depth_ms)
+{
+    g_lag_comp_history.init(depth_ms, lag_comp_tick_ms);
+    if (depth_ms > 0) {
+        xlog::info("Lag compensation history depth: {} ms", depth_ms);
+    }
+}
+
+void lag_comp_clear()
+{
+    g_lag_comp_history.clear();
+}
+
+void lag_comp_do_frame()
+{
+    if (!rf::is_server || !g_lag_comp_history.enabled()) {
+        return;
+    }
+    int now_ms = rf::timer_get_milliseconds();
+    auto player_list = SinglyLinkedList{rf::player_list};
+    for (auto& player : player_list) {
+        rf::Entity* entity = rf::entity_from_handle(player.entity_handle);
+        if (entity) {
+            g_lag_comp_history.record(entity->handle, now_ms,
+                {entity->pos, entity->orient, entity->p_data.bbox_min, entity->p_data.bbox_max});
+        }
+    }
+}
+
+std::optional<LagCompState> lag_comp_rewind(const rf::Entity* entity, int time_ms)
+{
+    return g_lag_comp_history.rewind(entity->handle, time_ms);
+}
+
+int lag_comp_get_shot_time(int now_ms, int ping_ms, int interp_delay_ms)
+{
+    return now_ms - ping_ms - interp_delay_ms;
+}
+
+static void lag_comp_set_entity_state(rf::Entity* entity, const LagCompState& state, const rf::Vector3& phys_pos,
+    const rf::Matrix3& phys_orient)
+{
+    entity->pos = state.pos;
+    entity->orient = state.orient;
+    entity->p_data.pos = phys_pos;
+    entity->p_data.orient = phys_orient;
+    entity->p_data.bbox_min = state.bbox_min;
+    entity->p_data.bbox_max = state.bbox_max;
+}
+
+void lag_comp_rewind_players(const rf::Entity* shooter_ep, int time_ms)
+{
+    g_num_lag_comp_saved_entities = 0;
+    if (!g_lag_comp_history.enabled()) {
+        return;
+    }
+    auto player_list = SinglyLinkedList{rf::player_list};
+    for (auto& player : player_list) {
+        rf::Entity* entity = rf::entity_from_handle(player.entity_handle);
+        if (!entity || entity == shooter_ep || g_num_lag_comp_saved_entities == g_lag_comp_saved_entities.size()) {
+            continue;
+        }
+        auto state = lag_comp_rewind(entity, time_ms);
+        if (!state) {
+            continue;
+        }
+        g_lag_comp_saved_entities[g_num_lag_comp_saved_entities++] = {
+            entity->handle,
+            {entity->pos, entity->orient, entity->p_data.bbox_min, entity->p_data.bbox_max},
+            entity->p_data.pos,
+            entity->p_data.orient,
+        };
+        lag_comp_set_entity_state(entity, state.value(), state.value().pos, state.value().orient);
+    }
+}
+
+void lag_comp_restore_players()
+{
+    for (std::size_t i = 0; i < g_num_lag_comp_saved_entities; ++i) {
+        const auto& saved = g_lag_comp_saved_entities[i];
+        // Note: entity could be destroyed by the hit
+        rf::Entity* entity = rf::entity_from_handle(saved.entity_handle);
+        if (entity) {
+            lag_comp_set_entity_state(entity, saved.state, saved.phys_pos, saved.phys_orient);
+        }
+    }
+    g_num_lag_comp_saved_entities = 0;
+}
+
+ConsoleCommand2 lag_comp_bench_cmd{
+    "d_lag_comp_bench",
+    []() {
+        // 32 entities with 1 second of history
+        constexpr int depth_ms = 1000;
+        constexpr int num_queries = 100000;
+        auto history = std::make_unique<LagCompHistory>();
+        history->init(depth_ms, lag_comp_tick_ms);
+        for (int time_ms = 0; time_ms <= depth_ms; time_ms += lag_comp_tick_ms) {
+            for (std::size_t i = 0; i < LagCompHistory::max_entities; ++i) {
+                LagCompState state{};
+                state.pos.set(static_cast<float>(i), static_cast<float>(time_ms), 0.0f);
+                history->record(static_cast<int>(i), time_ms, state);
+            }
+        }
+        float checksum = 0.0f;
+        int start_us = rf::timer_get_microseconds();
+        for (int i = 0; i < num_queries; ++i) {
+            auto handle = static_cast<int>(i % LagCompHistory::max_entities);
+            int time_ms = (i * 7919) % depth_ms;
+            checksum += history->rewind(handle, time_ms).value().pos.y;
+        }
+        int duration_us = rf::timer_get_microseconds() - start_us;
+        rf::console::print("{} rewind queries: {} us ({:.1f} ns per query, checksum {})", num_queries, duration_us,
+            duration_us * 1000.0f / num_queries, checksum);
+    },
+    "Measures performance of lag compensation history queries",
+};
+
+#ifdef DEBUG
+
+#define ok(expr) if (!(expr)) xlog::error("Test failed: {}", #expr)
+
+static void test_lag_comp_hit_positions()
+{
+    // Target moves along X axis with constant speed. Server records the target every frame. Client receives states
+    // after one-way latency and shows them after the interpolation delay. Client fires a shot at the target it sees
+    // and the shot reaches the server after one-way latency.
+    constexpr float speed = 0.01f; // 10 m/s
+    constexpr int frame_ms = 16;
+    constexpr int one_way_ms = 60;
+    constexpr int interp_delay_ms = 50;
+    constexpr int ping_ms = 2 * one_way_ms;
+    auto get_pos_x = [](int time_ms) { return static_cast<float>(time_ms) * speed; };
+
+    auto history = std::make_unique<LagCompHistory>();
+    history->init(1000, lag_comp_tick_ms);
+    constexpr int target_handle = 1;
+    int num_shots = 0;
+    int fire_time_ms = 1000;
+    for (int time_ms = 0; time_ms <= 2000; time_ms += frame_ms) {
+        LagCompState state{};
+        state.pos.set(get_pos_x(time_ms), 0.0f, 0.0f);
+        history->record(target_handle, time_ms, state);
+
+        // Shots are fired every 37 ms and handled in the first server frame after they are received
+        for (; fire_time_ms + one_way_ms <= time_ms; fire_time_ms += 37) {
+            ++num_shots;
+            float seen_pos_x = get_pos_x(fire_time_ms - one_way_ms - interp_delay_ms);
+            int receive_time_ms = fire_time_ms + one_way_ms;
+            int shot_time_ms = lag_comp_get_shot_time(receive_time_ms, ping_ms, interp_delay_ms);
+            auto rewound = history->rewind(target_handle, shot_time_ms);
+            // Samples are linearly interpolated so the target is exactly where the shooter saw it
+            ok(rewound && std::abs(rewound.value().pos.x - seen_pos_x) < 0.001f);
+            // Ignoring the interpolation delay or counting only one-way latency misses the target seen by the shooter
+            auto rtt_rewound = history->rewind(target_handle, receive_time_ms - ping_ms);
+            ok(rtt_rewound && std::abs(rtt_rewound.value().pos.x - seen_pos_x) > 0.1f);
+            auto one_way_rewound = history->rewind(target_handle, receive_time_ms - one_way_ms - interp_delay_ms);
+            ok(one_way_rewound && std::abs(one_way_rewound.value().pos.x - seen_pos_x) > 0.1f);
+        }
+    }
+    ok(num_shots > 20);
+}
+
+#endif
+
+void lag_comp_init()
+{
+    lag_comp_bench_cmd.register_cmd();
+#ifdef DEBUG
+    test_lag_comp_hit_positions();
+#endif
+}
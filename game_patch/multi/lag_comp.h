@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+#include "../rf/math/vector.h"
+#include "../rf/math/matrix.h"
+
+// Forward declarations
+namespace rf
+{
+    struct Entity;
+}
+
+struct LagCompState
+{
+    rf::Vector3 pos;
+    rf::Matrix3 orient;
+    rf::Vector3 bbox_min;
+    rf::Vector3 bbox_max;
+};
+
+// Per-entity history of states used to rewind entities to the time seen by a lagged client
+// Memory for all tracked entities is allocated in init so recording and querying never allocate.
+class LagCompHistory
+{
+public:
+    static constexpr std::size_t max_entities = 32;
+
+    void init(int depth_ms, int tick_ms);
+    void clear();
+    // Samples recorded less than tick_ms after the previous sample of the entity are ignored
+    void record(int entity_handle, int time_ms, const LagCompState& state);
+    // Position and bounding box are interpolated between the closest samples, orientation is taken from the nearest
+    // sample. Time is clamped to the recorded range. Returns nothing if the entity has no samples.
+    [[nodiscard]] std::optional<LagCompState> rewind(int entity_handle, int time_ms) const;
+
+    [[nodiscard]] bool enabled() const
+    {
+        return m_capacity > 0;
+    }
+
+private:
+    struct Sample
+    {
+        int time_ms;
+        LagCompState state;
+    };
+
+    struct Track
+    {
+        int entity_handle = -1;
+        int last_record_time_ms = 0;
+        std::size_t num_samples = 0;
+        std::size_t next_index = 0;
+    };
+
+    [[nodiscard]] const Track* find_track(int entity_handle) const;
+    [[nodiscard]] const Sample& get_sample(std::size_t track_index, const Track& track, std::size_t i) const;
+
+    std::array<Track, max_entities> m_tracks;
+    // Ring buffers of all tracks (m_capacity samples per track)
+    std::vector<Sample> m_samples;
+    std::size_t m_capacity = 0;
+    int m_tick_ms = 0;
+};
+
+void lag_comp_init();
+void lag_comp_configure(int depth_ms);
+void lag_comp_clear();
+void lag_comp_do_frame();
+std::optional<LagCompState> lag_comp_rewind(const rf::Entity* entity, int time_ms);
+// Returns the server time of the world state that a client was showing when it fired a shot received now.
+// The state travelled to the client (one-way latency), was shown after the interpolation delay and the shot travelled
+// back to the server (one-way latency), so the state is older than now by the round trip time (ping) and the delay.
+int lag_comp_get_shot_time(int now_ms, int ping_ms, int interp_delay_ms);
+// Moves entities of all players except the shooter to their recorded positions at the provided time. They must be
+// moved back by lag_comp_restore_players when the hit test is finished.
+void lag_comp_rewind_players(const rf::Entity* shooter_ep, int time_ms);
+void lag_comp_restore_players();
@@ -34,6 +34,22 @@ static bool is_vpp_filename(const char* filename)
     return string_ends_with_ignore_case(filename, ".vpp");
 }
 
+// Packfiles shared by multiple levels are often already present - skip extracting them if contents are identical
+static bool is_file_already_present(const std::string& path, uint64_t size, uint32_t crc)
+{
+    std::ifstream file(path, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+    if (!file || static_cast<uint64_t>(file.tellg()) != size) {
+        return false;
+    }
+    file.seekg(0);
+    std::vector<char> buf(0x10000);
+    uLong local_crc = crc32(0L, Z_NULL, 0);
+    while (file.read(buf.data(), buf.size()) || file.gcount() > 0) {
+        local_crc = crc32(local_crc, reinterpret_cast<const Bytef*>(buf.data()), file.gcount());
+    }
+    return local_crc == crc;
+}
+
 static std::vector<std::string> unzip(const char* path, const char* output_dir,
     std::function<bool(const char*)> filename_filter)
 {
@@ -63,9 +79,14 @@ static std::vector<std::string> unzip(const char* path, const char* output_dir,
             break;
         }
 
-        if (filename_filter(file_name)) {
+        auto output_path = std::format("{}\\{}", output_dir, file_name);
+        if (filename_filter(file_name) &&
+            is_file_already_present(output_path, file_info.uncompressed_size, file_info.crc)) {
+            xlog::info("Skipping {} - identical file already exists", file_name);
+            extracted_files.emplace_back(file_name);
+        }
+        else if (filename_filter(file_name)) {
             xlog::trace("Unpacking {}", file_name);
-            auto output_path = std::format("{}\\{}", output_dir, file_name);
             std::ofstream file(output_path, std::ios_base::out | std::ios_base::binary);
             if (!file) {
                 xlog::error("Cannot open file: {}", output_path);
@@ -137,7 +158,16 @@ static std::vector<std::string> unrar(const char* path, const char* output_dir,
             break;
         }
 
-        if (filename_filter(header_data.FileName)) {
+        auto output_path = std::format("{}\\{}", output_dir, header_data.FileName);
+        if (filename_filter(header_data.FileName) &&
+            is_file_already_present(output_path, header_data.UnpSize, header_data.FileCRC)) {
+            xlog::info("Skipping {} - identical file already exists", header_data.FileName);
+            code = RARProcessFile(archive_handle, RAR_SKIP, nullptr, nullptr);
+            if (code == 0) {
+                extracted_files.emplace_back(header_data.FileName);
+            }
+        }
+        else if (filename_filter(header_data.FileName)) {
             xlog::trace("Unpacking {}", header_data.FileName);
             code = RARProcessFile(archive_handle, RAR_EXTRACT, const_cast<char*>(output_dir), nullptr);
             if (code == 0) {
@@ -84,9 +84,13 @@ void multi_level_download_update();
 void multi_do_patch();
 void multi_after_full_game_init();
 void multi_init_player(rf::Player* player);
+void multi_invalidate_game_info_cache();
+void multi_flush_batched_packets(rf::Player* player);
+void multi_flush_all_batched_packets();
 void send_chat_line_packet(const char* msg, rf::Player* target, rf::Player* sender = nullptr, bool is_team_msg = false);
 const std::optional<DashFactionServerInfo>& get_df_server_info();
 void multi_level_download_do_frame();
 void multi_level_download_abort();
 void multi_ban_apply_patch();
+void multi_ban_do_frame();
 std::optional<std::string> multi_ban_unban_last();
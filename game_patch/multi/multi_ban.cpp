@@ -1,11 +1,17 @@
 #include <vector>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <future>
 #include <charconv>
 #include <sstream>
 #include <winsock2.h>
 #include <xlog/xlog.h>
 #include <patch_common/FunHook.h>
 
+#include "../os/console.h"
 #include "../rf/multi.h"
 #include "multi.h"
 
@@ -24,11 +30,22 @@ public:
 
     bool operator==(const IpRange& other) const = default;
 
-    bool matches(unsigned ip)
+    bool matches(unsigned ip) const
     {
         return (ip & mask_) == ip_;
     }
 
+    unsigned ip() const
+    {
+        return ip_;
+    }
+
+    // Note: all ranges use contiguous masks
+    unsigned prefix_len() const
+    {
+        return std::popcount(mask_);
+    }
+
     static IpRange parse(const std::string& s);
 
     std::string to_string()
@@ -112,66 +129,253 @@ IpRange IpRange::parse(const std::string& s)
     return IpRange{ip, mask};
 }
 
+static unsigned prefix_mask(unsigned prefix_len)
+{
+    return prefix_len == 0 ? 0 : FULL_MASK << (32 - prefix_len);
+}
+
+// Compressed binary trie (PATRICIA tree) of IP ranges
+// Lookup cost depends on the number of bits in an address, not on the number of ranges.
+class IpRangeTrie
+{
+    struct Node
+    {
+        unsigned prefix;
+        unsigned prefix_len;
+        int children[2] = {-1, -1};
+        bool terminal = false;
+    };
+
+    // Node 0 is the root (empty prefix)
+    std::vector<Node> nodes_{Node{0, 0}};
+
+    static unsigned bit_at(unsigned ip, unsigned pos)
+    {
+        return (ip >> (31 - pos)) & 1;
+    }
+
+    int add_node(unsigned prefix, unsigned prefix_len, bool terminal)
+    {
+        Node node{prefix, prefix_len};
+        node.terminal = terminal;
+        nodes_.push_back(node);
+        return static_cast<int>(nodes_.size() - 1);
+    }
+
+public:
+    void insert(const IpRange& range)
+    {
+        unsigned prefix = range.ip();
+        unsigned prefix_len = range.prefix_len();
+        // Note: nodes_ can be reallocated so nodes are accessed by index
+        int idx = 0;
+        while (true) {
+            if (nodes_[idx].prefix_len == prefix_len) {
+                nodes_[idx].terminal = true;
+                return;
+            }
+            unsigned branch = bit_at(prefix, nodes_[idx].prefix_len);
+            int child = nodes_[idx].children[branch];
+            if (child < 0) {
+                int leaf = add_node(prefix, prefix_len, true);
+                nodes_[idx].children[branch] = leaf;
+                return;
+            }
+            unsigned child_prefix = nodes_[child].prefix;
+            unsigned child_prefix_len = nodes_[child].prefix_len;
+            unsigned common_len = std::min({prefix_len, child_prefix_len,
+                static_cast<unsigned>(std::countl_zero(prefix ^ child_prefix))});
+            if (common_len == child_prefix_len) {
+                idx = child;
+                continue;
+            }
+            // Split the edge leading to the child
+            int split = add_node(prefix & prefix_mask(common_len), common_len, common_len == prefix_len);
+            nodes_[split].children[bit_at(child_prefix, common_len)] = child;
+            nodes_[idx].children[branch] = split;
+            if (common_len != prefix_len) {
+                int leaf = add_node(prefix, prefix_len, true);
+                nodes_[split].children[bit_at(prefix, common_len)] = leaf;
+            }
+            return;
+        }
+    }
+
+    // Returns the most specific range containing the address
+    std::optional<IpRange> find_longest_match(unsigned ip) const
+    {
+        std::optional<IpRange> result;
+        int idx = 0;
+        while (idx >= 0) {
+            const Node& node = nodes_[idx];
+            if ((ip & prefix_mask(node.prefix_len)) != node.prefix) {
+                break;
+            }
+            if (node.terminal) {
+                result = IpRange{node.prefix, prefix_mask(node.prefix_len)};
+            }
+            if (node.prefix_len == 32) {
+                break;
+            }
+            idx = node.children[bit_at(ip, node.prefix_len)];
+        }
+        return result;
+    }
+};
+
 class Banlist
 {
+    struct Data
+    {
+        std::vector<IpRange> ip_ranges;
+        IpRangeTrie trie;
+        std::filesystem::file_time_type file_time;
+    };
+
+    static constexpr const char* filename = "banlist.txt";
+    static constexpr auto reload_check_interval = std::chrono::seconds{5};
+
+    // Ranges are kept in a vector too to preserve order of entries (needed by save and unban_last)
     std::vector<IpRange> ip_ranges_;
+    IpRangeTrie trie_;
+    std::filesystem::file_time_type file_time_;
+    std::future<Data> load_future_;
+    bool loaded_ = false;
+    std::chrono::steady_clock::time_point last_reload_check_;
 
-public:
-    void load()
+    static std::filesystem::file_time_type get_file_time()
     {
-        std::ifstream f("banlist.txt");
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(filename, ec);
+        return ec ? std::filesystem::file_time_type{} : time;
+    }
+
+    static std::optional<IpRange> parse_entry(const std::string& s)
+    {
+        try {
+            return {IpRange::parse(s)};
+        } catch (const std::exception& e) {
+            xlog::error("Failed to parse banlist entry: {}", s);
+            return {};
+        }
+    }
+
+    // Runs in a worker thread
+    static Data load_data()
+    {
+        Data data;
+        data.file_time = get_file_time();
+        std::ifstream f(filename);
         std::string line;
         while (std::getline(f, line)) {
             // Ignore empty lines and comments
             if (line.empty() || line.starts_with('#') || line.starts_with("//")) {
                 continue;
             }
-            add(line);
+            if (auto r = parse_entry(line)) {
+                data.ip_ranges.push_back(r.value());
+                data.trie.insert(r.value());
+            }
         }
+        return data;
     }
 
-    void save()
+    // Applies the result of a background load if it is available
+    void poll_load(bool wait)
     {
-        std::ofstream f("banlist.txt");
-        for (auto& r : ip_ranges_) {
-            f << r.to_string() << '\n';
+        if (!load_future_.valid()) {
+            return;
+        }
+        if (!wait && load_future_.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+            return;
         }
+        Data data = load_future_.get();
+        ip_ranges_ = std::move(data.ip_ranges);
+        trie_ = std::move(data.trie);
+        file_time_ = data.file_time;
+        loaded_ = true;
+        xlog::info("Loaded {} banlist entries", ip_ranges_.size());
     }
 
-    bool is_banned(unsigned ip)
+    void rebuild_trie()
     {
+        trie_ = {};
         for (auto& r : ip_ranges_) {
-            if (r.matches(ip)) {
-                return true;
+            trie_.insert(r);
+        }
+    }
+
+public:
+    void load()
+    {
+        if (!load_future_.valid()) {
+            load_future_ = std::async(std::launch::async, load_data);
+        }
+    }
+
+    void do_frame()
+    {
+        poll_load(false);
+        // Reload the list if the file has been modified by another process
+        auto now = std::chrono::steady_clock::now();
+        if (loaded_ && now - last_reload_check_ >= reload_check_interval) {
+            last_reload_check_ = now;
+            if (get_file_time() != file_time_) {
+                xlog::info("Banlist file has been modified - reloading");
+                load();
             }
         }
-        return false;
+    }
+
+    void save()
+    {
+        // Make sure changes are not overwritten by a pending load
+        poll_load(true);
+        {
+            std::ofstream f(filename);
+            for (auto& r : ip_ranges_) {
+                f << r.to_string() << '\n';
+            }
+        }
+        file_time_ = get_file_time();
+    }
+
+    bool is_banned(unsigned ip)
+    {
+        // Wait for the initial load so nobody can join before the list is loaded
+        poll_load(!loaded_);
+        return trie_.find_longest_match(ip).has_value();
     }
 
     bool add(const std::string& s)
     {
-        try {
-            IpRange r = IpRange::parse(s);
-            ip_ranges_.push_back(r);
-            return true;
-        } catch (const std::exception& e) {
-            xlog::error("Failed to parse banlist entry: {}", s);
+        auto r = parse_entry(s);
+        if (!r) {
             return false;
         }
+        poll_load(true);
+        ip_ranges_.push_back(r.value());
+        trie_.insert(r.value());
+        return true;
     }
 
     void add(unsigned ip)
     {
+        poll_load(true);
         ip_ranges_.push_back(IpRange{ip});
+        trie_.insert(IpRange{ip});
     }
 
     std::optional<IpRange> unban_last()
     {
+        poll_load(true);
         if (ip_ranges_.empty()) {
             return {};
         }
         IpRange r = ip_ranges_.back();
         ip_ranges_.pop_back();
+        // Removal is rare so the trie is simply rebuilt
+        rebuild_trie();
         return {r};
     }
 
@@ -231,6 +435,13 @@ FunHook multi_ban_add2_hook{
     },
 };
 
+void multi_ban_do_frame()
+{
+    if (rf::is_multi && rf::is_server) {
+        Banlist::instance().do_frame();
+    }
+}
+
 std::optional<std::string> multi_ban_unban_last()
 {
     auto opt = Banlist::instance().unban_last();
@@ -262,8 +473,77 @@ static void test_parsing()
     }
 }
 
+static void test_trie()
+{
+    IpRangeTrie trie;
+    ok(!trie.find_longest_match(0xC0A81103));
+    trie.insert(IpRange::parse("192.168.*"));
+    trie.insert(IpRange::parse("192.168.17.16/28"));
+    trie.insert(IpRange::parse("192.168.17.3"));
+    trie.insert(IpRange::parse("10.*"));
+    ok(trie.find_longest_match(0xC0A81103) == IpRange::parse("192.168.17.3"));
+    ok(trie.find_longest_match(0xC0A81104) == IpRange::parse("192.168.*"));
+    ok(trie.find_longest_match(0xC0A8111F) == IpRange::parse("192.168.17.16/28"));
+    ok(trie.find_longest_match(0xC0A81120) == IpRange::parse("192.168.*"));
+    ok(trie.find_longest_match(0x0A010203) == IpRange::parse("10.*"));
+    ok(!trie.find_longest_match(0xC0A91103));
+    ok(!trie.find_longest_match(0x0B000000));
+    // Inserting a shorter prefix of an existing one splits the edge
+    trie.insert(IpRange::parse("192.*"));
+    ok(trie.find_longest_match(0xC0A91103) == IpRange::parse("192.*"));
+    ok(trie.find_longest_match(0xC0A81103) == IpRange::parse("192.168.17.3"));
+}
+
 #endif
 
+ConsoleCommand2 banlist_bench_cmd{
+    "d_banlist_bench",
+    []() {
+        // Compare trie lookups with linear scan for 100k random ranges
+        constexpr int num_ranges = 100000;
+        constexpr int num_lookups = 10000;
+        unsigned seed = 12345;
+        auto next_random = [&]() {
+            seed = seed * 1664525 + 1013904223;
+            return seed;
+        };
+        std::vector<IpRange> ranges;
+        IpRangeTrie trie;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_ranges; ++i) {
+            unsigned mask = prefix_mask(16 + next_random() % 17);
+            IpRange r{next_random() & mask, mask};
+            ranges.push_back(r);
+            trie.insert(r);
+        }
+        auto insert_end = std::chrono::steady_clock::now();
+        std::vector<unsigned> ips;
+        for (int i = 0; i < num_lookups; ++i) {
+            // Make half of the addresses match some range
+            unsigned ip = next_random();
+            ips.push_back(i % 2 ? ip : ranges[ip % num_ranges].ip() | (ip & 0xFF));
+        }
+        auto lookup_start = std::chrono::steady_clock::now();
+        int trie_matches = 0;
+        for (unsigned ip : ips) {
+            trie_matches += trie.find_longest_match(ip).has_value();
+        }
+        auto trie_end = std::chrono::steady_clock::now();
+        int linear_matches = 0;
+        for (unsigned ip : ips) {
+            linear_matches += std::any_of(ranges.begin(), ranges.end(),
+                [=](const IpRange& r) { return r.matches(ip); });
+        }
+        auto linear_end = std::chrono::steady_clock::now();
+        using us = std::chrono::microseconds;
+        rf::console::print("Banlist benchmark: {} ranges inserted in {} us, {} lookups: trie {} us ({} matches), "
+            "linear {} us ({} matches)", num_ranges, std::chrono::duration_cast<us>(insert_end - start).count(), num_lookups,
+            std::chrono::duration_cast<us>(trie_end - lookup_start).count(), trie_matches,
+            std::chrono::duration_cast<us>(linear_end - trie_end).count(), linear_matches);
+    },
+    "Measures performance of banlist lookups",
+};
+
 void multi_ban_apply_patch()
 {
     multi_ban_init_hook.install();
@@ -275,5 +555,8 @@ void multi_ban_apply_patch()
 
 #ifdef DEBUG
     test_parsing();
+    test_trie();
 #endif
+
+    banlist_bench_cmd.register_cmd();
 }
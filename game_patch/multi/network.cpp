@@ -5,7 +5,11 @@
 #include <cstring>
 #include <format>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
 #include <thread>
+#include <vector>
 #include <winsock2.h>
 #include <iphlpapi.h>
 #include <ws2ipdef.h>
@@ -25,6 +29,11 @@
 #include "multi.h"
 #include "server.h"
 #include "server_internal.h"
+#include "packet_builder.h"
+#include "packet_dispatch.h"
+#include "network_stats.h"
+#include "obj_update_codec.h"
+#include "reliable_channel.h"
 #include "../main/main.h"
 #include "../rf/multi.h"
 #include "../rf/misc.h"
@@ -41,6 +50,7 @@
 #include "../object/object.h"
 #include "../os/console.h"
 #include "../purefaction/pf.h"
+#include "../purefaction/pf_packets.h"
 
 // NET_IFINDEX_UNSPECIFIED is not defined in MinGW headers
 #ifndef NET_IFINDEX_UNSPECIFIED
@@ -187,103 +197,127 @@ enum packet_type : uint8_t {
     glass_kill             = 0x36,
 };
 
+// Returns true if packet has been processed or false if it should be processed by game code
+using CustomPacketHandler = bool(const void* data, int len, const rf::NetAddr& addr, rf::Player* player);
+
+static bool process_custom_packet([[maybe_unused]] const void* data, [[maybe_unused]] int len,
+                                  [[maybe_unused]] const rf::NetAddr& addr, [[maybe_unused]] rf::Player* player)
+{
+    pf_process_packet(data, len, addr, player);
+    return true;
+}
+
+static bool process_game_info_request_packet(const void* data, int len, const rf::NetAddr& addr, rf::Player* player);
+static bool process_join_request_packet(const void* data, int len, const rf::NetAddr& addr, rf::Player* player);
+static bool process_df_obj_update_ack_packet(const void* data, int len, const rf::NetAddr& addr, rf::Player* player);
+static bool process_df_obj_update_packet(const void* data, int len, const rf::NetAddr& addr, rf::Player* player);
+static bool process_df_reliable_ack_packet(const void* data, int len, const rf::NetAddr& addr, rf::Player* player);
+static bool process_df_reliable_data_packet(const void* data, int len, const rf::NetAddr& addr, rf::Player* player);
+
+constexpr uint8_t first_custom_packet_type = 0x38;
+
+constexpr uint8_t pf_type(pf_packet_type type)
+{
+    return static_cast<uint8_t>(type);
+}
+
+// Minimal sizes are only set for packets with fields read by Dash Faction hooks
+
 // client -> server
-std::array g_server_side_packet_whitelist{
-    game_info_request,
-    join_request,
-    left_game,
-    state_info_request,
-    client_in_game,
-    chat_line,
-    name_change,
-    respawn_request,
-    use_key_pressed,
-    suicide,
-    team_change,
-    pong,
-    rate_change,
-    select_weapon_request,
-    obj_update,
-    reload_request,
-    weapon_fire,
-    fall_damage,
-    rcon_request,
-    rcon,
+constinit PacketDispatchTable<CustomPacketHandler> g_server_side_packet_dispatch_table{
+    {
+        {game_info_request, 0, process_game_info_request_packet},
+        {join_request, 0, process_join_request_packet},
+        {left_game, 1},
+        {state_info_request},
+        {client_in_game},
+        {chat_line, 2},
+        {name_change, 1},
+        {respawn_request},
+        {use_key_pressed},
+        {suicide},
+        {team_change, 2},
+        {pong},
+        {rate_change, 1},
+        {select_weapon_request},
+        {obj_update},
+        {reload_request, 4},
+        {weapon_fire},
+        {fall_damage},
+        {rcon_request},
+        {rcon},
+        // PF packets
+        // Note: PF player_stats packet has the same type as unused mover_update packet
+        {pf_type(pf_packet_type::player_stats), 0, process_custom_packet},
+        // DF packets
+        {df_obj_update_ack_packet_type, sizeof(uint16_t), process_df_obj_update_ack_packet},
+        {df_reliable_ack_packet_type, sizeof(uint16_t) + sizeof(uint32_t), process_df_reliable_ack_packet},
+    },
+    // Packet types not used by the game are passed to PF code (anticheat packets are handled by closed-source code
+    // so the exact list of types is unknown)
+    first_custom_packet_type, process_custom_packet,
 };
 
 // server -> client
-std::array g_client_side_packet_whitelist{
-    game_info,
-    join_accept,
-    join_deny,
-    new_player,
-    players,
-    left_game,
-    end_game,
-    state_info_done,
-    chat_line,
-    name_change,
-    trigger_activate,
-    pregame_boolean,
-    pregame_glass,
-    pregame_remote_charge,
-    enter_limbo,
-    leave_limbo,
-    team_change,
-    ping,
-    netgame_update,
-    rate_change,
-    clutter_udate,
-    clutter_kill,
-    ctf_flag_pick_up,
-    ctf_flag_capture,
-    ctf_flag_update,
-    ctf_flag_return,
-    ctf_flag_drop,
-    remote_charge_kill,
-    item_update,
-    obj_update,
-    obj_kill,
-    item_apply,
-    boolean_,
-    // Note: mover_update packet is sent by PF server. Handler is empty so it is safe to enable it.
-    mover_update,
-    respawn,
-    entity_create,
-    item_create,
-    reload,
-    weapon_fire,
-    sound,
-    team_score,
-    glass_kill,
+constinit PacketDispatchTable<CustomPacketHandler> g_client_side_packet_dispatch_table{
+    {
+        {game_info},
+        {join_accept},
+        {join_deny},
+        {new_player},
+        {players},
+        {left_game, 1},
+        {end_game},
+        {state_info_done},
+        {chat_line, 2},
+        {name_change, 1},
+        {trigger_activate},
+        {pregame_boolean},
+        {pregame_glass},
+        {pregame_remote_charge},
+        {enter_limbo},
+        {leave_limbo},
+        {team_change, 2},
+        {ping},
+        {netgame_update},
+        {rate_change, 1},
+        {clutter_udate},
+        {clutter_kill},
+        {ctf_flag_pick_up},
+        {ctf_flag_capture},
+        {ctf_flag_update},
+        {ctf_flag_return},
+        {ctf_flag_drop},
+        {remote_charge_kill},
+        {item_update},
+        {obj_update},
+        {obj_kill},
+        {item_apply},
+        {boolean_},
+        {respawn},
+        {entity_create},
+        {item_create},
+        {reload, 16},
+        {weapon_fire},
+        {sound},
+        {team_score},
+        {glass_kill},
+        // PF packets
+        // Note: PF player_stats packet has the same type as unused mover_update packet
+        {pf_type(pf_packet_type::player_stats), 0, process_custom_packet},
+        // DF packets
+        {df_obj_update_packet_type, sizeof(uint16_t) + sizeof(uint8_t), process_df_obj_update_packet},
+        {df_reliable_data_packet_type, sizeof(uint16_t) + sizeof(uint8_t), process_df_reliable_data_packet},
+    },
+    // Packet types not used by the game are passed to PF code (anticheat packets are handled by closed-source code
+    // so the exact list of types is unknown)
+    first_custom_packet_type, process_custom_packet,
 };
+
 // clang-format on
 
 std::optional<DashFactionServerInfo> g_df_server_info;
 
-CodeInjection process_game_packet_whitelist_filter{
-    0x0047918D,
-    [](auto& regs) {
-        bool allowed = false;
-        int packet_type = regs.esi;
-        if (rf::is_server) {
-            auto& whitelist = g_server_side_packet_whitelist;
-            allowed = std::find(whitelist.begin(), whitelist.end(), packet_type) != whitelist.end();
-        }
-        else {
-            auto& whitelist = g_client_side_packet_whitelist;
-            allowed = std::find(whitelist.begin(), whitelist.end(), packet_type) != whitelist.end();
-        }
-        if (!allowed) {
-            xlog::warn("Ignoring packet 0x{:x}", packet_type);
-            regs.eip = 0x00479194;
-        }
-        else {
-            xlog::trace("Processing packet 0x{:x}", packet_type);
-        }
-    },
-};
-
 FunHook<MultiIoPacketHandler> process_game_info_packet_hook{
     0x0047B2A0,
     [](char* data, const rf::NetAddr& addr) {
@@ -619,44 +653,143 @@ struct df_sign_packet_ext
     uint8_t version_minor = VERSION_MINOR;
 };
 
+using DfPacketBuilder = PacketBuilder<rf::max_packet_size>;
+
+// Copies the packet and appends extension data to it. If extended packet would not fit in the buffer the original
+// packet is sent instead
 template<typename T>
-std::pair<std::unique_ptr<std::byte[]>, size_t> extend_packet(const std::byte* data, size_t len, const T& ext_data)
+int send_extended_packet(CallHook<int(const rf::NetAddr*, std::byte*, size_t)>& send_hook, const rf::NetAddr* addr,
+    std::byte* data, size_t len, const T& ext_data)
 {
-    auto new_data = std::make_unique<std::byte[]>(len + sizeof(ext_data));
+    DfPacketBuilder packet{data, len};
+    packet.append(ext_data);
+    if (packet.overflow()) {
+        xlog::warn("Packet is too big to add Dash Faction extension data: {}", len);
+        return send_hook.call_target(addr, data, len);
+    }
+    packet.patch_header();
+    return send_hook.call_target(addr, packet.data(), packet.size());
+}
 
-    // Modify size in packet header
-    RF_GamePacketHeader header;
-    std::memcpy(&header, data, sizeof(header));
-    header.size += sizeof(ext_data);
-    std::memcpy(new_data.get(), &header, sizeof(header));
+// Limits number of requests per second sent from a single IP address
+// Counts requests from every IP address in one second windows
+// Note: table has a fixed size so addresses that do not fit in their set share one counter. Limit is never bypassed
+// that way but addresses colliding with a flooding one can be limited too.
+class IpRateLimiter
+{
+public:
+    bool check(uint32_t ip_addr, int now_ms, int max_per_second)
+    {
+        auto& set = m_sets[(ip_addr * 2654435761u) >> 24];
+        Counter* counter = nullptr;
+        Counter* free_counter = nullptr;
+        for (auto& way : set.ways) {
+            if (way.count > 0 && way.ip_addr == ip_addr) {
+                counter = &way;
+                break;
+            }
+            if (!free_counter && (way.count == 0 || way.is_expired(now_ms))) {
+                free_counter = &way;
+            }
+        }
+        if (!counter && free_counter) {
+            *free_counter = {ip_addr, now_ms, 0};
+            counter = free_counter;
+        }
+        if (!counter) {
+            counter = &set.shared;
+        }
+        if (counter->is_expired(now_ms)) {
+            counter->window_start_ms = now_ms;
+            counter->count = 0;
+        }
+        ++counter->count;
+        return counter->count <= max_per_second;
+    }
 
-    // Copy old data
-    std::memcpy(new_data.get() + sizeof(header), data + sizeof(header), len - sizeof(header));
+private:
+    struct Counter
+    {
+        uint32_t ip_addr = 0;
+        int window_start_ms = 0;
+        int count = 0;
 
-    // Append extension data
-    std::memcpy(new_data.get() + len, &ext_data, sizeof(ext_data));
+        [[nodiscard]] bool is_expired(int now_ms) const
+        {
+            return now_ms - window_start_ms >= 1000;
+        }
+    };
 
-    return {std::move(new_data), len + sizeof(ext_data)};
-}
+    struct Set
+    {
+        std::array<Counter, 4> ways;
+        Counter shared;
+    };
 
-std::pair<std::unique_ptr<std::byte[]>, size_t> extend_packet_with_df_signature(std::byte* data, size_t len)
+    std::array<Set, 256> m_sets;
+};
+
+// Serialized game_info packet (with DF signature) that is sent in response to game_info_request packets
+// Note: cache is invalidated when player joins or leaves, level changes or server config changes. Max age makes sure
+// that changes made by stock console commands (e.g. max_players) are sent eventually.
+struct GameInfoCache
 {
-    df_sign_packet_ext ext;
-    ext.df_signature = DASH_FACTION_SIGNATURE;
-    ext.version_major = VERSION_MAJOR;
-    ext.version_minor = VERSION_MINOR;
-    return extend_packet(data, len, ext);
-}
+    static constexpr int max_age_ms = 1000;
+
+    std::array<std::byte, rf::max_packet_size> data;
+    size_t len = 0;
+    int creation_time_ms = 0;
+    bool valid = false;
+};
+
+GameInfoCache g_game_info_cache;
+IpRateLimiter g_game_info_request_rate_limiter;
 
 CallHook<int(const rf::NetAddr*, std::byte*, size_t)> send_game_info_packet_hook{
     0x0047B287,
     [](const rf::NetAddr* addr, std::byte* data, size_t len) {
         // Add Dash Faction signature to game_info packet
-        auto [new_data, new_len] = extend_packet_with_df_signature(data, len);
-        return send_game_info_packet_hook.call_target(addr, new_data.get(), new_len);
+        DfPacketBuilder packet{data, len};
+        packet.append(df_sign_packet_ext{});
+        if (packet.overflow()) {
+            xlog::warn("Packet is too big to add Dash Faction extension data: {}", len);
+            return send_game_info_packet_hook.call_target(addr, data, len);
+        }
+        packet.patch_header();
+        if (rf::is_server) {
+            auto& cache = g_game_info_cache;
+            std::memcpy(cache.data.data(), packet.data(), packet.size());
+            cache.len = packet.size();
+            cache.creation_time_ms = rf::timer_get(1000);
+            cache.valid = true;
+        }
+        return send_game_info_packet_hook.call_target(addr, packet.data(), packet.size());
     },
 };
 
+static bool process_game_info_request_packet([[maybe_unused]] const void* data, [[maybe_unused]] int len,
+                                             const rf::NetAddr& addr, [[maybe_unused]] rf::Player* player)
+{
+    int now = rf::timer_get(1000);
+    int rate_limit = g_additional_server_config.game_info_rate_limit;
+    if (rate_limit > 0 && !g_game_info_request_rate_limiter.check(addr.ip_addr, now, rate_limit)) {
+        xlog::trace("Ignoring game_info_request from {:x} because of rate limit", addr.ip_addr);
+        return true;
+    }
+    const auto& cache = g_game_info_cache;
+    if (cache.valid && now - cache.creation_time_ms < GameInfoCache::max_age_ms) {
+        send_game_info_packet_hook.call_target(&addr, const_cast<std::byte*>(cache.data.data()), cache.len);
+        return true;
+    }
+    // Let the game build the packet - it is cached in send_game_info_packet_hook
+    return false;
+}
+
+void multi_invalidate_game_info_cache()
+{
+    g_game_info_cache.valid = false;
+}
+
 struct DashFactionJoinAcceptPacketExt
 {
     uint32_t df_signature = DASH_FACTION_SIGNATURE;
@@ -675,12 +808,76 @@ struct DashFactionJoinAcceptPacketExt
 template<>
 struct EnableEnumBitwiseOperators<DashFactionJoinAcceptPacketExt::Flags> : std::true_type {};
 
+struct DashFactionJoinReqPacketExt
+{
+    uint32_t df_signature = DASH_FACTION_SIGNATURE;
+    uint8_t version_major = VERSION_MAJOR;
+    uint8_t version_minor = VERSION_MINOR;
+
+    enum class Flags : uint32_t {
+        none             = 0,
+        obj_update_delta = 1,
+        batched_packets  = 2,
+        reliable_channel = 4,
+    } flags = Flags::none;
+};
+template<>
+struct EnableEnumBitwiseOperators<DashFactionJoinReqPacketExt::Flags> : std::true_type {};
+
+// Client capabilities received in join_req packets that were not answered yet
+struct PendingJoinRequest
+{
+    rf::NetAddr addr;
+    DashFactionJoinReqPacketExt::Flags flags;
+};
+std::vector<PendingJoinRequest> g_pending_join_requests;
+
+static bool process_join_request_packet(const void* data, int len, [[maybe_unused]] const rf::NetAddr& addr,
+    [[maybe_unused]] rf::Player* player)
+{
+    // Remember client capabilities and let the game handle the packet
+    RF_GamePacketHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    size_t packet_len = sizeof(header) + header.size;
+    if (packet_len > static_cast<size_t>(len) || packet_len < sizeof(header) + sizeof(DashFactionJoinReqPacketExt)) {
+        return false;
+    }
+    DashFactionJoinReqPacketExt ext_data;
+    std::memcpy(&ext_data, static_cast<const std::byte*>(data) + packet_len - sizeof(ext_data), sizeof(ext_data));
+    if (ext_data.df_signature != DASH_FACTION_SIGNATURE) {
+        return false;
+    }
+    std::erase_if(g_pending_join_requests, [&](const auto& req) { return req.addr == addr; });
+    // Join requests that were denied are never removed so limit the number of remembered requests
+    constexpr size_t max_pending_join_requests = 32;
+    if (g_pending_join_requests.size() >= max_pending_join_requests) {
+        g_pending_join_requests.erase(g_pending_join_requests.begin());
+    }
+    g_pending_join_requests.push_back({addr, ext_data.flags});
+    return false;
+}
+
+static DashFactionJoinReqPacketExt::Flags take_pending_join_request_flags(const rf::NetAddr& addr)
+{
+    auto it = std::find_if(g_pending_join_requests.begin(), g_pending_join_requests.end(),
+        [&](const auto& req) { return req.addr == addr; });
+    if (it == g_pending_join_requests.end()) {
+        return DashFactionJoinReqPacketExt::Flags::none;
+    }
+    auto flags = it->flags;
+    g_pending_join_requests.erase(it);
+    return flags;
+}
+
 CallHook<int(const rf::NetAddr*, std::byte*, size_t)> send_join_req_packet_hook{
     0x0047ABFB,
     [](const rf::NetAddr* addr, std::byte* data, size_t len) {
-        // Add Dash Faction signature to join_req packet
-        auto [new_data, new_len] = extend_packet_with_df_signature(data, len);
-        return send_join_req_packet_hook.call_target(addr, new_data.get(), new_len);
+        // Add Dash Faction signature and supported features to join_req packet
+        DashFactionJoinReqPacketExt ext_data;
+        ext_data.flags |= DashFactionJoinReqPacketExt::Flags::obj_update_delta;
+        ext_data.flags |= DashFactionJoinReqPacketExt::Flags::batched_packets;
+        ext_data.flags |= DashFactionJoinReqPacketExt::Flags::reliable_channel;
+        return send_extended_packet(send_join_req_packet_hook, addr, data, len, ext_data);
     },
 };
 
@@ -696,11 +893,232 @@ CallHook<int(const rf::NetAddr*, std::byte*, size_t)> send_join_accept_packet_ho
             ext_data.flags |= DashFactionJoinAcceptPacketExt::Flags::max_fov;
             ext_data.max_fov = server_get_df_config().max_fov.value();
         }
-        auto [new_data, new_len] = extend_packet(data, len, ext_data);
-        return send_join_accept_packet_hook.call_target(addr, new_data.get(), new_len);
+        // Enable delta compression of obj_update packets if both sides support it
+        auto join_req_flags = take_pending_join_request_flags(*addr);
+        rf::Player* player = rf::multi_find_player_by_addr(*addr);
+        if (player && server_get_df_config().obj_update_delta_compression
+            && !!(join_req_flags & DashFactionJoinReqPacketExt::Flags::obj_update_delta)) {
+            get_player_additional_data(player).obj_update_encoder = std::make_unique<ObjUpdateDeltaEncoder>();
+        }
+        if (player && server_get_df_config().batch_unreliable_packets
+            && !!(join_req_flags & DashFactionJoinReqPacketExt::Flags::batched_packets)) {
+            get_player_additional_data(player).batched_packets = true;
+        }
+        if (player && server_get_df_config().reliable_channel
+            && !!(join_req_flags & DashFactionJoinReqPacketExt::Flags::reliable_channel)) {
+            get_player_additional_data(player).reliable_sender = std::make_unique<ReliableChannelSender>();
+        }
+        return send_extended_packet(send_join_accept_packet_hook, addr, data, len, ext_data);
     },
 };
 
+ObjUpdateDeltaDecoder g_obj_update_decoder;
+
+// Returns true if data consists of complete game packets processed by the client in multi_io_process_packets
+// Note: other packets (e.g. PF players packet sent to a server browser) must be sent in a separate datagram
+static bool is_batchable_packet_sequence(const std::byte* data, int len)
+{
+    int offset = 0;
+    while (len - offset >= static_cast<int>(sizeof(RF_GamePacketHeader))) {
+        RF_GamePacketHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        if (!g_client_side_packet_dispatch_table[header.type].allowed) {
+            return false;
+        }
+        offset += sizeof(header) + header.size;
+    }
+    return offset == len && len > 0;
+}
+
+FunHook<void(const rf::NetAddr&, const void*, int)> net_send_hook{
+    0x0052A080,
+    [](const rf::NetAddr& addr, const void* data, int len) {
+        // Unreliable packets sent to a client during a frame are combined into as few datagrams as possible
+        const auto* bytes = static_cast<const std::byte*>(data);
+        // Note: player is only searched for if batching is possible because net_send is called very often
+        bool can_batch = rf::is_server && server_get_df_config().batch_unreliable_packets &&
+            is_batchable_packet_sequence(bytes, len);
+        rf::Player* player = can_batch ? rf::multi_find_player_by_addr(addr) : nullptr;
+        if (player && get_player_additional_data(player).batched_packets) {
+            auto& pdata = get_player_additional_data(player);
+            if (pdata.unreliable_batch.size() + len > rf::max_packet_size) {
+                multi_flush_batched_packets(player);
+            }
+            pdata.unreliable_batch.insert(pdata.unreliable_batch.end(), bytes, bytes + len);
+            ++pdata.unreliable_batch_num_sends;
+            return;
+        }
+        network_stats_add_datagram(1);
+        net_send_hook.call_target(addr, data, len);
+    },
+};
+
+void multi_flush_batched_packets(rf::Player* player)
+{
+    auto& pdata = get_player_additional_data(player);
+    if (!pdata.unreliable_batch.empty()) {
+        network_stats_add_datagram(pdata.unreliable_batch_num_sends);
+        net_send_hook.call_target(player->net_data->addr, pdata.unreliable_batch.data(),
+            static_cast<int>(pdata.unreliable_batch.size()));
+        pdata.unreliable_batch.clear();
+        pdata.unreliable_batch_num_sends = 0;
+    }
+}
+
+static void flush_reliable_channel(rf::Player* player)
+{
+    auto& sender = get_player_additional_data(player).reliable_sender;
+    if (sender) {
+        const rf::NetAddr& addr = player->net_data->addr;
+        sender->flush(rf::timer_get_milliseconds(), [&](const std::byte* data, size_t len) {
+            // Note: DF packets are sent using rf::net_send so they are not counted by the stock stats code
+            network_stats_add_packet(player->net_data, df_reliable_data_packet_type, static_cast<int>(len), true);
+            rf::net_send(addr, data, static_cast<int>(len));
+        });
+    }
+}
+
+void multi_flush_all_batched_packets()
+{
+    auto player_list = SinglyLinkedList{rf::player_list};
+    for (auto& player : player_list) {
+        if (player.net_data) {
+            // Reliable channel data is sent using rf::net_send so it can be batched too
+            flush_reliable_channel(&player);
+            multi_flush_batched_packets(&player);
+        }
+    }
+}
+
+ReliableChannelReceiver g_reliable_channel_receiver;
+
+FunHook<void(rf::Player*)> multi_io_send_buffered_reliable_packets_hook{
+    0x004796C0,
+    [](rf::Player* player) {
+        if (rf::is_server && player && player->net_data) {
+            auto& sender = get_player_additional_data(player).reliable_sender;
+            auto& net_data = *player->net_data;
+            if (sender && net_data.reliable_buffer_size > 0) {
+                // All reliable packets (including ones buffered by the stock limbo handling and sent by
+                // multi_io_send_reliable_to_all) pass through this buffer so only the transport is replaced and the
+                // order of packets is kept
+                sender->queue(reinterpret_cast<const std::byte*>(net_data.reliable_buffer),
+                    static_cast<size_t>(net_data.reliable_buffer_size));
+                net_data.reliable_buffer_size = 0;
+            }
+            flush_reliable_channel(player);
+        }
+        multi_io_send_buffered_reliable_packets_hook.call_target(player);
+    },
+};
+
+static bool process_df_reliable_ack_packet(const void* data, int len, [[maybe_unused]] const rf::NetAddr& addr,
+    rf::Player* player)
+{
+    if (!player) {
+        return true;
+    }
+    auto& sender = get_player_additional_data(player).reliable_sender;
+    if (sender) {
+        sender->on_ack({static_cast<const std::byte*>(data), static_cast<size_t>(len)}, rf::timer_get_milliseconds());
+    }
+    return true;
+}
+
+static bool process_df_reliable_data_packet(const void* data, int len, const rf::NetAddr& addr, rf::Player* player)
+{
+    if (addr != rf::netgame.server_addr) {
+        return true;
+    }
+    RF_GamePacketHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    size_t packet_len = sizeof(header) + header.size;
+    if (packet_len > static_cast<size_t>(len)) {
+        return true;
+    }
+    // Game packets are processed in order in which they were sent by the server
+    ReliableChannelPacketBuilder ack_packet{df_reliable_ack_packet_type};
+    bool valid = g_reliable_channel_receiver.on_data({static_cast<const std::byte*>(data), packet_len},
+        [&](const std::byte* payload, size_t payload_len) {
+            rf::multi_io_process_packets(payload, payload_len, addr, player);
+        },
+        ack_packet);
+    if (valid) {
+        network_stats_add_packet(nullptr, df_reliable_ack_packet_type, static_cast<int>(ack_packet.size()), true);
+        rf::net_send(addr, ack_packet.data(), static_cast<int>(ack_packet.size()));
+    }
+    return true;
+}
+
+FunHook<void(rf::Player*, const void*, int)> multi_io_send_hook{
+    0x00479370,
+    [](rf::Player* player, const void* packet, int len) {
+        RF_GamePacketHeader header;
+        if (rf::is_server && player && len >= static_cast<int>(sizeof(header))) {
+            std::memcpy(&header, packet, sizeof(header));
+            auto& encoder = get_player_additional_data(player).obj_update_encoder;
+            if (header.type == obj_update && encoder) {
+                ObjUpdatePacketBuilder df_packet{df_obj_update_packet_type};
+                std::span stock_packet{static_cast<const std::byte*>(packet), static_cast<size_t>(len)};
+                if (encoder->encode(stock_packet, df_packet)) {
+                    multi_io_send_hook.call_target(player, df_packet.data(), static_cast<int>(df_packet.size()));
+                    return;
+                }
+            }
+        }
+        multi_io_send_hook.call_target(player, packet, len);
+    },
+};
+
+static bool process_df_obj_update_ack_packet(const void* data, int len, [[maybe_unused]] const rf::NetAddr& addr,
+    rf::Player* player)
+{
+    if (!player) {
+        return true;
+    }
+    RF_GamePacketHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    size_t packet_len = sizeof(header) + header.size;
+    if (packet_len > static_cast<size_t>(len)) {
+        return true;
+    }
+    auto& encoder = get_player_additional_data(player).obj_update_encoder;
+    if (encoder) {
+        uint16_t sequence;
+        std::memcpy(&sequence, static_cast<const std::byte*>(data) + sizeof(RF_GamePacketHeader), sizeof(sequence));
+        encoder->on_ack(sequence);
+    }
+    return true;
+}
+
+static bool process_df_obj_update_packet(const void* data, int len, const rf::NetAddr& addr, rf::Player* player)
+{
+    if (addr != rf::netgame.server_addr) {
+        return true;
+    }
+    RF_GamePacketHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    size_t packet_len = sizeof(header) + header.size;
+    if (packet_len > static_cast<size_t>(len)) {
+        return true;
+    }
+    // Convert the packet back to stock obj_update packet and let the game process it
+    ObjUpdatePacketBuilder stock_packet{obj_update};
+    auto sequence = g_obj_update_decoder.decode({static_cast<const std::byte*>(data), packet_len}, stock_packet);
+    if (!sequence) {
+        xlog::warn("Malformed DF obj_update packet");
+        return true;
+    }
+    rf::multi_io_process_packets(stock_packet.data(), stock_packet.size(), addr, player);
+
+    DfPacketBuilder ack_packet{df_obj_update_ack_packet_type};
+    ack_packet.append(sequence.value());
+    ack_packet.patch_header();
+    network_stats_add_packet(nullptr, df_obj_update_ack_packet_type, static_cast<int>(ack_packet.size()), true);
+    rf::net_send(addr, ack_packet.data(), static_cast<int>(ack_packet.size()));
+    return true;
+}
+
 CodeInjection process_join_accept_injection{
     0x0047A979,
     [](auto& regs) {
@@ -890,6 +1308,8 @@ FunHook<void()> multi_stop_hook{
     []() {
         // Clear server info when leaving
         g_df_server_info.reset();
+        g_obj_update_decoder.reset();
+        g_reliable_channel_receiver.reset();
         multi_stop_hook.call_target();
         if (rf::local_player) {
             reset_player_additional_data(rf::local_player);
@@ -1014,6 +1434,11 @@ extern FunHook<void __fastcall(void*, int, int, bool, int)> multi_io_stats_add_h
 
 void __fastcall multi_io_stats_add_new(void *this_, int edx, int size, bool is_send, int packet_type)
 {
+    // Stock code keeps stats only in PlayerNetData so the owner is found without searching the player list
+    auto* net_data = reinterpret_cast<rf::PlayerNetData*>(
+        static_cast<std::byte*>(this_) - offsetof(rf::PlayerNetData, stats));
+    network_stats_add_packet(net_data, packet_type, size, is_send);
+
     // Fix memory corruption when sending/processing packets with non-standard type
     if (packet_type < 56) {
         multi_io_stats_add_hook.call_target(this_, edx, size, is_send, packet_type);
@@ -1022,26 +1447,47 @@ void __fastcall multi_io_stats_add_new(void *this_, int edx, int size, bool is_s
 
 FunHook<void __fastcall(void*, int, int, bool, int)> multi_io_stats_add_hook{0x0047CAC0, multi_io_stats_add_new};
 
-static void process_custom_packet([[maybe_unused]] void* data, [[maybe_unused]] int len,
-                                  [[maybe_unused]] const rf::NetAddr& addr, [[maybe_unused]] rf::Player* player)
-{
-    pf_process_packet(data, len, addr, player);
-}
-
 CodeInjection multi_io_process_packets_injection{
     0x0047918D,
     [](auto& regs) {
-        int packet_type = regs.esi;
-        if (packet_type > 0x37 || packet_type == static_cast<int>(pf_packet_type::player_stats)) {
+        auto packet_type = static_cast<uint8_t>(regs.esi);
+        std::byte* data = regs.ecx;
+        int offset = regs.ebp;
+        RF_GamePacketHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+
+        // Filter packets based on the side (client-side vs server-side)
+        auto& dispatch_table = rf::is_server ? g_server_side_packet_dispatch_table : g_client_side_packet_dispatch_table;
+        const auto* slot = dispatch_table.dispatch(packet_type, header.size);
+        if (!slot) {
+            xlog::warn("Ignoring packet 0x{:x}", packet_type);
+            network_stats_end_handler();
+            regs.eip = 0x00479194;
+            return;
+        }
+
+        // Handler time is measured until the next packet is processed or multi_io_process_packets returns
+        network_stats_begin_handler(packet_type);
+        if (slot->handler) {
             auto stack_frame = regs.esp + 0x1C;
-            std::byte* data = regs.ecx;
-            int offset = regs.ebp;
             int len = regs.edi;
             auto& addr = *addr_as_ref<rf::NetAddr*>(stack_frame + 0xC);
             auto player = addr_as_ref<rf::Player*>(stack_frame + 0x10);
-            process_custom_packet(data + offset, len, addr, player);
-            regs.eip = 0x00479194;
+            if (slot->handler(data + offset, len, addr, player)) {
+                network_stats_end_handler();
+                regs.eip = 0x00479194;
+                return;
+            }
         }
+        xlog::trace("Processing packet 0x{:x}", packet_type);
+    },
+};
+
+FunHook<rf::MultiIoProcessPackets_Type> multi_io_process_packets_hook{
+    0x004790D0,
+    [](const void* data, size_t len, const rf::NetAddr& addr, rf::Player* player) {
+        multi_io_process_packets_hook.call_target(data, len, addr, player);
+        network_stats_end_handler();
     },
 };
 
@@ -1076,6 +1522,356 @@ CallHook<int()> game_info_num_players_hook{
     },
 };
 
+#ifdef DEBUG
+
+#define ok(expr) if (!(expr)) xlog::error("Test failed: {}", #expr)
+
+static void test_packet_builder()
+{
+    PacketBuilder<8> builder{0x50};
+    ok(builder.size() == sizeof(RF_GamePacketHeader));
+    ok(builder.append<uint16_t>(0x1234));
+    ok(builder.append<uint8_t>(0x56));
+    ok(builder.patch<uint8_t>(3, 0x78));
+    ok(!builder.patch<uint16_t>(5, 0));
+    builder.patch_header();
+    RF_GamePacketHeader header;
+    std::memcpy(&header, builder.data(), sizeof(header));
+    ok(header.type == 0x50);
+    ok(header.size == sizeof(uint16_t) + sizeof(uint8_t));
+    ok(builder.data()[3] == std::byte{0x78});
+    ok(!builder.overflow());
+
+    // Data that does not fit is not appended and the builder stays in the overflow state
+    ok(builder.append<uint16_t>(0));
+    ok(!builder.append<uint8_t>(0));
+    ok(builder.overflow());
+    ok(builder.size() == 8);
+    ok(!builder.append<uint8_t>(0));
+    ok(!builder.patch<uint8_t>(3, 0));
+
+    std::array<std::byte, 9> too_long{};
+    ok(PacketBuilder<8>(too_long.data(), too_long.size()).overflow());
+    ok(PacketBuilder<8>(too_long.data(), 2).overflow());
+    PacketBuilder<8> copy{builder.data(), 5};
+    ok(!copy.overflow() && copy.size() == 5);
+    copy.patch_header();
+    std::memcpy(&header, copy.data(), sizeof(header));
+    ok(header.size == 2);
+}
+
+static void test_obj_update_codec()
+{
+    auto make_stock_packet = [](const ObjUpdatePosRot& state) {
+        ObjUpdatePacketBuilder packet{obj_update};
+        packet.append<uint32_t>(1);
+        packet.append<uint8_t>(0x21); // pos_rot_anim | health_armor
+        packet.append(state.ticks);
+        packet.append(state.pos);
+        packet.append(state.angle_x);
+        packet.append(state.angle_y);
+        packet.append(state.move);
+        packet.append(std::array<uint8_t, 3>{100, 50, 0});
+        packet.append<uint32_t>(2);
+        packet.append<uint8_t>(0x04); // weapon_type
+        packet.append<uint8_t>(7);
+        packet.append<uint32_t>(0xFFFFFFFF);
+        packet.patch_header();
+        return packet;
+    };
+    auto as_span = [](const ObjUpdatePacketBuilder& packet) {
+        return std::span{packet.data(), packet.size()};
+    };
+    auto equals = [](const ObjUpdatePacketBuilder& a, const ObjUpdatePacketBuilder& b) {
+        return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+    };
+
+    ObjUpdateDeltaEncoder encoder;
+    ObjUpdateDeltaDecoder decoder;
+    ObjUpdatePosRot state{100, {1.0f, 2.0f, 3.0f}, 10, 20, {1, 2, 3, 4}};
+
+    // First packet has no baseline so it is sent in full
+    auto stock1 = make_stock_packet(state);
+    ObjUpdatePacketBuilder df1{df_obj_update_packet_type};
+    ok(encoder.encode(as_span(stock1), df1));
+    ObjUpdatePacketBuilder decoded1{obj_update};
+    auto seq1 = decoder.decode(as_span(df1), decoded1);
+    ok(seq1 == std::optional<uint16_t>{0});
+    ok(equals(decoded1, stock1));
+    encoder.on_ack(seq1.value());
+
+    // Next packet is encoded as a difference from the acknowledged one
+    state.ticks = 110;
+    state.pos[0] = 1.5f;
+    state.angle_x = 12;
+    auto stock2 = make_stock_packet(state);
+    ObjUpdatePacketBuilder df2{df_obj_update_packet_type};
+    ok(encoder.encode(as_span(stock2), df2));
+    ok(df2.size() < df1.size());
+    ObjUpdatePacketBuilder decoded2{obj_update};
+    ok(decoder.decode(as_span(df2), decoded2) == std::optional<uint16_t>{1});
+    ok(equals(decoded2, stock2));
+
+    // Acknowledgement of the previous packet was lost so the next one still uses the first packet as a baseline
+    state.pos[1] = -2.25f;
+    auto stock3 = make_stock_packet(state);
+    ObjUpdatePacketBuilder df3{df_obj_update_packet_type};
+    ok(encoder.encode(as_span(stock3), df3));
+    ObjUpdatePacketBuilder decoded3{obj_update};
+    ok(decoder.decode(as_span(df3), decoded3) == std::optional<uint16_t>{2});
+    ok(equals(decoded3, stock3));
+
+    // Entity with unknown baseline is skipped and other entities are still decoded
+    ObjUpdateDeltaDecoder fresh_decoder;
+    ObjUpdatePacketBuilder decoded_no_baseline{obj_update};
+    ok(fresh_decoder.decode(as_span(df3), decoded_no_baseline).has_value());
+    ok(decoded_no_baseline.size() == sizeof(RF_GamePacketHeader) + 4 + 1 + 1 + 4);
+
+    // Malformed packets are rejected
+    ObjUpdatePacketBuilder truncated{df3.data(), df3.size() - 1};
+    truncated.patch_header();
+    ObjUpdatePacketBuilder decoded_truncated{obj_update};
+    ok(!decoder.decode(as_span(truncated), decoded_truncated));
+    ObjUpdatePacketBuilder trailing{stock3.data(), stock3.size()};
+    trailing.append<uint8_t>(0);
+    trailing.patch_header();
+    ObjUpdatePacketBuilder df_trailing{df_obj_update_packet_type};
+    ok(!encoder.encode(as_span(trailing), df_trailing));
+}
+
+static void test_packet_dispatch()
+{
+    struct Route
+    {
+        uint8_t type;
+        CustomPacketHandler* handler = nullptr;
+    };
+    // Stock packets without a Dash Faction handler are processed by game code
+    const std::vector<Route> client_to_server{
+        {game_info_request, process_game_info_request_packet},
+        {join_request, process_join_request_packet},
+        {left_game},
+        {state_info_request},
+        {client_in_game},
+        {chat_line},
+        {name_change},
+        {respawn_request},
+        {use_key_pressed},
+        {suicide},
+        {team_change},
+        {pong},
+        {rate_change},
+        {select_weapon_request},
+        {obj_update},
+        {reload_request},
+        {weapon_fire},
+        {fall_damage},
+        {rcon_request},
+        {rcon},
+        {pf_type(pf_packet_type::player_stats), process_custom_packet},
+        {df_obj_update_ack_packet_type, process_df_obj_update_ack_packet},
+        {df_reliable_ack_packet_type, process_df_reliable_ack_packet},
+    };
+    const std::vector<Route> server_to_client{
+        {game_info},
+        {join_accept},
+        {join_deny},
+        {new_player},
+        {players},
+        {left_game},
+        {end_game},
+        {state_info_done},
+        {chat_line},
+        {name_change},
+        {trigger_activate},
+        {pregame_boolean},
+        {pregame_glass},
+        {pregame_remote_charge},
+        {enter_limbo},
+        {leave_limbo},
+        {team_change},
+        {ping},
+        {netgame_update},
+        {rate_change},
+        {clutter_udate},
+        {clutter_kill},
+        {ctf_flag_pick_up},
+        {ctf_flag_capture},
+        {ctf_flag_update},
+        {ctf_flag_return},
+        {ctf_flag_drop},
+        {remote_charge_kill},
+        {item_update},
+        {obj_update},
+        {obj_kill},
+        {item_apply},
+        {boolean_},
+        {respawn},
+        {entity_create},
+        {item_create},
+        {reload},
+        {weapon_fire},
+        {sound},
+        {team_score},
+        {glass_kill},
+        {pf_type(pf_packet_type::player_stats), process_custom_packet},
+        {df_obj_update_packet_type, process_df_obj_update_packet},
+        {df_reliable_data_packet_type, process_df_reliable_data_packet},
+    };
+    // Note: tables are copied so counters of the real ones are not changed
+    auto check_routes = [](PacketDispatchTable<CustomPacketHandler> table, const std::vector<Route>& routes) {
+        for (std::size_t type = 0; type < table.num_slots; ++type) {
+            auto it = std::find_if(routes.begin(), routes.end(), [=](const Route& route) {
+                return route.type == type;
+            });
+            const auto* slot = table.dispatch(static_cast<uint8_t>(type), UINT16_MAX);
+            if (it != routes.end()) {
+                ok(slot && slot->handler == it->handler);
+            }
+            else if (type >= first_custom_packet_type) {
+                // Types not used by the game are passed to PF code
+                ok(slot && slot->handler == process_custom_packet);
+            }
+            else {
+                // Stock packets sent in the other direction are rejected
+                ok(!slot);
+            }
+        }
+    };
+    check_routes(g_server_side_packet_dispatch_table, client_to_server);
+    check_routes(g_client_side_packet_dispatch_table, server_to_client);
+
+    // Packets too short for fields read by Dash Faction hooks are rejected
+    auto server_table = g_server_side_packet_dispatch_table;
+    ok(!server_table.dispatch(reload_request, 3));
+    ok(server_table.dispatch(reload_request, 4));
+    ok(!server_table.dispatch(df_reliable_ack_packet_type, sizeof(uint16_t)));
+    ok(!server_table.dispatch(entity_create, 0));
+    ok(server_table[reload_request].num_processed == 1 && server_table[reload_request].num_rejected == 1);
+    ok(server_table[entity_create].num_rejected == 1);
+    auto client_table = g_client_side_packet_dispatch_table;
+    ok(!client_table.dispatch(reload, 15));
+    ok(!client_table.dispatch(df_obj_update_packet_type, sizeof(uint16_t)));
+    ok(client_table.dispatch(df_obj_update_packet_type, sizeof(uint16_t) + sizeof(uint8_t)));
+}
+
+static void test_reliable_channel()
+{
+    // Deterministic lossy link that drops, duplicates and reorders packets in both directions
+    struct InFlightPacket
+    {
+        int arrival_ms;
+        std::vector<std::byte> data;
+    };
+    unsigned seed = 12345;
+    auto next_random = [&]() {
+        seed = seed * 1664525 + 1013904223;
+        return seed >> 16;
+    };
+    int num_dropped = 0;
+    int num_duplicated = 0;
+    auto transmit = [&](std::vector<InFlightPacket>& link, const std::byte* data, std::size_t len, int now_ms) {
+        if (next_random() % 5 == 0) {
+            ++num_dropped;
+            return;
+        }
+        int num_copies = next_random() % 10 == 0 ? 2 : 1;
+        num_duplicated += num_copies - 1;
+        for (int i = 0; i < num_copies; ++i) {
+            link.push_back({now_ms + 20 + static_cast<int>(next_random() % 60), {data, data + len}});
+        }
+    };
+    // Packets are received in order of arrival time so random delays reorder them
+    auto receive = [](std::vector<InFlightPacket>& link, int now_ms, auto fun) {
+        std::stable_sort(link.begin(), link.end(), [](auto& a, auto& b) { return a.arrival_ms < b.arrival_ms; });
+        auto end = std::find_if(link.begin(), link.end(), [=](auto& p) { return p.arrival_ms > now_ms; });
+        std::vector<InFlightPacket> arrived{std::make_move_iterator(link.begin()), std::make_move_iterator(end)};
+        link.erase(link.begin(), end);
+        for (auto& packet : arrived) {
+            fun(std::span<const std::byte>{packet.data});
+        }
+    };
+
+    // Game packets of various sizes including ones that must be split into multiple fragments
+    std::vector<std::vector<std::byte>> sent;
+    for (int i = 0; i < 300; ++i) {
+        std::size_t size = i % 25 == 0 ? 1500 + i : 3 + next_random() % 120;
+        RF_GamePacketHeader header{static_cast<uint8_t>(i), static_cast<uint16_t>(size)};
+        std::vector<std::byte> packet(sizeof(header) + size);
+        std::memcpy(packet.data(), &header, sizeof(header));
+        for (std::size_t j = sizeof(header); j < packet.size(); ++j) {
+            packet[j] = static_cast<std::byte>(i + j);
+        }
+        sent.push_back(std::move(packet));
+    }
+
+    ReliableChannelSender sender;
+    ReliableChannelReceiver receiver;
+    std::vector<InFlightPacket> data_link;
+    std::vector<InFlightPacket> ack_link;
+    std::vector<std::vector<std::byte>> delivered;
+    std::size_t num_queued = 0;
+    int num_data_packets = 0;
+    int num_reordered = 0;
+    uint16_t max_received_sequence = 0;
+    int now_ms = 0;
+    for (; now_ms < 60000; now_ms += 10) {
+        // Game queues a few packets every frame
+        for (int i = 0; i < 3 && num_queued < sent.size(); ++i, ++num_queued) {
+            sender.queue(sent[num_queued].data(), sent[num_queued].size());
+        }
+        sender.flush(now_ms, [&](const std::byte* data, std::size_t len) {
+            ok(len <= reliable_channel_max_packet_size);
+            ++num_data_packets;
+            transmit(data_link, data, len, now_ms);
+        });
+        receive(data_link, now_ms, [&](std::span<const std::byte> packet) {
+            uint16_t sequence;
+            std::memcpy(&sequence, packet.data() + sizeof(RF_GamePacketHeader), sizeof(sequence));
+            num_reordered += sequence < max_received_sequence;
+            max_received_sequence = std::max(max_received_sequence, sequence);
+            ReliableChannelPacketBuilder ack{df_reliable_ack_packet_type};
+            // Delivered data can contain multiple game packets like data passed to multi_io_process_packets
+            ok(receiver.on_data(packet, [&](const std::byte* data, std::size_t len) {
+                std::size_t offset = 0;
+                while (offset + sizeof(RF_GamePacketHeader) <= len) {
+                    RF_GamePacketHeader header;
+                    std::memcpy(&header, data + offset, sizeof(header));
+                    std::size_t packet_len = std::min(sizeof(header) + header.size, len - offset);
+                    delivered.emplace_back(data + offset, data + offset + packet_len);
+                    offset += packet_len;
+                }
+                ok(offset == len);
+            }, ack));
+            transmit(ack_link, ack.data(), ack.size(), now_ms);
+        });
+        receive(ack_link, now_ms, [&](std::span<const std::byte> packet) {
+            ok(sender.on_ack(packet, now_ms));
+        });
+        if (num_queued == sent.size() && sender.idle()) {
+            break;
+        }
+    }
+
+    // Every game packet is delivered exactly once and in order
+    ok(sender.idle());
+    ok(delivered == sent);
+    ok(num_dropped > 0);
+    ok(num_duplicated > 0);
+    ok(num_reordered > 0);
+    ok(sender.num_retransmits() > 0);
+    // Small game packets are packed together
+    ok(num_data_packets < static_cast<int>(sent.size()));
+
+    // Malformed packets are rejected
+    std::array<std::byte, 4> short_packet{};
+    ReliableChannelPacketBuilder ack{df_reliable_ack_packet_type};
+    ok(!receiver.on_data(short_packet, [](const std::byte*, std::size_t) {}, ack));
+    ok(!sender.on_ack(short_packet, now_ms));
+}
+
+#endif // DEBUG
+
 void network_init()
 {
     // Improve simultaneous ping
@@ -1108,9 +1904,6 @@ void network_init()
         patch.install();
     }
 
-    //  Filter packets based on the side (client-side vs server-side)
-    process_game_packet_whitelist_filter.install();
-
     // Hook packet handlers
     process_join_deny_packet_hook.install();
     process_new_player_packet_hook.install();
@@ -1180,6 +1973,15 @@ void network_init()
     process_join_accept_send_game_info_req_injection.install();
     multi_stop_hook.install();
 
+    // Delta compression of obj_update packets
+    multi_io_send_hook.install();
+
+    // Combine unreliable packets sent to Dash Faction clients during a frame
+    net_send_hook.install();
+
+    // Send reliable packets to Dash Faction clients using DF reliable channel
+    multi_io_send_buffered_reliable_packets_hook.install();
+
     // Use port 7755 when hosting a server without 'Force port' option
     multi_start_hook.install();
 
@@ -1219,6 +2021,10 @@ void network_init()
     AsmWriter{0x0047916D}.nop(2);
     multi_io_process_packets_injection.install();
     multi_io_stats_add_hook.install();
+
+    // Collect per-packet-type and per-player network stats
+    multi_io_process_packets_hook.install();
+    network_stats_init();
     process_unreliable_game_packets_hook.install();
 
     // Fix rejecting reliable packets from non-connected clients
@@ -1228,4 +2034,11 @@ void network_init()
 
     // Ignore browsers when calculating player count for info requests
     game_info_num_players_hook.install();
+
+#ifdef DEBUG
+    test_packet_builder();
+    test_obj_update_codec();
+    test_reliable_channel();
+    test_packet_dispatch();
+#endif
 }
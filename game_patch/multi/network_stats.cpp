@@ -0,0 +1,405 @@
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <common/utils/list-utils.h>
+#include <xlog/xlog.h>
+#include "network_stats.h"
+#include "obj_update_codec.h"
+#include "reliable_channel.h"
+#include "server_internal.h"
+#include "../os/console.h"
+#include "../rf/multi.h"
+#include "../rf/player/player.h"
+#include "../rf/os/timer.h"
+
+// Counters are only updated by the main thread but they are atomic so they can be safely read from any thread
+struct TrafficCounters
+{
+    std::atomic<uint64_t> bytes_sent{0};
+    std::atomic<uint64_t> bytes_recvd{0};
+    std::atomic<uint32_t> packets_sent{0};
+    std::atomic<uint32_t> packets_recvd{0};
+
+    void add(int size, bool is_send)
+    {
+        if (is_send) {
+            bytes_sent.fetch_add(size, std::memory_order_relaxed);
+            packets_sent.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            bytes_recvd.fetch_add(size, std::memory_order_relaxed);
+            packets_recvd.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void reset()
+    {
+        bytes_sent = 0;
+        bytes_recvd = 0;
+        packets_sent = 0;
+        packets_recvd = 0;
+    }
+};
+
+struct PacketTypeCounters : TrafficCounters
+{
+    std::atomic<uint64_t> handler_time_us{0};
+    std::atomic<uint32_t> handler_calls{0};
+
+    void reset()
+    {
+        TrafficCounters::reset();
+        handler_time_us = 0;
+        handler_calls = 0;
+    }
+};
+
+struct PlayerCounters : TrafficCounters
+{
+    // Used to detect that player ID has been reused by a new player
+    int join_time_ms = 0;
+};
+
+// Indexed by packet type
+static std::array<PacketTypeCounters, 256> g_packet_type_stats;
+// Indexed by player ID
+static std::array<PlayerCounters, 256> g_player_stats;
+static int g_stats_start_time_ms = 0;
+static int g_handler_packet_type = -1;
+static int g_handler_start_time_us = 0;
+static rf::TimestampRealtime g_dump_timestamp;
+// Unreliable sends requested by the game (rf::net_send calls) and datagrams actually passed to the socket. The
+// difference is caused by batching of packets sent to a single client during a frame.
+static std::atomic<uint32_t> g_num_send_calls{0};
+static std::atomic<uint32_t> g_num_datagrams{0};
+static std::atomic<uint32_t> g_num_frames{0};
+
+static const char* const g_packet_type_names[] = {
+    "game_info_request",
+    "game_info",
+    "join_request",
+    "join_accept",
+    "join_deny",
+    "new_player",
+    "players",
+    "left_game",
+    "end_game",
+    "state_info_request",
+    "state_info_done",
+    "client_in_game",
+    "chat_line",
+    "name_change",
+    "respawn_request",
+    "trigger_activate",
+    "use_key_pressed",
+    "pregame_boolean",
+    "pregame_glass",
+    "pregame_remote_charge",
+    "suicide",
+    "enter_limbo",
+    "leave_limbo",
+    "team_change",
+    "ping",
+    "pong",
+    "netgame_update",
+    "rate_change",
+    "select_weapon_request",
+    "clutter_update",
+    "clutter_kill",
+    "ctf_flag_pick_up",
+    "ctf_flag_capture",
+    "ctf_flag_update",
+    "ctf_flag_return",
+    "ctf_flag_drop",
+    "remote_charge_kill",
+    "item_update",
+    "obj_update",
+    "obj_kill",
+    "item_apply",
+    "boolean",
+    "mover_update",
+    "respawn",
+    "entity_create",
+    "item_create",
+    "reload",
+    "reload_request",
+    "weapon_fire",
+    "fall_damage",
+    "rcon_request",
+    "rcon",
+    "sound",
+    "team_score",
+    "glass_kill",
+};
+
+static std::string get_packet_type_name(int packet_type)
+{
+    if (packet_type < static_cast<int>(std::size(g_packet_type_names))) {
+        return g_packet_type_names[packet_type];
+    }
+    if (packet_type == df_obj_update_packet_type) {
+        return "df_obj_update";
+    }
+    if (packet_type == df_obj_update_ack_packet_type) {
+        return "df_obj_update_ack";
+    }
+    if (packet_type == df_reliable_data_packet_type) {
+        return "df_reliable_data";
+    }
+    if (packet_type == df_reliable_ack_packet_type) {
+        return "df_reliable_ack";
+    }
+    return std::format("custom_{:02x}", packet_type);
+}
+
+void network_stats_add_packet(const rf::PlayerNetData* net_data, int packet_type, int size, bool is_send)
+{
+    g_packet_type_stats[packet_type & 0xFF].add(size, is_send);
+    if (net_data) {
+        auto& player_stats = g_player_stats[net_data->player_id];
+        if (player_stats.join_time_ms != net_data->join_time_ms) {
+            player_stats.reset();
+            player_stats.join_time_ms = net_data->join_time_ms;
+        }
+        player_stats.add(size, is_send);
+    }
+}
+
+void network_stats_add_datagram(int num_send_calls)
+{
+    g_num_send_calls.fetch_add(num_send_calls, std::memory_order_relaxed);
+    g_num_datagrams.fetch_add(1, std::memory_order_relaxed);
+}
+
+void network_stats_begin_handler(int packet_type)
+{
+    network_stats_end_handler();
+    g_handler_packet_type = packet_type & 0xFF;
+    g_handler_start_time_us = rf::timer_get_microseconds();
+}
+
+void network_stats_end_handler()
+{
+    if (g_handler_packet_type >= 0) {
+        auto& stats = g_packet_type_stats[g_handler_packet_type];
+        unsigned duration_us = rf::timer_get_microseconds() - g_handler_start_time_us;
+        stats.handler_time_us.fetch_add(duration_us, std::memory_order_relaxed);
+        stats.handler_calls.fetch_add(1, std::memory_order_relaxed);
+        g_handler_packet_type = -1;
+    }
+}
+
+static void network_stats_reset()
+{
+    for (auto& stats : g_packet_type_stats) {
+        stats.reset();
+    }
+    for (auto& stats : g_player_stats) {
+        stats.reset();
+    }
+    g_num_send_calls = 0;
+    g_num_datagrams = 0;
+    g_num_frames = 0;
+    g_stats_start_time_ms = rf::timer_get_milliseconds();
+}
+
+static float get_elapsed_seconds()
+{
+    int elapsed_ms = rf::timer_get_milliseconds() - g_stats_start_time_ms;
+    return std::max(elapsed_ms, 1) / 1000.0f;
+}
+
+static bool is_packet_type_used(const PacketTypeCounters& stats)
+{
+    return stats.packets_sent > 0 || stats.packets_recvd > 0;
+}
+
+template<typename F>
+static void for_each_player_with_stats(F&& callback)
+{
+    auto player_list = SinglyLinkedList{rf::player_list};
+    for (auto& player : player_list) {
+        if (!player.net_data) {
+            continue;
+        }
+        const auto& stats = g_player_stats[player.net_data->player_id];
+        if (stats.join_time_ms == player.net_data->join_time_ms) {
+            callback(player, stats);
+        }
+    }
+}
+
+static void network_stats_dump_csv(const std::string& filename)
+{
+    bool write_header = !std::ifstream{filename}.good();
+    std::ofstream file{filename, std::ios_base::out | std::ios_base::app};
+    if (!file) {
+        xlog::warn("Failed to open network stats file {}", filename);
+        return;
+    }
+    if (write_header) {
+        file << "time;scope;id;name;bytes sent;bytes recvd;packets sent;packets recvd;handler calls;handler time us\n";
+    }
+    int time_s = rf::timer_get_seconds();
+    for (unsigned i = 0; i < g_packet_type_stats.size(); ++i) {
+        const auto& stats = g_packet_type_stats[i];
+        if (is_packet_type_used(stats)) {
+            file << time_s << ";type;" << i << ';' << get_packet_type_name(i) << ';'
+                << stats.bytes_sent << ';' << stats.bytes_recvd << ';'
+                << stats.packets_sent << ';' << stats.packets_recvd << ';'
+                << stats.handler_calls << ';' << stats.handler_time_us << '\n';
+        }
+    }
+    for_each_player_with_stats([&](rf::Player& player, const PlayerCounters& stats) {
+        file << time_s << ";player;" << static_cast<int>(player.net_data->player_id) << ';' << player.name.c_str()
+            << ';' << stats.bytes_sent << ';' << stats.bytes_recvd << ';'
+            << stats.packets_sent << ';' << stats.packets_recvd << ";;\n";
+    });
+}
+
+static std::string escape_json_string(const char* str)
+{
+    std::string result;
+    for (const char* p = str; *p; ++p) {
+        auto c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += static_cast<char>(c);
+        }
+        else if (c < 0x20) {
+            result += std::format("\\u{:04x}", c);
+        }
+        else {
+            result += static_cast<char>(c);
+        }
+    }
+    return result;
+}
+
+static void network_stats_dump_json(const std::string& filename)
+{
+    std::ofstream file{filename, std::ios_base::out | std::ios_base::trunc};
+    if (!file) {
+        xlog::warn("Failed to open network stats file {}", filename);
+        return;
+    }
+    file << "{\n  \"time\": " << rf::timer_get_seconds() << ",\n  \"elapsed\": " << get_elapsed_seconds()
+        << ",\n  \"packet_types\": [";
+    const char* sep = "\n";
+    for (unsigned i = 0; i < g_packet_type_stats.size(); ++i) {
+        const auto& stats = g_packet_type_stats[i];
+        if (is_packet_type_used(stats)) {
+            file << sep << "    {\"type\": " << i << ", \"name\": \"" << get_packet_type_name(i)
+                << "\", \"bytes_sent\": " << stats.bytes_sent << ", \"bytes_recvd\": " << stats.bytes_recvd
+                << ", \"packets_sent\": " << stats.packets_sent << ", \"packets_recvd\": " << stats.packets_recvd
+                << ", \"handler_calls\": " << stats.handler_calls
+                << ", \"handler_time_us\": " << stats.handler_time_us << "}";
+            sep = ",\n";
+        }
+    }
+    file << "\n  ],\n  \"frames\": " << g_num_frames << ",\n  \"send_calls\": " << g_num_send_calls
+        << ",\n  \"datagrams\": " << g_num_datagrams << ",\n  \"players\": [";
+    sep = "\n";
+    for_each_player_with_stats([&](rf::Player& player, const PlayerCounters& stats) {
+        file << sep << "    {\"id\": " << static_cast<int>(player.net_data->player_id) << ", \"name\": \""
+            << escape_json_string(player.name.c_str()) << "\", \"bytes_sent\": " << stats.bytes_sent
+            << ", \"bytes_recvd\": " << stats.bytes_recvd << ", \"packets_sent\": " << stats.packets_sent
+            << ", \"packets_recvd\": " << stats.packets_recvd << "}";
+        sep = ",\n";
+    });
+    file << "\n  ]\n}\n";
+}
+
+static void network_stats_dump(bool json)
+{
+    if (json) {
+        network_stats_dump_json("logs/network_stats.json");
+    }
+    else {
+        network_stats_dump_csv("logs/network_stats.csv");
+    }
+}
+
+static void network_stats_print()
+{
+    float elapsed = get_elapsed_seconds();
+    rf::console::print("Network stats for the last {:.0f} seconds:", elapsed);
+
+    std::array<int, 256> sorted_types;
+    for (unsigned i = 0; i < sorted_types.size(); ++i) {
+        sorted_types[i] = i;
+    }
+    // Sort packet types by uplink usage
+    std::sort(sorted_types.begin(), sorted_types.end(), [](int a, int b) {
+        return g_packet_type_stats[a].bytes_sent > g_packet_type_stats[b].bytes_sent;
+    });
+    for (int type : sorted_types) {
+        const auto& stats = g_packet_type_stats[type];
+        if (!is_packet_type_used(stats)) {
+            continue;
+        }
+        uint32_t handler_calls = stats.handler_calls;
+        uint64_t handler_avg_us = handler_calls ? stats.handler_time_us / handler_calls : 0;
+        rf::console::print("{:02x} {}: sent {} B/s ({} pkt/s), recvd {} B/s ({} pkt/s), handler avg {} us",
+            type, get_packet_type_name(type), static_cast<int>(stats.bytes_sent / elapsed),
+            static_cast<int>(stats.packets_sent / elapsed), static_cast<int>(stats.bytes_recvd / elapsed),
+            static_cast<int>(stats.packets_recvd / elapsed), handler_avg_us);
+    }
+    float frames = std::max<uint32_t>(g_num_frames, 1);
+    rf::console::print("Unreliable sends: {:.1f} calls/frame, {:.1f} datagrams/frame", g_num_send_calls / frames,
+        g_num_datagrams / frames);
+    for_each_player_with_stats([=](rf::Player& player, const PlayerCounters& stats) {
+        rf::console::print("{}: sent {} B/s ({} pkt/s), recvd {} B/s ({} pkt/s)", player.name,
+            static_cast<int>(stats.bytes_sent / elapsed), static_cast<int>(stats.packets_sent / elapsed),
+            static_cast<int>(stats.bytes_recvd / elapsed), static_cast<int>(stats.packets_recvd / elapsed));
+    });
+}
+
+ConsoleCommand2 net_stats_cmd{
+    "net_stats",
+    [](std::optional<std::string> action) {
+        if (!action) {
+            network_stats_print();
+        }
+        else if (action.value() == "reset") {
+            network_stats_reset();
+            rf::console::print("Network stats have been reset");
+        }
+        else if (action.value() == "csv" || action.value() == "json") {
+            network_stats_dump(action.value() == "json");
+            rf::console::print("Network stats have been saved in logs directory");
+        }
+        else {
+            rf::console::print("Unknown action: {}", action.value());
+        }
+    },
+    "Shows network traffic per packet type and per player",
+    "net_stats [reset|csv|json]",
+};
+
+void network_stats_do_frame()
+{
+    g_num_frames.fetch_add(1, std::memory_order_relaxed);
+    const auto& dump_config = server_get_df_config().network_stats_dump;
+    if (!rf::is_multi || !rf::is_server || !dump_config.enabled) {
+        return;
+    }
+    if (!g_dump_timestamp.valid()) {
+        g_dump_timestamp.set(dump_config.interval_s * 1000);
+    }
+    else if (g_dump_timestamp.elapsed()) {
+        network_stats_dump(dump_config.json);
+        g_dump_timestamp.set(dump_config.interval_s * 1000);
+    }
+}
+
+void network_stats_init()
+{
+    g_stats_start_time_ms = rf::timer_get_milliseconds();
+    net_stats_cmd.register_cmd();
+}
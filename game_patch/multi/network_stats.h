@@ -0,0 +1,19 @@
+#pragma once
+
+// Forward declarations
+namespace rf
+{
+    struct PlayerNetData;
+}
+
+// Adds sent or received packet to per-type and per-player traffic counters
+// Note: net_data is null for DF packets that are not sent to a player (e.g. acks sent by a client to the server)
+void network_stats_add_packet(const rf::PlayerNetData* net_data, int packet_type, int size, bool is_send);
+// Starts measuring time spent in the handler of a received packet (previous measurement is finished)
+void network_stats_begin_handler(int packet_type);
+// Finishes measuring time spent in the handler of the last received packet
+void network_stats_end_handler();
+// Adds datagram passed to the socket that contains data of num_send_calls unreliable sends
+void network_stats_add_datagram(int num_send_calls);
+void network_stats_do_frame();
+void network_stats_init();
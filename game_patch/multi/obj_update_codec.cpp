@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "obj_update_codec.h"
+
+// Stock obj_update flags
+constexpr uint8_t ouf_pos_rot_anim = 0x01;
+constexpr uint8_t ouf_unknown4 = 0x02;
+constexpr uint8_t ouf_weapon_type = 0x04;
+constexpr uint8_t ouf_unknown3 = 0x08;
+constexpr uint8_t ouf_health_armor = 0x20;
+constexpr uint8_t ouf_amp_flags = 0x80;
+
+constexpr uint8_t obj_update_packet_type = 0x26;
+constexpr uint32_t obj_update_terminator = 0xFFFFFFFF;
+
+enum ObjUpdateDeltaFlags : uint8_t
+{
+    odf_has_baseline = 0x01,
+    odf_ticks_delta8 = 0x02,
+    odf_ticks_full = 0x04,
+    odf_pos_delta16 = 0x08,
+    odf_pos_full = 0x10,
+    odf_angles_delta8 = 0x20,
+    odf_angles_full = 0x40,
+    odf_move = 0x80,
+};
+
+// Position delta is sent in 1/256 m units
+constexpr float pos_delta_scale = 256.0f;
+// Baselines older than this are not used because client keeps a limited number of states per entity
+constexpr uint16_t max_baseline_age = 64;
+// Entities that were not updated for this many packets are forgotten
+constexpr uint16_t max_history_age = 1024;
+
+class ByteReader
+{
+public:
+    ByteReader(std::span<const std::byte> data) : m_data(data) {}
+
+    template<typename T>
+    bool read(T& value)
+    {
+        if (sizeof(value) > m_data.size() - m_pos) {
+            return false;
+        }
+        std::memcpy(&value, m_data.data() + m_pos, sizeof(value));
+        m_pos += sizeof(value);
+        return true;
+    }
+
+    bool skip(std::size_t len)
+    {
+        if (len > m_data.size() - m_pos) {
+            return false;
+        }
+        m_pos += len;
+        return true;
+    }
+
+    // Returns data read since the provided position
+    [[nodiscard]] std::span<const std::byte> data_since(std::size_t start_pos) const
+    {
+        return m_data.subspan(start_pos, m_pos - start_pos);
+    }
+
+    [[nodiscard]] std::size_t pos() const
+    {
+        return m_pos;
+    }
+
+    [[nodiscard]] bool at_end() const
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    std::span<const std::byte> m_data;
+    std::size_t m_pos = 0;
+};
+
+// Returns packet data without the header if packet has the expected type and valid size
+static std::optional<std::span<const std::byte>> get_packet_data(std::span<const std::byte> packet, uint8_t type)
+{
+    RF_GamePacketHeader header;
+    if (packet.size() < sizeof(header)) {
+        return {};
+    }
+    std::memcpy(&header, packet.data(), sizeof(header));
+    if (header.type != type || header.size > packet.size() - sizeof(header)) {
+        return {};
+    }
+    return {packet.subspan(sizeof(header), header.size)};
+}
+
+static bool is_sequence_newer(uint16_t a, uint16_t b)
+{
+    return static_cast<int16_t>(a - b) > 0;
+}
+
+static float apply_pos_delta(float base, int16_t delta)
+{
+    // Used by both encoder and decoder so both sides compute exactly the same value
+    return base + static_cast<float>(delta) / pos_delta_scale;
+}
+
+// Reads fields that follow position and rotation in stock format. They are copied without changes.
+static std::optional<std::span<const std::byte>> read_other_fields(ByteReader& reader, uint8_t flags)
+{
+    std::size_t start_pos = reader.pos();
+    std::size_t fixed_len = 0;
+    if (flags & ouf_amp_flags) {
+        fixed_len += 1;
+    }
+    if (flags & ouf_weapon_type) {
+        fixed_len += 1;
+    }
+    if (flags & ouf_health_armor) {
+        fixed_len += 3;
+    }
+    if (!reader.skip(fixed_len)) {
+        return {};
+    }
+    if (flags & ouf_unknown3) {
+        uint8_t count;
+        if (!reader.read(count) || !reader.skip(count * 3)) {
+            return {};
+        }
+    }
+    if ((flags & ouf_unknown4) && !reader.skip(2)) {
+        return {};
+    }
+    return {reader.data_since(start_pos)};
+}
+
+static bool read_stock_pos_rot(ByteReader& reader, ObjUpdatePosRot& state)
+{
+    return reader.read(state.ticks) && reader.read(state.pos) && reader.read(state.angle_x) &&
+        reader.read(state.angle_y) && reader.read(state.move);
+}
+
+static void write_stock_pos_rot(ObjUpdatePacketBuilder& out, const ObjUpdatePosRot& state)
+{
+    out.append(state.ticks);
+    out.append(state.pos);
+    out.append(state.angle_x);
+    out.append(state.angle_y);
+    out.append(state.move);
+}
+
+// Writes delta encoded state and returns the state that client will decode
+static ObjUpdatePosRot write_pos_rot_delta(ObjUpdatePacketBuilder& out, const ObjUpdatePosRot& state,
+    const ObjUpdatePosRot* baseline, uint16_t baseline_sequence)
+{
+    if (!baseline) {
+        out.append<uint8_t>(odf_ticks_full | odf_pos_full | odf_angles_full | odf_move);
+        write_stock_pos_rot(out, state);
+        return state;
+    }
+
+    ObjUpdatePosRot decoded = *baseline;
+    uint8_t delta_flags = odf_has_baseline;
+
+    uint16_t ticks_delta = state.ticks - baseline->ticks;
+    if (ticks_delta >= 0x100) {
+        delta_flags |= odf_ticks_full;
+    }
+    else if (ticks_delta != 0) {
+        delta_flags |= odf_ticks_delta8;
+    }
+    decoded.ticks = state.ticks;
+
+    std::array<int16_t, 3> pos_delta{};
+    bool pos_delta_fits = true;
+    for (int i = 0; i < 3; ++i) {
+        float scaled = (state.pos[i] - baseline->pos[i]) * pos_delta_scale;
+        // Note: comparison is false for NaN so it is sent in full
+        if (!(std::abs(scaled) < 32767.0f)) {
+            pos_delta_fits = false;
+            break;
+        }
+        pos_delta[i] = static_cast<int16_t>(std::lround(scaled));
+    }
+    if (!pos_delta_fits) {
+        delta_flags |= odf_pos_full;
+        decoded.pos = state.pos;
+    }
+    else if (pos_delta != std::array<int16_t, 3>{}) {
+        delta_flags |= odf_pos_delta16;
+        for (int i = 0; i < 3; ++i) {
+            decoded.pos[i] = apply_pos_delta(baseline->pos[i], pos_delta[i]);
+        }
+    }
+
+    auto angle_x_delta = static_cast<int16_t>(state.angle_x - baseline->angle_x);
+    auto angle_y_delta = static_cast<int16_t>(state.angle_y - baseline->angle_y);
+    if (angle_x_delta != 0 || angle_y_delta != 0) {
+        bool fits_8bit = angle_x_delta >= INT8_MIN && angle_x_delta <= INT8_MAX &&
+            angle_y_delta >= INT8_MIN && angle_y_delta <= INT8_MAX;
+        delta_flags |= fits_8bit ? odf_angles_delta8 : odf_angles_full;
+    }
+    decoded.angle_x = state.angle_x;
+    decoded.angle_y = state.angle_y;
+
+    if (state.move != baseline->move) {
+        delta_flags |= odf_move;
+    }
+    decoded.move = state.move;
+
+    out.append(delta_flags);
+    out.append(baseline_sequence);
+    if (delta_flags & odf_ticks_full) {
+        out.append(state.ticks);
+    }
+    else if (delta_flags & odf_ticks_delta8) {
+        out.append(static_cast<uint8_t>(ticks_delta));
+    }
+    if (delta_flags & odf_pos_full) {
+        out.append(state.pos);
+    }
+    else if (delta_flags & odf_pos_delta16) {
+        out.append(pos_delta);
+    }
+    if (delta_flags & odf_angles_full) {
+        out.append(state.angle_x);
+        out.append(state.angle_y);
+    }
+    else if (delta_flags & odf_angles_delta8) {
+        out.append(static_cast<int8_t>(angle_x_delta));
+        out.append(static_cast<int8_t>(angle_y_delta));
+    }
+    if (delta_flags & odf_move) {
+        out.append(state.move);
+    }
+    return decoded;
+}
+
+bool ObjUpdateDeltaEncoder::encode(std::span<const std::byte> stock_packet, ObjUpdatePacketBuilder& out)
+{
+    auto data_opt = get_packet_data(stock_packet, obj_update_packet_type);
+    if (!data_opt) {
+        return false;
+    }
+
+    uint16_t sequence = m_next_sequence;
+    auto& snapshot = m_sent_snapshots[sequence % m_sent_snapshots.size()];
+    // Slot is reused so make sure an old acknowledgement does not apply to the new content
+    snapshot.acked = true;
+    snapshot.entities.clear();
+
+    out.append(sequence);
+    std::size_t num_entities_offset = out.size();
+    out.append<uint8_t>(0);
+
+    ByteReader reader{data_opt.value()};
+    unsigned num_entities = 0;
+    while (true) {
+        uint32_t handle;
+        if (!reader.read(handle)) {
+            return false;
+        }
+        if (handle == obj_update_terminator) {
+            break;
+        }
+        uint8_t flags;
+        if (!reader.read(flags)) {
+            return false;
+        }
+        out.append(handle);
+        out.append(flags);
+        if (flags & ouf_pos_rot_anim) {
+            ObjUpdatePosRot state;
+            if (!read_stock_pos_rot(reader, state)) {
+                return false;
+            }
+            const ObjUpdatePosRot* baseline = nullptr;
+            uint16_t baseline_sequence = 0;
+            auto it = m_baselines.find(handle);
+            if (it != m_baselines.end() && static_cast<uint16_t>(sequence - it->second.sequence) <= max_baseline_age) {
+                baseline = &it->second.state;
+                baseline_sequence = it->second.sequence;
+            }
+            ObjUpdatePosRot decoded = write_pos_rot_delta(out, state, baseline, baseline_sequence);
+            snapshot.entities.emplace_back(handle, decoded);
+        }
+        auto other_fields = read_other_fields(reader, flags);
+        if (!other_fields) {
+            return false;
+        }
+        out.append_bytes(other_fields.value().data(), other_fields.value().size());
+        ++num_entities;
+    }
+    // Fail if packet format is not fully understood
+    if (!reader.at_end() || num_entities > UINT8_MAX) {
+        return false;
+    }
+    out.patch(num_entities_offset, static_cast<uint8_t>(num_entities));
+    out.patch_header();
+    if (out.overflow()) {
+        return false;
+    }
+
+    snapshot.sequence = sequence;
+    snapshot.acked = false;
+    ++m_next_sequence;
+
+    // Forget entities that are not updated anymore (e.g. destroyed)
+    if (sequence % 256 == 0) {
+        std::erase_if(m_baselines, [=](const auto& p) {
+            return static_cast<uint16_t>(sequence - p.second.sequence) > max_baseline_age;
+        });
+    }
+    return true;
+}
+
+void ObjUpdateDeltaEncoder::on_ack(uint16_t sequence)
+{
+    auto& snapshot = m_sent_snapshots[sequence % m_sent_snapshots.size()];
+    if (snapshot.acked || snapshot.sequence != sequence) {
+        return;
+    }
+    snapshot.acked = true;
+    for (const auto& [handle, state] : snapshot.entities) {
+        auto [it, inserted] = m_baselines.try_emplace(handle, Baseline{sequence, state});
+        if (!inserted && is_sequence_newer(sequence, it->second.sequence)) {
+            it->second = Baseline{sequence, state};
+        }
+    }
+}
+
+std::optional<uint16_t> ObjUpdateDeltaDecoder::decode(std::span<const std::byte> df_packet,
+    ObjUpdatePacketBuilder& out)
+{
+    auto data_opt = get_packet_data(df_packet, df_obj_update_packet_type);
+    if (!data_opt) {
+        return {};
+    }
+    ByteReader reader{data_opt.value()};
+    uint16_t sequence;
+    uint8_t num_entities;
+    if (!reader.read(sequence) || !reader.read(num_entities)) {
+        return {};
+    }
+
+    for (unsigned i = 0; i < num_entities; ++i) {
+        uint32_t handle;
+        uint8_t flags;
+        if (!reader.read(handle) || !reader.read(flags)) {
+            return {};
+        }
+        bool valid = true;
+        ObjUpdatePosRot state{};
+        if (flags & ouf_pos_rot_anim) {
+            uint8_t delta_flags;
+            if (!reader.read(delta_flags)) {
+                return {};
+            }
+            const ObjUpdatePosRot* baseline = nullptr;
+            if (delta_flags & odf_has_baseline) {
+                uint16_t baseline_sequence;
+                if (!reader.read(baseline_sequence)) {
+                    return {};
+                }
+                auto it = m_histories.find(handle);
+                if (it != m_histories.end()) {
+                    const auto& history = it->second;
+                    for (std::size_t j = 0; j < history.num_states; ++j) {
+                        if (history.states[j].first == baseline_sequence) {
+                            baseline = &history.states[j].second;
+                            break;
+                        }
+                    }
+                }
+                if (baseline) {
+                    state = *baseline;
+                }
+            }
+            // Fields that are not sent in full can only be decoded if baseline is known
+            valid = baseline || (
+                (delta_flags & odf_ticks_full) && (delta_flags & odf_pos_full) &&
+                (delta_flags & odf_angles_full) && (delta_flags & odf_move));
+
+            if (delta_flags & odf_ticks_full) {
+                if (!reader.read(state.ticks)) {
+                    return {};
+                }
+            }
+            else if (delta_flags & odf_ticks_delta8) {
+                uint8_t ticks_delta;
+                if (!reader.read(ticks_delta)) {
+                    return {};
+                }
+                state.ticks += ticks_delta;
+            }
+            if (delta_flags & odf_pos_full) {
+                if (!reader.read(state.pos)) {
+                    return {};
+                }
+            }
+            else if (delta_flags & odf_pos_delta16) {
+                std::array<int16_t, 3> pos_delta;
+                if (!reader.read(pos_delta)) {
+                    return {};
+                }
+                for (int j = 0; j < 3; ++j) {
+                    state.pos[j] = apply_pos_delta(state.pos[j], pos_delta[j]);
+                }
+            }
+            if (delta_flags & odf_angles_full) {
+                if (!reader.read(state.angle_x) || !reader.read(state.angle_y)) {
+                    return {};
+                }
+            }
+            else if (delta_flags & odf_angles_delta8) {
+                int8_t angle_x_delta, angle_y_delta;
+                if (!reader.read(angle_x_delta) || !reader.read(angle_y_delta)) {
+                    return {};
+                }
+                state.angle_x = static_cast<int16_t>(state.angle_x + angle_x_delta);
+                state.angle_y = static_cast<int16_t>(state.angle_y + angle_y_delta);
+            }
+            if ((delta_flags & odf_move) && !reader.read(state.move)) {
+                return {};
+            }
+        }
+        auto other_fields = read_other_fields(reader, flags);
+        if (!other_fields) {
+            return {};
+        }
+        if (!valid) {
+            // Skip entity - it will be fully updated by one of the next packets
+            continue;
+        }
+
+        out.append(handle);
+        out.append(flags);
+        if (flags & ouf_pos_rot_anim) {
+            write_stock_pos_rot(out, state);
+            auto& history = m_histories[handle];
+            history.states[history.next_index] = {sequence, state};
+            history.next_index = (history.next_index + 1) % history.states.size();
+            history.num_states = std::min(history.num_states + 1, history.states.size());
+            history.last_sequence = sequence;
+        }
+        out.append_bytes(other_fields.value().data(), other_fields.value().size());
+    }
+    if (!reader.at_end()) {
+        return {};
+    }
+    out.append(obj_update_terminator);
+    out.patch_header();
+    if (out.overflow()) {
+        return {};
+    }
+
+    // Forget entities that are not updated anymore (e.g. destroyed)
+    if (++m_num_decoded % 256 == 0) {
+        std::erase_if(m_histories, [=](const auto& p) {
+            return static_cast<uint16_t>(sequence - p.second.last_sequence) > max_history_age;
+        });
+    }
+    return {sequence};
+}
+
+void ObjUpdateDeltaDecoder::reset()
+{
+    m_histories.clear();
+    m_num_decoded = 0;
+}
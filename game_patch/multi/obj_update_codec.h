@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "packet_builder.h"
+
+// Dash Faction extension of obj_update packet (server -> client)
+// Entity position and orientation is encoded as a difference from the last state acknowledged by the client. Other
+// optional fields of the stock packet are copied without changes.
+//
+// Packet layout:
+//   RF_GamePacketHeader header; // type = df_obj_update_packet_type
+//   uint16_t sequence;
+//   uint8_t num_entities;
+//   entities[num_entities]:
+//     uint32_t handle;
+//     uint8_t flags;               // stock obj_update flags
+//     if (flags & pos_rot_anim) {
+//       uint8_t delta_flags;       // see ObjUpdateDeltaFlags
+//       uint16_t baseline_sequence; // if delta_flags & has_baseline
+//       ticks, position, angles and move data depending on delta_flags
+//     }
+//     other fields in stock format
+//
+// Client answers with df_obj_update_ack_packet_type packet containing the received sequence number.
+// Note: the codec does not depend on game code so it can be used outside of the game process.
+
+constexpr uint8_t df_obj_update_packet_type = 0x50;
+constexpr uint8_t df_obj_update_ack_packet_type = 0x51;
+constexpr std::size_t obj_update_max_packet_size = 512;
+
+using ObjUpdatePacketBuilder = PacketBuilder<obj_update_max_packet_size>;
+
+// Fields of an entity that are sent when RF_OUF_POS_ROT_ANIM flag is set
+struct ObjUpdatePosRot
+{
+    uint16_t ticks;
+    std::array<float, 3> pos;
+    int16_t angle_x;
+    int16_t angle_y;
+    // state_flags, move_dir_x, move_dir_y and move_speed
+    std::array<uint8_t, 4> move;
+};
+
+class ObjUpdateDeltaEncoder
+{
+public:
+    // Converts stock obj_update packet (header included) into DF packet. Returns false if packet cannot be encoded
+    bool encode(std::span<const std::byte> stock_packet, ObjUpdatePacketBuilder& out);
+    void on_ack(uint16_t sequence);
+
+private:
+    struct SentSnapshot
+    {
+        uint16_t sequence = 0;
+        bool acked = true;
+        std::vector<std::pair<uint32_t, ObjUpdatePosRot>> entities;
+    };
+
+    struct Baseline
+    {
+        uint16_t sequence;
+        ObjUpdatePosRot state;
+    };
+
+    uint16_t m_next_sequence = 0;
+    std::array<SentSnapshot, 64> m_sent_snapshots;
+    std::unordered_map<uint32_t, Baseline> m_baselines;
+};
+
+class ObjUpdateDeltaDecoder
+{
+public:
+    // Converts DF packet (header included) into stock obj_update packet. Returns sequence number that should be
+    // acknowledged or nothing if packet is malformed
+    std::optional<uint16_t> decode(std::span<const std::byte> df_packet, ObjUpdatePacketBuilder& out);
+    void reset();
+
+private:
+    // States of a single entity received recently
+    struct History
+    {
+        std::array<std::pair<uint16_t, ObjUpdatePosRot>, 64> states;
+        std::size_t num_states = 0;
+        std::size_t next_index = 0;
+        uint16_t last_sequence = 0;
+    };
+
+    std::unordered_map<uint32_t, History> m_histories;
+    uint16_t m_num_decoded = 0;
+};
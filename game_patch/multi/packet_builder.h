@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <common/rfproto.h>
+
+// Builds a game packet (RF_GamePacketHeader followed by data) in a fixed-size buffer owned by the builder
+// Builder is meant to be allocated on the stack so building a packet does not allocate any memory
+template<std::size_t Capacity>
+class PacketBuilder
+{
+public:
+    static_assert(Capacity >= sizeof(RF_GamePacketHeader));
+
+    explicit PacketBuilder(uint8_t type)
+    {
+        RF_GamePacketHeader header{type, 0};
+        std::memcpy(m_buf.data(), &header, sizeof(header));
+        m_size = sizeof(header);
+    }
+
+    // Copies an already serialized packet (header included) into the builder
+    PacketBuilder(const std::byte* data, std::size_t len)
+    {
+        if (len < sizeof(RF_GamePacketHeader) || len > Capacity) {
+            m_overflow = true;
+            return;
+        }
+        std::memcpy(m_buf.data(), data, len);
+        m_size = len;
+    }
+
+    template<typename T>
+    bool append(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return append_bytes(&value, sizeof(value));
+    }
+
+    bool append_bytes(const void* data, std::size_t len)
+    {
+        if (m_overflow || len > Capacity - m_size) {
+            m_overflow = true;
+            return false;
+        }
+        std::memcpy(m_buf.data() + m_size, data, len);
+        m_size += len;
+        return true;
+    }
+
+    // Overwrites already appended data at the provided offset (relative to the packet start)
+    template<typename T>
+    bool patch(std::size_t offset, const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (m_overflow || offset > m_size || sizeof(value) > m_size - offset) {
+            return false;
+        }
+        std::memcpy(m_buf.data() + offset, &value, sizeof(value));
+        return true;
+    }
+
+    // Sets size field in the packet header to the size of data appended so far
+    void patch_header()
+    {
+        RF_GamePacketHeader header;
+        std::memcpy(&header, m_buf.data(), sizeof(header));
+        header.size = static_cast<uint16_t>(m_size - sizeof(header));
+        std::memcpy(m_buf.data(), &header, sizeof(header));
+    }
+
+    // Returns true if any of the operations did not fit in the buffer (packet contents are incomplete in that case)
+    [[nodiscard]] bool overflow() const
+    {
+        return m_overflow;
+    }
+
+    [[nodiscard]] std::byte* data()
+    {
+        return m_buf.data();
+    }
+
+    [[nodiscard]] const std::byte* data() const
+    {
+        return m_buf.data();
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    std::array<std::byte, Capacity> m_buf;
+    std::size_t m_size = 0;
+    bool m_overflow = false;
+};
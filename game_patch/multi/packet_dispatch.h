@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+
+// Table of game packet types accepted by one side of the connection (client or server)
+// Every packet type has its own slot so checking if a packet is allowed is a single indexed load. Table is built at
+// compile time from a list of rules and does not depend on game code so it can be used outside of the game process.
+template<typename Handler>
+class PacketDispatchTable
+{
+public:
+    static constexpr std::size_t num_slots = 256;
+
+    struct Rule
+    {
+        uint8_t type;
+        // Minimal packet data size (without header) declared in packet header
+        uint16_t min_size = 0;
+        // If null packet is processed by game code
+        Handler* handler = nullptr;
+    };
+
+    struct Slot
+    {
+        bool allowed = false;
+        uint16_t min_size = 0;
+        Handler* handler = nullptr;
+        uint32_t num_processed = 0;
+        uint32_t num_rejected = 0;
+    };
+
+    // Packet types starting from first_custom_type that have no rule are passed to custom_handler
+    constexpr PacketDispatchTable(std::initializer_list<Rule> rules, uint8_t first_custom_type = 0,
+        Handler* custom_handler = nullptr)
+    {
+        if (custom_handler) {
+            for (std::size_t type = first_custom_type; type < num_slots; ++type) {
+                m_slots[type].allowed = true;
+                m_slots[type].handler = custom_handler;
+            }
+        }
+        for (const auto& rule : rules) {
+            auto& slot = m_slots[rule.type];
+            slot.allowed = true;
+            slot.min_size = rule.min_size;
+            slot.handler = rule.handler;
+        }
+    }
+
+    // Returns slot of the packet type if packet should be processed or nullptr if it should be ignored
+    Slot* dispatch(uint8_t type, uint16_t size)
+    {
+        auto& slot = m_slots[type];
+        if (!slot.allowed || size < slot.min_size) {
+            ++slot.num_rejected;
+            return nullptr;
+        }
+        ++slot.num_processed;
+        return &slot;
+    }
+
+    [[nodiscard]] const Slot& operator[](uint8_t type) const
+    {
+        return m_slots[type];
+    }
+
+    void reset_counters()
+    {
+        for (auto& slot : m_slots) {
+            slot.num_processed = 0;
+            slot.num_rejected = 0;
+        }
+    }
+
+private:
+    std::array<Slot, num_slots> m_slots{};
+};
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "reliable_channel.h"
+
+enum ReliableFragmentFlags : uint8_t
+{
+    rff_first = 0x01,
+    rff_last = 0x02,
+};
+
+constexpr std::size_t fragment_header_size = sizeof(RF_GamePacketHeader) + sizeof(uint16_t) + sizeof(uint8_t);
+constexpr std::size_t max_fragment_payload = reliable_channel_max_packet_size - fragment_header_size;
+// Bigger game packets are never sent by the game so they are treated as malformed
+constexpr std::size_t max_message_size = 0x10000;
+constexpr int min_rto_ms = 100;
+constexpr int max_rto_ms = 3000;
+constexpr float min_cwnd = 2.0f;
+
+// Returns size of the game packet at the beginning of data (header included) or whole data size if it is malformed
+static std::size_t get_game_packet_size(const std::byte* data, std::size_t len)
+{
+    if (len < sizeof(RF_GamePacketHeader)) {
+        return len;
+    }
+    RF_GamePacketHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    return std::min(sizeof(header) + header.size, len);
+}
+
+// Difference between sequence numbers that handles wrap-around
+static int sequence_diff(uint16_t a, uint16_t b)
+{
+    return static_cast<int16_t>(static_cast<uint16_t>(a - b));
+}
+
+void ReliableChannelSender::queue(const std::byte* data, std::size_t len)
+{
+    m_pending.insert(m_pending.end(), data, data + len);
+}
+
+void ReliableChannelSender::add_fragment(uint8_t flags, const std::byte* data, std::size_t len)
+{
+    Fragment fragment;
+    fragment.sequence = m_next_sequence++;
+    fragment.flags = flags;
+    fragment.payload.assign(data, data + len);
+    m_unsent.push_back(std::move(fragment));
+}
+
+void ReliableChannelSender::build_fragments()
+{
+    // Pack as many complete game packets as possible into every fragment. Game packets that do not fit in an empty
+    // fragment are split.
+    std::size_t offset = 0;
+    std::size_t fragment_start = 0;
+    while (offset < m_pending.size()) {
+        std::size_t packet_size = get_game_packet_size(&m_pending[offset], m_pending.size() - offset);
+        if (offset + packet_size - fragment_start <= max_fragment_payload) {
+            offset += packet_size;
+            continue;
+        }
+        if (offset > fragment_start) {
+            add_fragment(rff_first | rff_last, &m_pending[fragment_start], offset - fragment_start);
+            fragment_start = offset;
+            continue;
+        }
+        for (std::size_t part_offset = 0; part_offset < packet_size; part_offset += max_fragment_payload) {
+            std::size_t part_size = std::min(max_fragment_payload, packet_size - part_offset);
+            uint8_t flags = 0;
+            if (part_offset == 0) {
+                flags |= rff_first;
+            }
+            if (part_offset + part_size == packet_size) {
+                flags |= rff_last;
+            }
+            add_fragment(flags, &m_pending[offset + part_offset], part_size);
+        }
+        offset += packet_size;
+        fragment_start = offset;
+    }
+    if (offset > fragment_start) {
+        add_fragment(rff_first | rff_last, &m_pending[fragment_start], offset - fragment_start);
+    }
+    m_pending.clear();
+}
+
+void ReliableChannelSender::send_fragment(Fragment& fragment, int now_ms, const ReliableChannelSendFn& send)
+{
+    ReliableChannelPacketBuilder packet{df_reliable_data_packet_type};
+    packet.append(fragment.sequence);
+    packet.append(fragment.flags);
+    packet.append_bytes(fragment.payload.data(), fragment.payload.size());
+    packet.patch_header();
+    send(packet.data(), packet.size());
+    fragment.send_time_ms = now_ms;
+    ++fragment.num_sends;
+}
+
+void ReliableChannelSender::flush(int now_ms, const ReliableChannelSendFn& send)
+{
+    if (!m_pending.empty()) {
+        build_fragments();
+    }
+
+    // Retransmit fragments that were not acknowledged in time
+    bool timed_out = false;
+    for (auto& fragment : m_in_flight) {
+        if (!fragment.acked && now_ms - fragment.send_time_ms >= m_rto_ms) {
+            send_fragment(fragment, now_ms, send);
+            ++m_num_retransmits;
+            timed_out = true;
+        }
+    }
+    if (timed_out) {
+        // Packet loss is treated as a congestion signal
+        m_ssthresh = std::max(m_cwnd / 2.0f, min_cwnd);
+        m_cwnd = m_ssthresh;
+        m_rto_ms = std::min(m_rto_ms * 2, max_rto_ms);
+    }
+
+    // Send new fragments if congestion window allows it
+    auto window = static_cast<std::size_t>(std::clamp(m_cwnd, min_cwnd, static_cast<float>(max_window)));
+    while (!m_unsent.empty() && m_in_flight.size() < window) {
+        m_in_flight.push_back(std::move(m_unsent.front()));
+        m_unsent.pop_front();
+        send_fragment(m_in_flight.back(), now_ms, send);
+    }
+}
+
+void ReliableChannelSender::update_rtt(int rtt_ms)
+{
+    // RFC 6298
+    auto rtt = static_cast<float>(std::max(rtt_ms, 0));
+    if (!m_has_rtt_sample) {
+        m_srtt_ms = rtt;
+        m_rttvar_ms = rtt / 2.0f;
+        m_has_rtt_sample = true;
+    }
+    else {
+        m_rttvar_ms = 0.75f * m_rttvar_ms + 0.25f * std::abs(m_srtt_ms - rtt);
+        m_srtt_ms = 0.875f * m_srtt_ms + 0.125f * rtt;
+    }
+    int rto_ms = static_cast<int>(m_srtt_ms + std::max(4.0f * m_rttvar_ms, 10.0f));
+    m_rto_ms = std::clamp(rto_ms, min_rto_ms, max_rto_ms);
+}
+
+bool ReliableChannelSender::on_ack(std::span<const std::byte> ack_packet, int now_ms)
+{
+    uint16_t next_sequence;
+    uint32_t received_mask;
+    if (ack_packet.size() < sizeof(RF_GamePacketHeader) + sizeof(next_sequence) + sizeof(received_mask)) {
+        return false;
+    }
+    const std::byte* ptr = ack_packet.data() + sizeof(RF_GamePacketHeader);
+    std::memcpy(&next_sequence, ptr, sizeof(next_sequence));
+    std::memcpy(&received_mask, ptr + sizeof(next_sequence), sizeof(received_mask));
+
+    for (auto& fragment : m_in_flight) {
+        if (fragment.acked) {
+            continue;
+        }
+        int diff = sequence_diff(fragment.sequence, next_sequence);
+        bool acked = diff < 0 || (diff > 0 && diff <= 32 && (received_mask & (1u << (diff - 1))));
+        if (!acked) {
+            continue;
+        }
+        fragment.acked = true;
+        // Karn's algorithm: retransmitted fragments give ambiguous RTT samples
+        if (fragment.num_sends == 1) {
+            update_rtt(now_ms - fragment.send_time_ms);
+        }
+        // Slow start below the threshold, additive increase above it
+        m_cwnd += m_cwnd < m_ssthresh ? 1.0f : 1.0f / m_cwnd;
+        m_cwnd = std::min(m_cwnd, static_cast<float>(max_window));
+    }
+    while (!m_in_flight.empty() && m_in_flight.front().acked) {
+        m_in_flight.pop_front();
+    }
+    return true;
+}
+
+void ReliableChannelReceiver::process_fragment(Slot& slot, const ReliableChannelDeliverFn& deliver)
+{
+    bool first = slot.flags & rff_first;
+    bool last = slot.flags & rff_last;
+    if (first && last) {
+        m_in_message = false;
+        deliver(slot.payload.data(), slot.payload.size());
+        return;
+    }
+    if (first) {
+        m_message = slot.payload;
+        m_in_message = true;
+    }
+    else if (m_in_message) {
+        m_message.insert(m_message.end(), slot.payload.begin(), slot.payload.end());
+    }
+    if (m_message.size() > max_message_size) {
+        m_message.clear();
+        m_in_message = false;
+    }
+    if (last && m_in_message) {
+        deliver(m_message.data(), m_message.size());
+        m_message.clear();
+        m_in_message = false;
+    }
+}
+
+bool ReliableChannelReceiver::on_data(std::span<const std::byte> data_packet, const ReliableChannelDeliverFn& deliver,
+    ReliableChannelPacketBuilder& ack_out)
+{
+    uint16_t sequence;
+    uint8_t flags;
+    if (data_packet.size() < fragment_header_size) {
+        return false;
+    }
+    const std::byte* ptr = data_packet.data() + sizeof(RF_GamePacketHeader);
+    std::memcpy(&sequence, ptr, sizeof(sequence));
+    std::memcpy(&flags, ptr + sizeof(sequence), sizeof(flags));
+    auto payload = data_packet.subspan(fragment_header_size);
+
+    // Fragments outside of the window were already processed (or are invalid) - only acknowledge them again
+    int diff = sequence_diff(sequence, m_next_sequence);
+    if (diff >= 0 && static_cast<std::size_t>(diff) < window) {
+        auto& slot = m_slots[sequence % window];
+        if (!slot.received) {
+            slot.received = true;
+            slot.flags = flags;
+            slot.payload.assign(payload.begin(), payload.end());
+        }
+    }
+
+    // Deliver fragments in order
+    while (true) {
+        auto& slot = m_slots[m_next_sequence % window];
+        if (!slot.received) {
+            break;
+        }
+        process_fragment(slot, deliver);
+        slot.received = false;
+        slot.payload.clear();
+        ++m_next_sequence;
+    }
+
+    uint32_t received_mask = 0;
+    for (std::size_t i = 0; i < 32; ++i) {
+        auto seq = static_cast<uint16_t>(m_next_sequence + 1 + i);
+        if (m_slots[seq % window].received) {
+            received_mask |= 1u << i;
+        }
+    }
+    ack_out.append(m_next_sequence);
+    ack_out.append(received_mask);
+    ack_out.patch_header();
+    return true;
+}
+
+void ReliableChannelReceiver::reset()
+{
+    for (auto& slot : m_slots) {
+        slot.received = false;
+        slot.payload.clear();
+    }
+    m_next_sequence = 0;
+    m_message.clear();
+    m_in_message = false;
+}
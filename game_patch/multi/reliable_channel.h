@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
+#include <vector>
+#include "packet_builder.h"
+
+// Dash Faction extension of the reliable channel (server -> client)
+// Reliable game packets are packed into fragments that are sent in a congestion window and retransmitted after
+// a timeout based on measured round trip time. Game packets that do not fit in a single datagram are split into
+// multiple fragments and reassembled by the receiver.
+//
+// Data packet layout:
+//   RF_GamePacketHeader header; // type = df_reliable_data_packet_type
+//   uint16_t sequence;
+//   uint8_t flags;              // ReliableFragmentFlags
+//   payload                     // complete game packets or a part of a single game packet
+//
+// Ack packet layout:
+//   RF_GamePacketHeader header; // type = df_reliable_ack_packet_type
+//   uint16_t next_sequence;     // all fragments with lower sequence numbers were received
+//   uint32_t received_mask;     // bit N is set if fragment next_sequence + 1 + N was received
+//
+// Note: the channel does not depend on game code so it can be used outside of the game process.
+
+constexpr uint8_t df_reliable_data_packet_type = 0x52;
+constexpr uint8_t df_reliable_ack_packet_type = 0x53;
+constexpr std::size_t reliable_channel_max_packet_size = 512;
+
+using ReliableChannelPacketBuilder = PacketBuilder<reliable_channel_max_packet_size>;
+using ReliableChannelSendFn = std::function<void(const std::byte* data, std::size_t len)>;
+using ReliableChannelDeliverFn = std::function<void(const std::byte* data, std::size_t len)>;
+
+class ReliableChannelSender
+{
+public:
+    static constexpr std::size_t max_window = 32;
+
+    // Queues complete game packets (header included)
+    void queue(const std::byte* data, std::size_t len);
+    // Sends new fragments allowed by the congestion window and retransmits fragments with expired timers
+    void flush(int now_ms, const ReliableChannelSendFn& send);
+    // Returns false if ack packet is malformed
+    bool on_ack(std::span<const std::byte> ack_packet, int now_ms);
+
+    [[nodiscard]] int rto_ms() const
+    {
+        return m_rto_ms;
+    }
+
+    [[nodiscard]] float cwnd() const
+    {
+        return m_cwnd;
+    }
+
+    [[nodiscard]] int num_retransmits() const
+    {
+        return m_num_retransmits;
+    }
+
+    [[nodiscard]] bool idle() const
+    {
+        return m_pending.empty() && m_unsent.empty() && m_in_flight.empty();
+    }
+
+private:
+    struct Fragment
+    {
+        uint16_t sequence = 0;
+        uint8_t flags = 0;
+        std::vector<std::byte> payload;
+        int send_time_ms = 0;
+        int num_sends = 0;
+        bool acked = false;
+    };
+
+    void build_fragments();
+    void add_fragment(uint8_t flags, const std::byte* data, std::size_t len);
+    void send_fragment(Fragment& fragment, int now_ms, const ReliableChannelSendFn& send);
+    void update_rtt(int rtt_ms);
+
+    // Game packets that were not packed into fragments yet
+    std::vector<std::byte> m_pending;
+    std::deque<Fragment> m_unsent;
+    // Sent fragments ordered by sequence number (acked fragments are removed from the front)
+    std::deque<Fragment> m_in_flight;
+    uint16_t m_next_sequence = 0;
+    float m_cwnd = 4.0f;
+    float m_ssthresh = static_cast<float>(max_window);
+    float m_srtt_ms = 0.0f;
+    float m_rttvar_ms = 0.0f;
+    bool m_has_rtt_sample = false;
+    int m_rto_ms = 500;
+    int m_num_retransmits = 0;
+};
+
+class ReliableChannelReceiver
+{
+public:
+    // Processes data packet (header included), calls deliver for game packets that can be processed in order and
+    // builds an ack packet that should be sent back. Returns false if data packet is malformed.
+    bool on_data(std::span<const std::byte> data_packet, const ReliableChannelDeliverFn& deliver,
+        ReliableChannelPacketBuilder& ack_out);
+    void reset();
+
+private:
+    // Power of two so slot indices stay valid when sequence numbers wrap around
+    static constexpr std::size_t window = 64;
+    static_assert(window > ReliableChannelSender::max_window);
+
+    struct Slot
+    {
+        bool received = false;
+        uint8_t flags = 0;
+        std::vector<std::byte> payload;
+    };
+
+    void process_fragment(Slot& slot, const ReliableChannelDeliverFn& deliver);
+
+    std::array<Slot, window> m_slots;
+    uint16_t m_next_sequence = 0;
+    // Game packet split into multiple fragments
+    std::vector<std::byte> m_message;
+    bool m_in_message = false;
+};
@@ -15,6 +15,8 @@
 #include "server.h"
 #include "server_internal.h"
 #include "multi.h"
+#include "network_stats.h"
+#include "lag_comp.h"
 #include "../os/console.h"
 #include "../misc/player.h"
 #include "../main/main.h"
@@ -197,6 +199,42 @@ void load_additional_server_config(rf::Parser& parser)
         }
     }
 
+    if (parser.parse_optional("$DF Game Info Rate Limit:")) {
+        g_additional_server_config.game_info_rate_limit = parser.parse_int();
+    }
+
+    if (parser.parse_optional("$DF Network Stats Dump:")) {
+        g_additional_server_config.network_stats_dump.enabled = parser.parse_bool();
+        if (parser.parse_optional("+Interval:")) {
+            g_additional_server_config.network_stats_dump.interval_s = std::max(parser.parse_int(), 1);
+        }
+        if (parser.parse_optional("+Format:")) {
+            rf::String format;
+            parser.parse_string(&format);
+            g_additional_server_config.network_stats_dump.json = format == "json";
+        }
+    }
+
+    if (parser.parse_optional("$DF Obj Update Delta Compression:")) {
+        g_additional_server_config.obj_update_delta_compression = parser.parse_bool();
+    }
+
+    if (parser.parse_optional("$DF Batch Unreliable Packets:")) {
+        g_additional_server_config.batch_unreliable_packets = parser.parse_bool();
+    }
+
+    if (parser.parse_optional("$DF Reliable Channel:")) {
+        g_additional_server_config.reliable_channel = parser.parse_bool();
+    }
+
+    if (parser.parse_optional("$DF Lag Compensation History:")) {
+        g_additional_server_config.lag_comp_history_ms = std::clamp(parser.parse_int(), 0, 5000);
+    }
+
+    if (parser.parse_optional("$DF Lag Compensation Interpolation Delay:")) {
+        g_additional_server_config.lag_comp_interp_delay_ms = std::clamp(parser.parse_int(), 0, 1000);
+    }
+
     if (!parser.parse_optional("$Name:") && !parser.parse_optional("#End")) {
         parser.error("end of server configuration");
     }
@@ -207,6 +245,8 @@ CodeInjection dedicated_server_load_config_patch{
     [](auto& regs) {
         auto& parser = *reinterpret_cast<rf::Parser*>(regs.esp - 4 + 0x4C0 - 0x470);
         load_additional_server_config(parser);
+        multi_invalidate_game_info_cache();
+        lag_comp_configure(g_additional_server_config.lag_comp_history_ms);
 
         // Insert server name in window title when hosting dedicated server
         std::string wnd_name;
@@ -370,6 +410,8 @@ CodeInjection detect_browser_player_patch{
         if (conn_rate == 1 || conn_rate == 256) {
             auto& pdata = get_player_additional_data(player);
             pdata.is_browser = true;
+            // Browsers are not included in player count
+            multi_invalidate_game_info_cache();
         }
     },
 };
@@ -636,8 +678,18 @@ FunHook<int(rf::LevelCollisionOut*, rf::Weapon*)> multi_lag_comp_handle_hit_hook
 FunHook<void(rf::Entity*, rf::Weapon*)> multi_lag_comp_weapon_fire_hook{
     0x0046F7E0,
     [](rf::Entity *ep, rf::Weapon *wp) {
-        multi_lag_comp_weapon_fire_hook.call_target(ep, wp);
         rf::Player* pp = rf::player_from_entity_handle(ep->handle);
+        // Test hits against player positions that the shooter saw when firing
+        bool rewind = rf::is_server && pp && pp->net_data && pp->net_data->ping > 0;
+        if (rewind) {
+            int shot_time_ms = lag_comp_get_shot_time(rf::timer_get_milliseconds(), pp->net_data->ping,
+                g_additional_server_config.lag_comp_interp_delay_ms);
+            lag_comp_rewind_players(ep, shot_time_ms);
+        }
+        multi_lag_comp_weapon_fire_hook.call_target(ep, wp);
+        if (rewind) {
+            lag_comp_restore_players();
+        }
         if (pp && pp->stats) {
             auto* stats = static_cast<PlayerStatsNew*>(pp->stats);
             stats->add_shots_fired(get_weapon_shot_stats_delta(wp));
@@ -691,6 +743,7 @@ void server_init()
     spawn_player_sync_ammo_hook.install();
 
     init_server_commands();
+    lag_comp_init();
 
     // Remove level prefix restriction (dm/ctf) for 'level' command and dedicated_server.txt
     AsmWriter(0x004350FE).nop(2);
@@ -735,12 +788,25 @@ void server_do_frame()
 {
     server_vote_do_frame();
     process_delayed_kicks();
+    network_stats_do_frame();
+    multi_ban_do_frame();
+}
+
+void server_do_frame_post()
+{
+    // Record entity states after they were updated in the frame
+    lag_comp_do_frame();
+    // Packets sent during the frame are batched - send them now
+    if (rf::is_server) {
+        multi_flush_all_batched_packets();
+    }
 }
 
 void server_on_limbo_state_enter()
 {
     g_prev_level = rf::level.filename.c_str();
     server_vote_on_limbo_state_enter();
+    lag_comp_clear();
 
     // Clear save data for all players
     auto player_list = SinglyLinkedList{rf::player_list};
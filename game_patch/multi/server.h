@@ -8,6 +8,7 @@ namespace rf
 
 void server_init();
 void server_do_frame();
+void server_do_frame_post();
 bool check_server_chat_command(const char* msg, rf::Player* sender);
 bool server_is_saving_enabled();
 void server_reliable_socket_ready(rf::Player* player);
@@ -26,6 +26,13 @@ struct HitSoundsConfig
     int rate_limit = 10;
 };
 
+struct NetworkStatsDumpConfig
+{
+    bool enabled = false;
+    int interval_s = 60;
+    bool json = false;
+};
+
 struct ServerAdditionalConfig
 {
     VoteConfig vote_kick;
@@ -57,6 +64,13 @@ struct ServerAdditionalConfig
     float kill_reward_effective_health = 0.0f;
     bool kill_reward_health_super = false;
     bool kill_reward_armor_super = false;
+    NetworkStatsDumpConfig network_stats_dump;
+    int game_info_rate_limit = 10;
+    bool obj_update_delta_compression = false;
+    bool batch_unreliable_packets = true;
+    bool reliable_channel = false;
+    int lag_comp_history_ms = 0;
+    int lag_comp_interp_delay_ms = 0;
 };
 
 extern ServerAdditionalConfig g_additional_server_config;
@@ -98,7 +98,7 @@ void console_auto_complete_level(int offset)
     bool first = true;
     std::string common_prefix;
     std::vector<std::string> matches;
-    vpackfile_find_matching_files(StringMatcher().prefix(level_name).suffix(".rfl"), [&](const char* name) {
+    vpackfile_find_matching_files("rfl", StringMatcher().prefix(level_name).suffix(".rfl"), [&](const char* name) {
         auto* ext = std::strrchr(name, '.');
         auto name_len = ext ? ext - name : std::strlen(name);
         std::string name_without_ext(name, name_len);
@@ -7,6 +7,7 @@
 #include "../rf/level.h"
 #include "../misc/misc.h"
 #include "../misc/vpackfile.h"
+#include "../multi/multi.h"
 #include <common/utils/list-utils.h>
 #include <algorithm>
 #include <patch_common/CallHook.h>
@@ -129,6 +130,7 @@ ConsoleCommand2 server_password_cmd{
             rf::netgame.password = "";
             rf::console::print("Server password removed.");
         }
+        multi_invalidate_game_info_cache();
     },
     "Set or remove the server password.",
     "server_password <password>",
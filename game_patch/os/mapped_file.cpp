@@ -0,0 +1,78 @@
+#include <utility>
+#include <xlog/xlog.h>
+#include "mapped_file.h"
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    m_file(std::exchange(other.m_file, INVALID_HANDLE_VALUE)),
+    m_mapping(std::exchange(other.m_mapping, nullptr)),
+    m_view(std::exchange(other.m_view, nullptr)),
+    m_size(std::exchange(other.m_size, 0))
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    std::swap(m_file, other.m_file);
+    std::swap(m_mapping, other.m_mapping);
+    std::swap(m_view, other.m_view);
+    std::swap(m_size, other.m_size);
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path)
+{
+    close();
+
+    m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        xlog::warn("CreateFileA failed for {} (error {})", path, GetLastError());
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(m_file, &file_size) || file_size.HighPart != 0 || file_size.LowPart == 0) {
+        // Empty files cannot be mapped and files bigger than 4 GB do not fit into 32 bit address space
+        xlog::warn("Cannot map file {}: unsupported size", path);
+        close();
+        return false;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        xlog::warn("CreateFileMappingA failed for {} (error {})", path, GetLastError());
+        close();
+        return false;
+    }
+
+    m_view = static_cast<const std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_view) {
+        // It fails when there is not enough contiguous address space left
+        xlog::warn("MapViewOfFile failed for {} (error {})", path, GetLastError());
+        close();
+        return false;
+    }
+    m_size = file_size.LowPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_view) {
+        UnmapViewOfFile(m_view);
+        m_view = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <windows.h>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    bool open(const char* path);
+    void close();
+
+    [[nodiscard]] bool is_open() const
+    {
+        return m_view != nullptr;
+    }
+
+    [[nodiscard]] std::span<const std::byte> data() const
+    {
+        return {m_view, m_size};
+    }
+
+private:
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+    const std::byte* m_view = nullptr;
+    std::size_t m_size = 0;
+};
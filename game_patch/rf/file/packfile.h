@@ -2,6 +2,10 @@
 
 #include <cstdint>
 #include <vector>
+#include <patch_common/MemUtils.h>
+#ifdef DASH_FACTION
+#include <common/utils/string-pool.h>
+#endif
 
 namespace rf
 {
@@ -21,6 +25,12 @@ namespace rf
         uint32_t file_size;
 #ifdef DASH_FACTION
         bool is_user_maps;
+        // packfile was added after game init so it is never allowed to override files from other packfiles
+        bool is_added_after_init;
+        // packfile uses the compressed format (version 2)
+        bool is_compressed;
+        // storage for entry names that could not be referenced in place
+        StringPool name_pool;
 #endif
     };
 #ifndef DASH_FACTION
@@ -0,0 +1,345 @@
+#include <vpackfile_format.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Compares reading VPP packfiles through buffered streams (like the stock packfile code) with reading them through
+// a memory mapping (like the -vpp-mmap mode of the game patch)
+
+// Read-only mapping of a whole file
+class FileMapping
+{
+public:
+    explicit FileMapping(const std::string& filename)
+    {
+#ifdef _WIN32
+        m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size;
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size)) {
+            throw std::runtime_error{"cannot open " + filename};
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        m_size = static_cast<std::size_t>(size.QuadPart);
+#else
+        m_fd = open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if (m_fd < 0 || fstat(m_fd, &st) != 0) {
+            throw std::runtime_error{"cannot open " + filename};
+        }
+        m_size = static_cast<std::size_t>(st.st_size);
+        m_view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (m_view == MAP_FAILED) {
+            m_view = nullptr;
+        }
+#endif
+        if (!m_view) {
+            close_handles();
+            throw std::runtime_error{"cannot map " + filename};
+        }
+    }
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    ~FileMapping()
+    {
+        close_handles();
+    }
+
+    [[nodiscard]] std::span<const std::byte> data() const
+    {
+        return {static_cast<const std::byte*>(m_view), m_size};
+    }
+
+private:
+    void close_handles()
+    {
+#ifdef _WIN32
+        if (m_view) {
+            UnmapViewOfFile(m_view);
+        }
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_file);
+        }
+#else
+        if (m_view) {
+            munmap(m_view, m_size);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+#endif
+    }
+
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+    void* m_view = nullptr;
+    std::size_t m_size = 0;
+};
+
+struct BenchResult
+{
+    double directory_seconds = 0.0;
+    double total_seconds = 0.0;
+    std::size_t num_files = 0;
+    std::size_t num_bytes = 0;
+    uint64_t checksum = 0;
+};
+
+// Touches every byte so both readers do the same work with the data
+static uint64_t checksum_data(const std::byte* data, std::size_t size, uint64_t checksum)
+{
+    std::size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        checksum = (checksum ^ word) * 0x100000001B3ull;
+    }
+    for (; i < size; ++i) {
+        checksum = (checksum ^ static_cast<uint8_t>(data[i])) * 0x100000001B3ull;
+    }
+    return checksum;
+}
+
+static void drop_page_cache([[maybe_unused]] const std::string& filename)
+{
+#ifndef _WIN32
+    // Works without root privileges for pages that are not dirty
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+static void generate_packfile(const std::string& filename, std::size_t total_mb, std::size_t file_kb)
+{
+    std::size_t file_size = std::max<std::size_t>(file_kb, 1) * 1024;
+    std::size_t num_files = std::max<std::size_t>(total_mb * 1024 * 1024 / file_size, 1);
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary);
+    if (!file) {
+        throw std::runtime_error{"cannot create " + filename};
+    }
+
+    std::vector<char> header_and_dir(vpp::seek_table_offset(num_files));
+    std::size_t packfile_size = header_and_dir.size() + num_files * vpp::num_blocks(file_size) * vpp::block_size;
+    // Note: total size field is 32-bit so it is clamped for packfiles bigger than 4 GB (it is not used by readers)
+    vpp::Header hdr{vpp::sig, 1, static_cast<uint32_t>(num_files),
+        static_cast<uint32_t>(std::min<std::size_t>(packfile_size, UINT32_MAX))};
+    std::memcpy(header_and_dir.data(), &hdr, sizeof(hdr));
+    for (std::size_t i = 0; i < num_files; ++i) {
+        vpp::FileInfo info{};
+        std::snprintf(info.name, sizeof(info.name), "file%07zu.tga", i);
+        info.size = static_cast<uint32_t>(file_size);
+        std::memcpy(header_and_dir.data() + vpp::block_size + i * sizeof(info), &info, sizeof(info));
+    }
+    file.write(header_and_dir.data(), header_and_dir.size());
+
+    std::vector<char> data(vpp::num_blocks(file_size) * vpp::block_size);
+    uint32_t seed = 1;
+    for (std::size_t i = 0; i < num_files && file; ++i) {
+        for (std::size_t j = 0; j < file_size; ++j) {
+            seed = seed * 1664525u + 1013904223u;
+            data[j] = static_cast<char>(seed >> 24);
+        }
+        file.write(data.data(), data.size());
+    }
+    if (!file) {
+        throw std::runtime_error{"cannot write " + filename};
+    }
+    std::printf("Generated %s: %zu files, %.1f MB\n", filename.c_str(), num_files, packfile_size / (1024.0 * 1024.0));
+}
+
+static BenchResult bench_stream(const std::string& filename)
+{
+    BenchResult result;
+    auto start = std::chrono::steady_clock::now();
+    std::ifstream file(filename, std::ios_base::in | std::ios_base::binary);
+    if (!file) {
+        throw std::runtime_error{"cannot open " + filename};
+    }
+
+    // Directory is read block by block like the stock code does
+    std::vector<char> block(vpp::block_size);
+    if (!file.read(block.data(), block.size())) {
+        throw std::runtime_error{"cannot read header of " + filename};
+    }
+    const vpp::Header* hdr = vpp::parse_header(std::as_bytes(std::span{block}));
+    if (!hdr) {
+        throw std::runtime_error{"invalid VPP header in " + filename};
+    }
+    std::size_t num_files = hdr->num_files;
+    std::vector<vpp::FileInfo> directory;
+    directory.reserve(num_files);
+    for (std::size_t i = 0; i < vpp::num_directory_blocks(num_files); ++i) {
+        if (!file.read(block.data(), block.size())) {
+            throw std::runtime_error{"truncated VPP directory in " + filename};
+        }
+        std::size_t num_in_block = std::min(vpp::entries_per_block, num_files - directory.size());
+        const auto* records = reinterpret_cast<const vpp::FileInfo*>(block.data());
+        directory.insert(directory.end(), records, records + num_in_block);
+    }
+    result.directory_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Every file is opened by seeking to its block and read into a buffer
+    std::vector<char> buf;
+    std::size_t data_block = 1 + vpp::num_directory_blocks(num_files);
+    for (const auto& info : directory) {
+        buf.resize(info.size);
+        if (!file.seekg(static_cast<std::streamoff>(data_block * vpp::block_size)) || !file.read(buf.data(), buf.size())) {
+            throw std::runtime_error{"cannot read " + std::string{info.name, strnlen(info.name, sizeof(info.name))}};
+        }
+        result.checksum = checksum_data(reinterpret_cast<const std::byte*>(buf.data()), buf.size(), result.checksum);
+        result.num_bytes += info.size;
+        data_block += vpp::num_blocks(info.size);
+    }
+    result.num_files = directory.size();
+    result.total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static BenchResult bench_mapped(const std::string& filename)
+{
+    BenchResult result;
+    auto start = std::chrono::steady_clock::now();
+    FileMapping mapping{filename};
+    auto data = mapping.data();
+    const vpp::Header* hdr = vpp::parse_header(data);
+    if (!hdr) {
+        throw std::runtime_error{"invalid VPP header in " + filename};
+    }
+    // Directory records are used in place
+    auto directory = vpp::get_directory(data, *hdr);
+    if (directory.size() != hdr->num_files) {
+        throw std::runtime_error{"truncated VPP directory in " + filename};
+    }
+    result.directory_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Every file is a view into the mapping
+    std::size_t data_block = 1 + vpp::num_directory_blocks(directory.size());
+    for (const auto& info : directory) {
+        auto file_data = vpp::get_file_data(data, data_block, info.size);
+        if (file_data.size() != info.size) {
+            throw std::runtime_error{"truncated file data in " + filename};
+        }
+        result.checksum = checksum_data(file_data.data(), file_data.size(), result.checksum);
+        result.num_bytes += info.size;
+        data_block += vpp::num_blocks(info.size);
+    }
+    result.num_files = directory.size();
+    result.total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static void print_result(const char* name, int iteration, const BenchResult& result)
+{
+    double mb = result.num_bytes / (1024.0 * 1024.0);
+    std::printf("%-7s #%d: directory %8.3f ms, total %8.3f s, %zu files, %.1f MB, %.1f MB/s (checksum %016llx)\n",
+        name, iteration, result.directory_seconds * 1000.0, result.total_seconds, result.num_files, mb,
+        mb / std::max(result.total_seconds, 0.000001), static_cast<unsigned long long>(result.checksum));
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc <= 1) {
+        std::printf(
+            "Usage: vpp_bench [options...] vpp_file\n\n"
+            "Compares stream and memory-mapped reading of VPP packfiles\n\n"
+            "Available options:\n"
+            "-g size_mb     generates a synthetic packfile of the given size first (overwrites vpp_file)\n"
+            "-f file_kb     sets size of files in the generated packfile in KB (default 256)\n"
+            "-n iterations  sets number of iterations (default 3)\n"
+            "-c             drops the file from the page cache before every run (Linux only)\n"
+        );
+        return 1;
+    }
+
+    std::string filename;
+    std::size_t generate_mb = 0;
+    std::size_t file_kb = 256;
+    int num_iterations = 3;
+    bool cold = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg_sv{argv[i]};
+        if (arg_sv == "-g" && i + 1 < argc) {
+            generate_mb = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg_sv == "-f" && i + 1 < argc) {
+            file_kb = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg_sv == "-n" && i + 1 < argc) {
+            num_iterations = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg_sv == "-c") {
+            cold = true;
+        }
+        else if (arg_sv[0] == '-') {
+            std::printf("Unrecognized option: %s\n", argv[i]);
+        }
+        else if (filename.empty()) {
+            filename = arg_sv;
+        }
+        else {
+            std::printf("Unexpected argument: %s\n", argv[i]);
+        }
+    }
+
+    if (filename.empty()) {
+        std::printf("Packfile name is required\n");
+        return 1;
+    }
+
+    try {
+        if (generate_mb > 0) {
+            generate_packfile(filename, generate_mb, file_kb);
+        }
+        for (int i = 0; i < num_iterations; ++i) {
+            if (cold) {
+                drop_page_cache(filename);
+            }
+            BenchResult stream_result = bench_stream(filename);
+            print_result("stream", i, stream_result);
+            if (cold) {
+                drop_page_cache(filename);
+            }
+            BenchResult mapped_result = bench_mapped(filename);
+            print_result("mapped", i, mapped_result);
+            if (stream_result.checksum != mapped_result.checksum) {
+                std::printf("Error: readers returned different data\n");
+                return 1;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::printf("Error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include <vpackfile_format.h>
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct PackfileFile
+{
+    vpp::FileInfo info;
+    std::vector<char> data;
+};
+
+static std::vector<char> read_whole_file(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios_base::in | std::ios_base::binary);
+    if (!file) {
+        throw std::runtime_error{"cannot open " + filename};
+    }
+    file.seekg(0, std::ios_base::end);
+    std::vector<char> buf(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0, std::ios_base::beg);
+    if (!file.read(buf.data(), buf.size())) {
+        throw std::runtime_error{"cannot read " + filename};
+    }
+    return buf;
+}
+
+static std::span<const std::byte> get_range(const std::vector<char>& buf, std::size_t offset, std::size_t size)
+{
+    if (offset > buf.size() || buf.size() - offset < size) {
+        throw std::runtime_error{"packfile is truncated"};
+    }
+    return std::as_bytes(std::span{buf}).subspan(offset, size);
+}
+
+static std::vector<PackfileFile> parse_packfile(const std::vector<char>& buf, const std::string& filename)
+{
+    auto data = std::as_bytes(std::span{buf});
+    const vpp::Header* hdr = vpp::parse_header(data);
+    if (!hdr) {
+        throw std::runtime_error{"invalid VPP header in " + filename};
+    }
+    auto directory = vpp::get_directory(data, *hdr);
+    if (directory.size() != hdr->num_files) {
+        throw std::runtime_error{"truncated VPP directory in " + filename};
+    }
+
+    std::vector<PackfileFile> files;
+    files.reserve(directory.size());
+    const vpp::CompressionHeader* compression_hdr = vpp::get_compression_header(data);
+    if (!compression_hdr) {
+        std::size_t block = 1 + vpp::num_directory_blocks(hdr->num_files);
+        for (const auto& info : directory) {
+            auto file_data = get_range(buf, block * vpp::block_size, info.size);
+            auto& file = files.emplace_back();
+            file.info = info;
+            file.data.resize(info.size);
+            std::memcpy(file.data.data(), file_data.data(), info.size);
+            block += vpp::num_blocks(info.size);
+        }
+        return files;
+    }
+
+    auto seek_table = get_range(buf, vpp::seek_table_offset(hdr->num_files),
+        vpp::seek_table_size(hdr->num_files, compression_hdr->num_chunks));
+    const auto* compressed_infos = reinterpret_cast<const vpp::CompressedFileInfo*>(seek_table.data());
+    const auto* chunk_ends = reinterpret_cast<const uint32_t*>(compressed_infos + hdr->num_files);
+    for (std::size_t i = 0; i < directory.size(); ++i) {
+        const auto& compressed_info = compressed_infos[i];
+        auto src = get_range(buf, compressed_info.offset, compressed_info.compressed_size);
+        auto& file = files.emplace_back();
+        file.info = directory[i];
+        file.data.resize(directory[i].size);
+        if (compressed_info.compression == vpp::Compression::none) {
+            std::memcpy(file.data.data(), src.data(), file.data.size());
+            continue;
+        }
+        if (compressed_info.compression != vpp::Compression::zlib) {
+            throw std::runtime_error{"unknown compression method in " + filename};
+        }
+        std::size_t num_chunks = vpp::num_chunks(file.data.size(), compression_hdr->chunk_size);
+        if (compressed_info.first_chunk + num_chunks > compression_hdr->num_chunks) {
+            throw std::runtime_error{"invalid seek table in " + filename};
+        }
+        uint32_t chunk_begin = 0;
+        for (std::size_t j = 0; j < num_chunks; ++j) {
+            uint32_t chunk_end = chunk_ends[compressed_info.first_chunk + j];
+            std::size_t dst_offset = j * compression_hdr->chunk_size;
+            uLongf dst_size = std::min<std::size_t>(compression_hdr->chunk_size, file.data.size() - dst_offset);
+            uLongf expected_dst_size = dst_size;
+            if (chunk_end < chunk_begin || chunk_end > src.size() ||
+                uncompress(reinterpret_cast<Bytef*>(file.data.data() + dst_offset), &dst_size,
+                    reinterpret_cast<const Bytef*>(src.data() + chunk_begin), chunk_end - chunk_begin) != Z_OK ||
+                dst_size != expected_dst_size) {
+                throw std::runtime_error{"failed to decompress " + std::string{file.info.name} + " in " + filename};
+            }
+            chunk_begin = chunk_end;
+        }
+    }
+    return files;
+}
+
+static std::vector<PackfileFile> read_packfile(const std::string& filename)
+{
+    return parse_packfile(read_whole_file(filename), filename);
+}
+
+static void pad_to_block(std::vector<char>& buf)
+{
+    buf.resize(vpp::num_blocks(buf.size()) * vpp::block_size);
+}
+
+static void write_whole_file(const std::string& filename, const std::vector<char>& buf)
+{
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary);
+    if (!file || !file.write(buf.data(), buf.size())) {
+        throw std::runtime_error{"cannot write " + filename};
+    }
+}
+
+static std::vector<char> build_header_and_directory(const std::vector<PackfileFile>& files, uint32_t version)
+{
+    std::vector<char> buf(vpp::seek_table_offset(files.size()));
+    vpp::Header hdr{vpp::sig, version, static_cast<uint32_t>(files.size()), 0};
+    std::memcpy(buf.data(), &hdr, sizeof(hdr));
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        std::memcpy(buf.data() + vpp::block_size + i * sizeof(vpp::FileInfo), &files[i].info, sizeof(vpp::FileInfo));
+    }
+    return buf;
+}
+
+static void set_total_size(std::vector<char>& buf)
+{
+    auto total_size = static_cast<uint32_t>(buf.size());
+    std::memcpy(buf.data() + offsetof(vpp::Header, total_size), &total_size, sizeof(total_size));
+}
+
+static std::vector<char> build_uncompressed_packfile(const std::vector<PackfileFile>& files)
+{
+    std::vector<char> buf = build_header_and_directory(files, 1);
+    for (const auto& file : files) {
+        buf.insert(buf.end(), file.data.begin(), file.data.end());
+        pad_to_block(buf);
+    }
+    set_total_size(buf);
+    return buf;
+}
+
+static std::vector<char> build_compressed_packfile(const std::vector<PackfileFile>& files, int level,
+    uint32_t chunk_size)
+{
+    // Compress every chunk independently so any part of a file can be decompressed without touching the rest
+    std::vector<vpp::CompressedFileInfo> compressed_infos(files.size());
+    std::vector<uint32_t> chunk_ends;
+    std::vector<std::vector<char>> compressed_files(files.size());
+    std::vector<char> chunk_buf(compressBound(chunk_size));
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        const auto& file = files[i];
+        auto& compressed = compressed_files[i];
+        std::size_t first_chunk = chunk_ends.size();
+        for (std::size_t offset = 0; offset < file.data.size(); offset += chunk_size) {
+            uLongf compressed_size = chunk_buf.size();
+            uLong src_size = std::min<std::size_t>(chunk_size, file.data.size() - offset);
+            if (compress2(reinterpret_cast<Bytef*>(chunk_buf.data()), &compressed_size,
+                    reinterpret_cast<const Bytef*>(file.data.data() + offset), src_size, level) != Z_OK) {
+                throw std::runtime_error{"failed to compress " + std::string{file.info.name}};
+            }
+            compressed.insert(compressed.end(), chunk_buf.begin(), chunk_buf.begin() + compressed_size);
+            chunk_ends.push_back(compressed.size());
+        }
+        if (compressed.size() < file.data.size()) {
+            compressed_infos[i].compression = vpp::Compression::zlib;
+            compressed_infos[i].first_chunk = first_chunk;
+        }
+        else {
+            // Compression does not help - store the file so it can be read directly
+            chunk_ends.resize(first_chunk);
+            compressed = file.data;
+            compressed_infos[i].compression = vpp::Compression::none;
+            compressed_infos[i].first_chunk = 0;
+        }
+        compressed_infos[i].compressed_size = compressed.size();
+    }
+
+    std::vector<char> buf = build_header_and_directory(files, vpp::compressed_version);
+    vpp::CompressionHeader compression_hdr{chunk_size, static_cast<uint32_t>(chunk_ends.size())};
+    std::memcpy(buf.data() + sizeof(vpp::Header), &compression_hdr, sizeof(compression_hdr));
+
+    // Seek table is filled after data offsets are known
+    std::size_t seek_table_offset = buf.size();
+    buf.resize(buf.size() + vpp::seek_table_size(files.size(), chunk_ends.size()));
+    pad_to_block(buf);
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        if (compressed_infos[i].compression == vpp::Compression::none) {
+            pad_to_block(buf);
+        }
+        compressed_infos[i].offset = buf.size();
+        buf.insert(buf.end(), compressed_files[i].begin(), compressed_files[i].end());
+    }
+    pad_to_block(buf);
+    std::memcpy(buf.data() + seek_table_offset, compressed_infos.data(),
+        compressed_infos.size() * sizeof(vpp::CompressedFileInfo));
+    std::memcpy(buf.data() + seek_table_offset + compressed_infos.size() * sizeof(vpp::CompressedFileInfo),
+        chunk_ends.data(), chunk_ends.size() * sizeof(uint32_t));
+    set_total_size(buf);
+    return buf;
+}
+
+static bool verify_output(const std::vector<PackfileFile>& expected_files, const std::string& output_filename)
+{
+    // Only parsing and decompression is measured (not reading the file from disk)
+    std::vector<char> buf = read_whole_file(output_filename);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PackfileFile> files = parse_packfile(buf, output_filename);
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+    if (files.size() != expected_files.size()) {
+        printf("Verification failed: number of files does not match\n");
+        return false;
+    }
+    std::size_t total_size = 0;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        if (std::memcmp(&files[i].info, &expected_files[i].info, sizeof(vpp::FileInfo)) != 0 ||
+            files[i].data != expected_files[i].data) {
+            printf("Verification failed: %.60s does not match\n", expected_files[i].info.name);
+            return false;
+        }
+        total_size += files[i].data.size();
+    }
+    printf("Verification passed: decompressed %.1f MB in %.3f s (%.1f MB/s)\n", total_size / (1024.0 * 1024.0),
+        duration.count(), total_size / (1024.0 * 1024.0) / std::max(duration.count(), 0.001));
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc <= 1) {
+        printf(
+            "Usage: vpp_compress [options...] input_vpp output_vpp\n\n"
+            "Converts VPP packfile to compressed format (version 2) or back\n\n"
+            "Available options:\n"
+            "-d             decompress (output uncompressed packfile readable by stock tools)\n"
+            "-l level       sets zlib compression level (0-9, default 9)\n"
+            "-c chunk_size  sets compression chunk size in KB (default 64)\n"
+            "-v             verifies output by reading it back and comparing with input\n"
+        );
+        return 1;
+    }
+
+    std::string input_filename;
+    std::string output_filename;
+    bool decompress = false;
+    bool verify = false;
+    int level = Z_BEST_COMPRESSION;
+    uint32_t chunk_size = vpp::default_chunk_size;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg_sv{argv[i]};
+        if (arg_sv == "-d") {
+            decompress = true;
+        }
+        else if (arg_sv == "-v") {
+            verify = true;
+        }
+        else if (arg_sv == "-l" && i + 1 < argc) {
+            level = std::clamp(std::atoi(argv[++i]), 0, 9);
+        }
+        else if (arg_sv == "-c" && i + 1 < argc) {
+            chunk_size = std::clamp(std::atoi(argv[++i]), 1, 16 * 1024) * 1024;
+        }
+        else if (arg_sv[0] == '-') {
+            printf("Unrecognized option: %s\n", argv[i]);
+        }
+        else if (input_filename.empty()) {
+            input_filename = arg_sv;
+        }
+        else if (output_filename.empty()) {
+            output_filename = arg_sv;
+        }
+        else {
+            printf("Unexpected argument: %s\n", argv[i]);
+        }
+    }
+
+    if (input_filename.empty() || output_filename.empty()) {
+        printf("Input and output file names are required\n");
+        return 1;
+    }
+
+    try {
+        std::vector<PackfileFile> files = read_packfile(input_filename);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<char> output = decompress
+            ? build_uncompressed_packfile(files)
+            : build_compressed_packfile(files, level, chunk_size);
+        std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        write_whole_file(output_filename, output);
+
+        std::size_t input_size = 0;
+        for (const auto& file : files) {
+            input_size += file.data.size();
+        }
+        printf("Written %s: %zu files, %zu bytes of data, packfile size %zu bytes (%.1f%%) in %.3f s\n",
+            output_filename.c_str(), files.size(), input_size, output.size(),
+            input_size ? output.size() * 100.0 / input_size : 100.0, duration.count());
+
+        if (verify && !verify_output(files, output_filename)) {
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        printf("Error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}